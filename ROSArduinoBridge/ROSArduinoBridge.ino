@@ -4,8 +4,8 @@
     A set of simple serial commands to control a differential drive
     robot and receive back sensor and odometry data. Default 
     configuration assumes use of an Arduino Mega + Pololu motor
-    controller shield + Robogaia Mega Encoder shield.  Edit the
-    readEncoder() and setMotorSpeed() wrapper functions if using 
+    controller shield + Robogaia Mega Encoder shield.  Add a driver
+    policy to motor_driver.h or encoder_driver.h if using a
     different motor controller or encoder method.
 
     Created for the Pi Robot Project: http://www.pirobot.org
@@ -45,6 +45,10 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  *********************************************************************/
 
+/* Host builds (see CMakeLists.txt) pass the configuration below
+   on the compiler command line instead */
+#ifndef EXTERNAL_CONFIG
+
 #define USE_BASE      // Enable the base controller code
 //#undef USE_BASE     // Disable the base controller code
 
@@ -72,7 +76,31 @@
   //  #define L298_MOTOR_DRIVER
   //  #define ZKBM1_MOTOR_DRIVER
   #define SPARKFUN_TB6612
+#endif
+
+//#define USE_SERVOS  // Enable use of PWM servos as defined in servos.h
+#undef USE_SERVOS     // Disable use of PWM servos
+
+/* Accept COBS/CRC16 framed binary commands next to the ASCII ones
+   (see protocol.h for the frame layout) */
+#define USE_BINARY_PROTOCOL
+//#undef USE_BINARY_PROTOCOL
 
+/* Time the hot paths once at boot and print the results
+   (see benchmark.h) */
+//#define USE_BENCHMARKS
+
+/* Time the loop stages and answer the stats command
+   (see stats.h) */
+//#define USE_STATS
+
+/* Keep the last control ticks in a RAM ring, frozen on a fault
+   and dumped on request (see recorder.h) */
+#define USE_RECORDER
+
+#endif // EXTERNAL_CONFIG
+
+#ifdef USE_BASE
    /***************************************************************
     Configuration Validation
     *************************************************************/
@@ -95,6 +123,11 @@
      #endif
    #endif
    
+   // The flight recorder dumps in binary frames
+   #if defined(USE_RECORDER) && !defined(USE_BINARY_PROTOCOL)
+     #error "USE_RECORDER needs USE_BINARY_PROTOCOL to dump its records"
+   #endif
+
    // Validate encoder configuration
    #ifdef NO_ENCODERS
      #if defined(ROBOGAIA) || defined(ARDUINO_ENC_COUNTER) || defined(ARDUINO_HC89_COUNTER)
@@ -104,8 +137,10 @@
 
 #endif
 
-//#define USE_SERVOS  // Enable use of PWM servos as defined in servos.h
-#undef USE_SERVOS     // Disable use of PWM servos
+/* The flight recorder records the control tick */
+#ifndef USE_BASE
+  #undef USE_RECORDER
+#endif
 
 /* Serial port baud rate */
 #define BAUDRATE     115200 // default= 57600
@@ -119,12 +154,47 @@
 #include "WProgram.h"
 #endif
 
+/* ATOMIC_BLOCK: commands change the state the control interrupt uses */
+#include <util/atomic.h>
+
+/* eeprom_read_block(): the stored configuration */
+#include <avr/eeprom.h>
+
 /* Include definition of serial commands */
 #include "commands.h"
 
+/* Command parsing, replies and the binary wire format */
+#include "protocol.h"
+
+/* Interrupt-fed receive ring buffer */
+#include "serial_rx.h"
+
+/* Non-blocking transmit queue */
+#include "serial_tx.h"
+
+/* Baud rate switch negotiated with the host */
+#include "baud.h"
+
+/* Timer-driven task table: control tick, auto-stop, telemetry, servos */
+#include "scheduler.h"
+
+/* Per-stage timing, compiled out without USE_STATS */
+#include "stats.h"
+
+/* Versioned configuration blob in the EEPROM */
+#include "config.h"
+
 /* Sensor functions */
 #include "sensors.h"
 
+/* Background ultrasonic ranging */
+#include "ranging.h"
+
+/* Hot-path micro-benchmarks */
+#ifdef USE_BENCHMARKS
+  #include "benchmark.h"
+#endif
+
 /* Include servo support if required */
 #ifdef USE_SERVOS
    #include <Servo.h>
@@ -132,11 +202,27 @@
 #endif
 
 #ifdef USE_BASE
+  /* Compile-time pin access for the motor drivers */
+  #include "fast_io.h"
+
+  /* Encoder driver function definitions (LEFT and RIGHT for the
+     motor drivers too) */
+  #include "encoder_driver.h"
+
   /* Motor driver function definitions */
   #include "motor_driver.h"
 
-  /* Encoder driver function definitions */
-  #include "encoder_driver.h"
+  /* Fixed-point PID arithmetic shared by both controllers */
+  #include "pid_kernel.h"
+
+  /* Control tick rate, selectable at run time */
+  #include "control_rate.h"
+
+  /* Wheel speed from encoder counts and edge times */
+  #include "velocity.h"
+
+  /* N-channel controller template behind both drive modes */
+  #include "controller.h"
 
   /* PID parameters and functions */
   #include "diff_controller.h"
@@ -146,14 +232,26 @@
     #include "mecanum_controller.h"
   #endif
 
+  /* Steering position controller (ZKBM1) */
+  #include "steering.h"
+
+  /* Speeds streamed ahead and consumed by the control tick */
+  #include "setpoints.h"
+
+  /* Pose integrated from the control tick's encoder snapshot */
+  #include "odometry.h"
+
+  /* Pushed samples aligned with the control tick */
+  #include "telemetry.h"
+
+  /* The last control ticks, kept for after a fault */
+  #include "recorder.h"
+
   /* Run the PID loop at 30 times per second */
   #define PID_RATE           30     // Hz
 
-  /* Convert the rate into an interval */
+  /* Convert the rate into an interval (scheduler ticks) */
   const int PID_INTERVAL = 1000 / PID_RATE;
-  
-  /* Track the next time we make a PID calculation */
-  unsigned long nextPID = PID_INTERVAL;
 
   /* Stop the robot if it hasn't received a movement command
    in this number of milliseconds */
@@ -161,153 +259,185 @@
   long lastMotorCommand = AUTO_STOP_INTERVAL;
 #endif
 
-/* Variable initialization */
-
-// A pair of varibles to help parse serial commands (thanks Fergs)
-int arg = 0;
-int index = 0;
+/* The raw pin commands may have changed a motor pin */
+#ifdef USE_BASE
+  #define FORGET_MOTOR_OUTPUTS() forgetMotorOutputs()
+#else
+  #define FORGET_MOTOR_OUTPUTS()
+#endif
 
-// Variable to hold an input character
-char chr;
+/* Variable initialization */
 
-// Variable to hold the current single-character command
+// The current single-character command and its integer arguments.
+// The ASCII parser accumulates them digit by digit as bytes arrive,
+// the binary protocol fills them straight from the frame.
 char cmd;
-
-// Character arrays to hold the first and second arguments
-char argv1[16];
-char argv2[16];
-
-
-// The arguments converted to integers
-long arg1;
-long arg2;
-// 
-#ifdef USE_MECANUM
-  char argv3[16];
-  char argv4[16];
-  long arg3;
-  long arg4;
-#endif
+long args[CMD_MAX_ARGS];
+uint8_t argc;
 
 /* Clear the current command parameters */
 void resetCommand() {
-  cmd = NULL;
-  memset(argv1, 0, sizeof(argv1));
-  memset(argv2, 0, sizeof(argv2));
-  arg1 = 0;
-  arg2 = 0;
-  #ifdef USE_MECANUM
-    memset(argv3, 0, sizeof(argv3));
-    memset(argv4, 0, sizeof(argv4));
-    arg3 = 0;
-    arg4 = 0;
-  #endif
-
-  arg = 0;
-  index = 0;
+  cmd = 0;
+  memset(args, 0, sizeof(args));
+  argc = 0;
 }
 
 /* Run a command.  Commands are defined in commands.h */
 void runCommand() {
-  int i = 0;
-  char *p = argv1;
-  char *str;
-  int pid_args[4];
-  arg1 = atoi(argv1);
-  arg2 = atoi(argv2);
-  
+  STATS_BEGIN(STATS_COMMAND);
+  #ifdef USE_RECORDER
+    recorderCommand = cmd;
+  #endif
   switch(cmd) {
   case GET_BAUDRATE:
-    Serial.println(BAUDRATE);
+    baudConfirm();
+    replyValue(baudCurrent());
+    break;
+  case SET_BAUDRATE:
+    if (baudRequest(args[0])) replyValue(args[0]);
+    else replyBadArgument();
     break;
   case ANALOG_READ:
-    Serial.println(analogRead(arg1));
+    replyValue(analogRead(args[0]));
     break;
   case DIGITAL_READ:
-    Serial.println(digitalRead(arg1));
+    replyValue(digitalRead(args[0]));
     break;
   case ANALOG_WRITE:
-    analogWrite(arg1, arg2);
-    Serial.println("OK"); 
+    analogWrite(args[0], args[1]);
+    FORGET_MOTOR_OUTPUTS();
+    replyOK();
     break;
   case DIGITAL_WRITE:
-    if (arg2 == 0) digitalWrite(arg1, LOW);
-    else if (arg2 == 1) digitalWrite(arg1, HIGH);
-    Serial.println("OK"); 
+    if (args[1] == 0) digitalWrite(args[0], LOW);
+    else if (args[1] == 1) digitalWrite(args[0], HIGH);
+    FORGET_MOTOR_OUTPUTS();
+    replyOK();
     break;
   case PIN_MODE:
-    if (arg2 == 0) pinMode(arg1, INPUT);
-    else if (arg2 == 1) pinMode(arg1, OUTPUT);
-    Serial.println("OK");
+    if (args[1] == 0) pinMode(args[0], INPUT);
+    else if (args[1] == 1) pinMode(args[0], OUTPUT);
+    FORGET_MOTOR_OUTPUTS();
+    replyOK();
     break;
-  case PING:
-    Serial.println(Ping(arg1));
+  case PING: {
+    long reading[2];  // range (cm), age (ms)
+    if (rangerLatest(args[0], &reading[0], &reading[1])) replyValues(reading, 2);
+    else replyBadArgument();
     break;
+  }
 #ifdef USE_SERVOS
   case SERVO_WRITE:
-    servos[arg1].setTargetPosition(arg2);
-    Serial.println("OK");
+    servos[args[0]].setTargetPosition(args[1]);
+    replyOK();
     break;
   case SERVO_READ:
-    Serial.println(servos[arg1].getServo().read());
+    replyValue(servos[args[0]].getServo().read());
     break;
 #endif
     
 #ifdef USE_BASE
-  case READ_ENCODERS:
-    Serial.print(readEncoder(DRIVE));
-    Serial.print(" ");
-    Serial.println(readEncoder(STEER));
+  case READ_ENCODERS: {
+    EncoderSnapshot snapshot;
+    snapshotEncoders(&snapshot);
+    replyValues(snapshot.count, ENCODER_SNAPSHOT_SIZE);
     break;
+  }
   case RESET_ENCODERS:
-    resetEncoders();
-    resetPID();
-    Serial.println("OK");
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      resetEncoders();
+      resetPID();
+      #ifdef HAS_STEERING_SUPPORT
+        steeringReset(0);
+      #endif
+      #ifdef USE_ODOMETRY
+        // The counts restart from zero, the pose does not
+        EncoderSnapshot snapshot;
+        snapshotEncoders(&snapshot);
+        odometryRebase(snapshot);
+      #endif
+    }
+    replyOK();
+    break;
+#ifdef USE_ODOMETRY
+  case READ_ODOMETRY: {
+    OdomPose pose;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      pose = odomPose;
+      if (args[0] == 1) {
+        odomPose.x = odomPose.y = 0;
+        odomPose.theta = 0;
+      }
+    }
+    long values[3] = {
+      odomMillimetres(pose.x), odomMillimetres(pose.y), odomMilliradians(pose.theta)
+    };
+    replyValues(values, 3);
     break;
+  }
+#endif
   case STEERING_DIR:
-    SET_STEERING_DIRECTION(arg1);
-    Serial.println("OK");
+    SET_STEERING_DIRECTION(args[0]);
+    replyOK();
     break;  
   case MOTOR_SPEEDS:
-    /* Reset the auto stop timer */
-    lastMotorCommand = millis();
-    if (arg1 == 0) {
-      setMotorSpeed(0);
-      resetPID();
-      moving = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      /* Reset the auto stop timer */
+      lastMotorCommand = millis();
+      setpointClear();
+      if (args[0] == 0) {
+        setMotorSpeed(0);
+        resetPID();
+        moving = 0;
+      }
+      else {
+        moving = 1;
+        #ifndef NO_ENCODERS
+        drivePID.targetQ8[0] = pidTicksToQ8(args[0]);
+        #else
+        // In encoder-less mode, use direct motor speed control
+        setDirectDriveSpeed(args[0]);
+        #endif
+      }
     }
-    else {
-      moving = 1;
-      #ifndef NO_ENCODERS
-      drivePID.TargetTicksPerFrame = arg1;
-      #else
-      // In encoder-less mode, use direct motor speed control
-      setDirectDriveSpeed(arg1);
-      #endif
+    replyAck();
+    break;
+  case SETPOINT_QUEUE: {
+    bool queued;
+    uint8_t pending;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      queued = setpointQueue(args[0], &args[1]);
+      if (queued) lastMotorCommand = millis();
+      pending = setpointPending();
     }
-    Serial.println("OK"); 
+    if (queued) replyValue(pending);
+    else replyBadArgument();
     break;
+  }
 case MOTOR_RAW_PWM:
-  /* Reset the auto stop timer */
-  lastMotorCommand = millis();
-  resetPID();
-  moving = 0;  // PIDs explizit aus
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    /* Reset the auto stop timer */
+    lastMotorCommand = millis();
+    setpointClear();
+    resetPID();
+    moving = 0;  // PIDs explizit aus
 
-  #ifdef USE_MECANUM
-    // Erwartet 4 Argumente: fl:fr:rl:rr (PWM -255..255)
-    arg1 = atoi(argv1);
-    arg2 = atoi(argv2);
-    arg3 = atoi(argv3);
-    arg4 = atoi(argv4);
-    setMecanumMotorSpeeds(arg1, arg2, arg3, arg4);
-  #else
-    // Erwartet 2 Argumente: left:right (PWM -255..255)
-    arg1 = atoi(argv1);
-    arg2 = atoi(argv2);
-    setMotorSpeeds(arg1, arg2);
-  #endif
+    #ifdef USE_MECANUM
+      // Erwartet 4 Argumente: fl:fr:rl:rr (PWM -255..255)
+      #ifdef NO_ENCODERS
+        // Open-loop: keeps updateDirectMecanum() from zeroing the outputs
+        setMecanumDirectSpeeds(args[0], args[1], args[2], args[3]);
+      #else
+        mecanumMoving = 0;  // the wheel PIDs too
+        setMecanumMotorSpeeds(args[0], args[1], args[2], args[3]);
+      #endif
+    #else
+      // Erwartet 2 Argumente: left:right (PWM -255..255)
+      setMotorSpeeds(args[0], args[1]);
+    #endif
+  }
 
-  Serial.println("OK");
+  replyAck();
   break;
 
   // case MOTOR_RAW_PWM:
@@ -332,69 +462,175 @@ case MOTOR_RAW_PWM:
   //   Serial.println("OK"); 
   //   break;
   case UPDATE_PID:
-    while ((str = strtok_r(p, ":", &p)) != '\0') {
-       pid_args[i] = atoi(str);
-       i++;
+    if (argc != 4 || args[3] < 1) {
+      replyBadArgument();
+      break;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      Kp = args[0];
+      Kd = args[1];
+      Ki = args[2];
+      Ko = args[3];
     }
-    Kp = pid_args[0];
-    Kd = pid_args[1];
-    Ki = pid_args[2];
-    Ko = pid_args[3];
-    Serial.println("OK");
+    replyOK();
     break;
   case SET_ENC_DIR:
-    setEncoderDirection(arg1, arg2);
-    Serial.println("OK");
+    setEncoderDirection(args[0], args[1]);
+    replyOK();
+    break;
+  case QUIET_MODE:
+    if (args[0] != 0 && args[0] != 1) {
+      replyBadArgument();
+      break;
+    }
+    replyQuiet = args[0];
+    replyValue(txDropped);
+    break;
+  case TELEMETRY:
+    if (telemetrySubscribe(args[0], args[1], args[2])) replyOK();
+    else replyBadArgument();
+    break;
+  case CONTROL_RATE:
+    // 0, or no argument, only asks
+    if (args[0] != 0 && !setControlRate(args[0])) {
+      replyBadArgument();
+      break;
+    }
+    replyValue(controlRate());
+    break;
+#endif
+#ifdef USE_RECORDER
+  case RECORDER:
+    if (!recorderReply(args[0])) replyBadArgument();
+    break;
+#endif
+#ifdef USE_MECANUM
+  case MECANUM_TWIST:
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      /* Reset the auto stop timer */
+      lastMotorCommand = millis();
+      setpointClear();
+      setMecanumTwist(args[0], args[1], args[2]);
+    }
+    replyAck();
+    break;
+#endif
+  case CONFIG_VALUE:
+    if (!configReply(args[0], args[1], args[2])) replyBadArgument();
+    break;
+#ifdef USE_STATS
+  case LOOP_STATS:
+    if (!statsReply(args[0], args[1])) replyBadArgument();
     break;
 #endif
   default:
-    Serial.println("Invalid Command");
+    replyInvalid();
     break;
   }
+  STATS_END(STATS_COMMAND);
 }
 
+#ifdef USE_BASE
+/* Scheduler task: one PID calculation */
+void controlTick() {
+  STATS_BEGIN(STATS_CONTROL);
+  setpointTick();
+  #ifdef USE_MECANUM
+    updateMecanumPID();
+    #ifdef USE_ODOMETRY
+      odometryUpdate(wheelPID.encoders);
+    #endif
+  #else
+    updatePID();
+    #ifdef HAS_STEERING_SUPPORT
+      steeringTick(drivePID.encoders.count[STEER]);
+    #endif
+    #ifdef USE_ODOMETRY
+      odometryUpdate(drivePID.encoders);
+    #endif
+  #endif
+  #ifdef USE_RECORDER
+    recorderTick();
+  #endif
+  STATS_END(STATS_CONTROL);
+}
+
+/* Scheduler task: stop the robot if the last movement command is
+   older than AUTO_STOP_INTERVAL */
+void autoStopCheck() {
+  if ((millis() - lastMotorCommand) > AUTO_STOP_INTERVAL) {
+    #ifdef USE_RECORDER
+      recorderFault(RECORDER_AUTO_STOP);
+    #endif
+    setpointClear();
+    #ifdef USE_MECANUM
+      // For Mecanum, stop all 4 motors, and the PID (or the open-loop
+      // speeds) with them so the next tick does not drive them again
+      setMecanumMotorSpeeds(0, 0, 0, 0);
+      mecanumMoving = 0;
+    #else
+      // For 2-wheel drive, just stop the main drive motor output.
+      setMotorSpeeds(0, 0);
+      #ifdef HAS_STEERING_SUPPORT
+        // and the steering where it is
+        steeringReset(readEncoder(STEER));
+      #endif
+    #endif
+    moving = 0;
+  }
+}
+#endif
+
+#ifdef USE_SERVOS
+/* Scheduler task: step the servos towards their targets */
+void sweepServos() {
+  STATS_BEGIN(STATS_SERVOS);
+  for (int i = 0; i < N_SERVOS; i++) {
+    servos[i].doSweep();
+  }
+  STATS_END(STATS_SERVOS);
+}
+#endif
+
 /* Setup function--runs once at startup. */
 void setup() {
-  Serial.begin(BAUDRATE);
-
 // Initialize the motor controller if used */
 #ifdef USE_BASE
-  // Initialize encoders only if they are enabled
-  #ifndef NO_ENCODERS
-    #ifdef ARDUINO_ENC_COUNTER
-      //set as inputs
-      DDRD &= ~(1<<LEFT_ENC_PIN_A);
-      DDRD &= ~(1<<LEFT_ENC_PIN_B);
-      DDRC &= ~(1<<RIGHT_ENC_PIN_A);
-      DDRC &= ~(1<<RIGHT_ENC_PIN_B);
-      
-      //enable pull up resistors
-      PORTD |= (1<<LEFT_ENC_PIN_A);
-      PORTD |= (1<<LEFT_ENC_PIN_B);
-      PORTC |= (1<<RIGHT_ENC_PIN_A);
-      PORTC |= (1<<RIGHT_ENC_PIN_B);
-      
-      // tell pin change mask to listen to left encoder pins
-      PCMSK2 |= (1 << LEFT_ENC_PIN_A)|(1 << LEFT_ENC_PIN_B);
-      // tell pin change mask to listen to right encoder pins
-      PCMSK1 |= (1 << RIGHT_ENC_PIN_A)|(1 << RIGHT_ENC_PIN_B);
-      
-      // enable PCINT1 and PCINT2 interrupt in the general interrupt mask
-      PCICR |= (1 << PCIE1) | (1 << PCIE2);
-    #elif defined(ARDUINO_HC89_COUNTER)
-      initEncoders();
-    #endif
-  #endif
+  // The controllers below size their steps for the loop rate
+  initControlRate();
+
+  // Pins and interrupts of the selected encoder driver, if any
+  initEncoders();
   initMotorController();
   resetPID();
+  setpointClear();
+
+  #ifdef HAS_STEERING_SUPPORT
+    initSteering();
+  #endif
   
   #ifdef USE_MECANUM
     // Initialize mecanum controller parameters
     initMecanumParams();
     resetMecanumPID();
   #endif
+
+  #ifdef USE_ODOMETRY
+    EncoderSnapshot snapshot;
+    snapshotEncoders(&snapshot);
+    initOdometry(snapshot);
+  #endif
+
+  #ifdef USE_RECORDER
+    initRecorder();
+  #endif
 #endif
 
+  // The stored configuration over the compiled-in values, before the
+  // UART opens at the home rate it may name
+  configLoad();
+  initBaud();
+
 /* Attach servos if used */
   #ifdef USE_SERVOS
     int i;
@@ -405,106 +641,58 @@ void setup() {
           servoInitPosition[i]);
     }
   #endif
+
+  initRanging();
+
+  // Before the scheduler starts, so no control tick runs in between
+  #ifdef USE_BENCHMARKS
+    runBenchmarks();
+  #endif
+
+  initScheduler();
+
+  #ifdef USE_STATS
+    statsReset();
+  #endif
 }
 
 /* Enter the main loop.  Read and parse input from the serial port
-   and run any valid commands. Run a PID calculation at the target
-   interval and check for auto-stop conditions.
-*/
-/* Enter the main loop.  Read and parse input from the serial port
-   and run any valid commands. Run a PID calculation at the target
-   interval and check for auto-stop conditions.
+   and run any valid commands, then the tasks the scheduler has
+   released for the loop. PID calculations and the auto-stop check
+   run from the scheduler's timer interrupt.
 */
 void loop() {
-  while (Serial.available() > 0) {
-    
-    // Read the next character
-    chr = Serial.read();
-
-    // Terminate a command with a CR (Carriage Return)
-    if (chr == 13) {
-      // Add the final null terminator to the current argument string
-      if (arg == 1) argv1[index] = '\0';
-      else if (arg == 2) argv2[index] = '\0';
-      #ifdef USE_MECANUM
-        else if (arg == 3) argv3[index] = '\0';
-        else if (arg == 4) argv4[index] = '\0';
-      #endif
-      
-      runCommand();
-      resetCommand();
-    }
-    // Use spaces to delimit parts of the command
-    else if (chr == ' ') {
-      // Terminate the current argument string and move to the next
-      if (arg == 0) arg = 1;
-      else if (arg == 1) { argv1[index] = '\0'; arg = 2; index = 0; }
-      #ifdef USE_MECANUM
-        else if (arg == 2) { argv2[index] = '\0'; arg = 3; index = 0; }
-        else if (arg == 3) { argv3[index] = '\0'; arg = 4; index = 0; }
-      #endif
-      continue;
-    }
-    else {
-      // Add the character to the current argument string
-      if (arg == 0) {
-        // The first char is the single-letter command
-        cmd = chr;
-      }
-      else if (arg == 1) {
-        argv1[index] = chr;
-        index++;
+  // Move whatever the core's 64-byte buffer holds into the RX ring;
+  // while the loop is busy the timer ISR keeps doing this
+  STATS_BEGIN(STATS_PARSE);
+  rxService();
+
+  while (rxAvailable()) {
+    uint8_t chr = rxRead();
+
+    #ifdef USE_BINARY_PROTOCOL
+      // A NUL byte never occurs in an ASCII command: it opens a binary
+      // frame, and everything up to the closing NUL belongs to it
+      if (chr == 0 || binFrameActive()) {
+        if (!binFrameActive()) asciiReset();
+        binReceiveByte(chr);
+        continue;
       }
-      else if (arg == 2) {
-        argv2[index] = chr;
-        index++;
-      }
-      #ifdef USE_MECANUM
-        else if (arg == 3) {
-          argv3[index] = chr;
-          index++;
-        }
-        else if (arg == 4) {
-          argv4[index] = chr;
-          index++;
-        }
-      #endif
-    }
+    #endif
+
+    asciiReceiveByte(chr);
   }
+  STATS_END(STATS_PARSE);
   
-  // If we are using base control, run a PID calculation at the appropriate intervals
-  #ifdef USE_BASE
-    if (millis() > nextPID) {
-      #ifdef USE_MECANUM
-        updateMecanumPID();
-      #else
-        updatePID();
-      #endif
-      nextPID += PID_INTERVAL;
-    }
-  
-    // Check to see if we have exceeded the auto-stop interval
-    if ((millis() - lastMotorCommand) > AUTO_STOP_INTERVAL) {
-      #ifdef USE_MECANUM
-        // For Mecanum, stop all 4 motors. A dedicated function would be cleaner,
-        // but for now, we can just send zeros.
-        setMecanumMotorSpeeds(0, 0, 0, 0);
-      #else
-        // For 2-wheel drive, just stop the main drive motor output.
-        // Note: setMotorSpeed is not defined for TB6612, setMotorSpeeds is used.
-        setMotorSpeeds(0, 0);
-      #endif
-      moving = 0;
-    }
-  #endif
+  // Telemetry and servo sweeps released by the scheduler tick; the
+  // control tick and the auto-stop check run in the tick itself
+  schedulerRun();
 
-  // Sweep servos
-  #ifdef USE_SERVOS
-    int i;
-    for (i = 0; i < N_SERVOS; i++) {
-      servos[i].doSweep();
-    }
+  #ifdef USE_RECORDER
+    recorderService();
   #endif
+
+  baudService();
 }
 // void loop() {
 //   while (Serial.available() > 0) {
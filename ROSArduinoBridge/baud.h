@@ -0,0 +1,64 @@
+/***************************************************************
+   Runtime baud rate negotiation
+
+   The firmware boots at its home rate, BAUDRATE unless the stored
+   configuration (config.h) names another. The host can ask for a
+   faster one:
+
+     j <rate>   ->  <rate>   (still at the old rate)
+
+   Once the ack has left the wire the firmware switches, and the
+   host should do the same. The new rate is kept only if the host
+   confirms it with a GET_BAUDRATE query ('b', ASCII or binary) at
+   the new rate within BAUD_CONFIRM_TIMEOUT; otherwise the firmware
+   falls back to the home rate, so a rate the link cannot carry
+   never locks the host out.
+
+   The rates divide 16 MHz exactly with the double-speed UART
+   (250k, 500k and 1M baud), apart from the classic 57600 and
+   115200.
+
+   Received bytes wait in the core's 64-byte buffer until the 1 kHz
+   tick or loop() moves them into the RX ring (serial_rx.h), so the
+   ring only protects a rate that delivers at most 64 bytes per
+   tick: up to 500k baud (50 bytes per ms). At 1M baud about 100
+   bytes arrive per ms, and a stream longer than the core's buffer
+   loses bytes whenever loop() is busy for a tick (an EEPROM commit,
+   a long batch). There the host must keep what it sends ahead of
+   the replies within 64 bytes, e.g. BridgeClient::setMaxInFlight().
+   *************************************************************/
+
+#ifndef BAUD_H
+#define BAUD_H
+
+/* Time the host has to confirm a new rate (ms) */
+#define BAUD_CONFIRM_TIMEOUT 1000
+
+/* Open the UART at the home rate */
+void initBaud();
+
+/* Is rate one of the table's? */
+bool baudSupported(long rate);
+
+/* Boot and fallback rate; false if the rate is not in the table.
+   Takes effect with the next initBaud() or fallback. */
+bool baudSetHome(long rate);
+unsigned long baudHomeRate();
+
+/*
+ * Ask for a switch to rate once the replies queued so far are out.
+ * Returns false if the rate is not in the table.
+ */
+bool baudRequest(long rate);
+
+/* A GET_BAUDRATE arrived: the current rate works */
+void baudConfirm();
+
+/* The rate the UART runs at */
+unsigned long baudCurrent();
+
+/* Switch once the TX path is idle, and fall back when the
+   confirmation does not come; called from loop() */
+void baudService();
+
+#endif // BAUD_H
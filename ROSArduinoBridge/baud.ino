@@ -0,0 +1,76 @@
+/***************************************************************
+   Runtime baud rate negotiation implementation
+   *************************************************************/
+
+#define BAUD_IDLE      0
+#define BAUD_SWITCHING 1  // ack queued, waiting for the TX path to drain
+#define BAUD_TRIAL     2  // switched, waiting for the confirmation
+
+const uint32_t baudRates[] PROGMEM = {
+  57600UL, 115200UL, 250000UL, 500000UL, 1000000UL,
+};
+
+uint8_t baudState = BAUD_IDLE;
+unsigned long baudHome = BAUDRATE;
+unsigned long baudRate = BAUDRATE;
+unsigned long baudPending;
+unsigned long baudSwitchedAt;
+
+void initBaud() {
+  Serial.begin(baudHome);
+  baudRate = baudHome;
+  baudState = BAUD_IDLE;
+}
+
+bool baudSupported(long rate) {
+  for (uint8_t i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++) {
+    if ((unsigned long)rate == pgm_read_dword(&baudRates[i])) return true;
+  }
+  return false;
+}
+
+bool baudSetHome(long rate) {
+  if (!baudSupported(rate)) return false;
+  baudHome = rate;
+  return true;
+}
+
+unsigned long baudHomeRate() {
+  return baudHome;
+}
+
+bool baudRequest(long rate) {
+  if (!baudSupported(rate)) return false;
+  baudPending = rate;
+  baudState = BAUD_SWITCHING;
+  return true;
+}
+
+void baudConfirm() {
+  if (baudState == BAUD_TRIAL) baudState = BAUD_IDLE;
+}
+
+unsigned long baudCurrent() {
+  return baudRate;
+}
+
+void baudSet(unsigned long rate) {
+  Serial.flush();  // the last byte out of the shift register
+  Serial.begin(rate);
+  baudRate = rate;
+  asciiReset();    // whatever arrived during the switch is garbage
+}
+
+void baudService() {
+  if (baudState == BAUD_SWITCHING) {
+    // Not before the ack has left the TX ring and the core's buffer
+    if (!txIdle() || Serial.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1) return;
+    baudSet(baudPending);
+    baudSwitchedAt = millis();
+    baudState = baudRate == baudHome ? BAUD_IDLE : BAUD_TRIAL;
+  } else if (baudState == BAUD_TRIAL) {
+    if (millis() - baudSwitchedAt < BAUD_CONFIRM_TIMEOUT) return;
+    baudSet(baudHome);
+    baudState = BAUD_IDLE;
+  }
+}
@@ -0,0 +1,45 @@
+/***************************************************************
+   Hot-path micro-benchmarks
+
+   With USE_BENCHMARKS the firmware carries a table of benchmark
+   cases - one call each of the code that runs every loop() pass or
+   every control tick - and setup() times them once at boot:
+
+     bench <case> <ns/call> <cycles/call>
+
+   is printed for every case before the bridge starts. Each case is
+   run BENCH_ITERATIONS times between two micros() reads, so the
+   4 us resolution of micros() comes to 4 ns per call; the cost of
+   the harness loop itself is measured with an empty case and
+   subtracted. The Timer0 and RX pump interrupts stay enabled, so
+   the figures include their (small) share, as in normal operation.
+
+   The host build runs the same cases with wall-clock time and
+   hardware instruction counts (host/bench.cpp, the "bench" target).
+   *************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* Calls per case on the target */
+#define BENCH_ITERATIONS 1000
+
+typedef struct {
+  const char *name;
+  void (*prepare)();  // sets up the state the case needs, may be NULL
+  void (*run)();      // one call of the code being measured
+} BenchCase;
+
+extern const BenchCase benchCases[];
+extern const uint8_t benchCaseCount;
+
+/* The empty case, for the harness overhead */
+void benchNothing();
+
+/* Put the bridge back into its idle state after benchmarking */
+void benchFinish();
+
+/* Time every case with micros() and print the results */
+void runBenchmarks();
+
+#endif // BENCHMARK_H
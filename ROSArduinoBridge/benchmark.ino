@@ -0,0 +1,211 @@
+/***************************************************************
+   Hot-path micro-benchmark cases and the on-target harness
+   *************************************************************/
+
+#ifdef USE_BENCHMARKS
+
+/* Changes between calls so no case settles into a fixed path */
+unsigned int benchStep = 0;
+
+void benchNothing() {
+}
+
+/* The digits of a large encoder count, as in an 'e' reply */
+char benchDigits[11];
+
+void benchFormat() {
+  txFormatUnsigned(1234567890UL + benchStep++, benchDigits);
+}
+
+void benchLoop() {
+  loop();
+}
+
+/* The ASCII parser on a 4-wheel raw PWM line, without running it */
+void benchParse() {
+  const char *line = "o 100 -120 140 -160";
+  while (*line) asciiReceiveByte(*line++);
+  asciiReset();
+}
+
+#ifdef USE_BASE
+
+#ifdef USE_MECANUM
+void benchPreparePID() {
+  resetMecanumPID();
+  for (uint8_t i = 0; i < 4; i++) wheelPID.targetQ8[i] = pidTicksToQ8(20 + 5 * i);
+  mecanumMoving = 1;
+}
+
+/* One wheel's PID step, fed a changing encoder delta and edge window */
+void benchPID() {
+  wheelPID.encoder[0] += 15 + (benchStep++ & 7);
+  wheelPID.encoders.edge[LEFT] += 32000 + (benchStep & 3) * 500;
+  wheelPID.stepChannel<0>();
+}
+
+void benchPIDTick() {
+  updateMecanumPID();
+}
+
+/* Global, so the compiler cannot drop the computation */
+int benchWheelSpeeds[4];
+
+long benchWheelTargets[4];
+
+void benchTwist() {
+  benchStep++;
+  mecanumTwistToWheels(0.4, (benchStep & 1) ? 0.2 : -0.2, 0.3, benchWheelSpeeds);
+}
+
+/* What MECANUM_TWIST does: the precomputed matrix, integers only */
+void benchTwistTargets() {
+  benchStep++;
+  mecanumTwistToTargets(400, (benchStep & 1) ? 200 : -200, 300, benchWheelTargets);
+}
+
+void benchMotors() {
+  int spd = (benchStep++ & 1) ? 120 : -120;
+  setMecanumMotorSpeeds(spd, -spd, spd, -spd);
+}
+
+/* The common case at every tick: nothing changed */
+void benchMotorsHold() {
+  setMecanumMotorSpeeds(120, -120, 120, -120);
+}
+#else
+void benchPreparePID() {
+  resetPID();
+  drivePID.targetQ8[0] = pidTicksToQ8(20);
+  moving = 1;
+}
+
+void benchPID() {
+  // Feed a changing encoder delta so the integral path stays live
+  drivePID.encoder[0] += 15 + (benchStep++ & 7);
+  drivePID.encoders.edge[DRIVE] += 32000 + (benchStep & 3) * 500;
+  drivePID.stepChannel<0>();
+}
+
+void benchPIDTick() {
+  updatePID();
+}
+
+void benchMotors() {
+  int spd = (benchStep++ & 1) ? 120 : -120;
+  setMotorSpeeds(spd, -spd);
+}
+
+void benchMotorsHold() {
+  setMotorSpeeds(120, -120);
+}
+#endif
+
+#ifdef USE_ODOMETRY
+EncoderSnapshot benchSnapshot;
+
+/* One odometry step of a robot driving an arc */
+void benchOdometry() {
+  benchSnapshot.count[LEFT] += 9 + (benchStep & 3);
+  benchSnapshot.count[RIGHT] += 12 + (benchStep++ & 1);
+  odometryUpdate(benchSnapshot);
+}
+#endif
+
+/* One channel of the selected motor driver, alternating direction */
+void benchDriveMotor() {
+  MotorDriver::write<0>((benchStep++ & 1) ? 120 : -120);
+}
+
+EncoderSnapshot benchEncoders;
+
+/* The control tick's read of the selected encoder driver */
+void benchSnapshotEncoders() {
+  snapshotEncoders(&benchEncoders);
+}
+
+#ifdef USE_RECORDER
+/* The flight recorder's write at the end of every control tick */
+void benchRecorder() {
+  recorderTick();
+}
+#endif
+
+#endif // USE_BASE
+
+const BenchCase benchCases[] = {
+  { "loop",        NULL,            benchLoop       },
+  { "parse",       NULL,            benchParse      },
+  { "format",      NULL,            benchFormat     },
+#ifdef USE_BASE
+  { "pid",         benchPreparePID, benchPID        },
+  { "pid_tick",    benchPreparePID, benchPIDTick    },
+  #ifdef USE_MECANUM
+  { "twist",       NULL,            benchTwist      },
+  { "twist_ik",    NULL,            benchTwistTargets },
+  #endif
+  #ifdef USE_ODOMETRY
+  { "odometry",    NULL,            benchOdometry   },
+  #endif
+  { "driveMotor",  NULL,            benchDriveMotor },
+  { "encoders",    NULL,            benchSnapshotEncoders },
+  { "motors",      NULL,            benchMotors     },
+  { "motors_hold", NULL,            benchMotorsHold },
+  #ifdef USE_RECORDER
+  { "recorder",    NULL,            benchRecorder   },
+  #endif
+#endif
+};
+
+const uint8_t benchCaseCount = sizeof(benchCases) / sizeof(benchCases[0]);
+
+void benchFinish() {
+  #ifdef USE_BASE
+    #ifdef USE_MECANUM
+      setMecanumMotorSpeeds(0, 0, 0, 0);
+      resetMecanumPID();
+      mecanumMoving = 0;
+    #else
+      setMotorSpeeds(0, 0);
+    #endif
+    resetPID();
+    moving = 0;
+  #endif
+  #ifdef USE_ODOMETRY
+    // Back to the real counts and a zero pose
+    EncoderSnapshot snapshot;
+    snapshotEncoders(&snapshot);
+    initOdometry(snapshot);
+  #endif
+  #ifdef USE_RECORDER
+    initRecorder();
+  #endif
+}
+
+/* Microseconds for BENCH_ITERATIONS calls */
+unsigned long benchTime(void (*run)()) {
+  unsigned long start = micros();
+  for (unsigned int i = 0; i < BENCH_ITERATIONS; i++) run();
+  return micros() - start;
+}
+
+void runBenchmarks() {
+  unsigned long overhead = benchTime(benchNothing);
+
+  for (uint8_t i = 0; i < benchCaseCount; i++) {
+    if (benchCases[i].prepare) benchCases[i].prepare();
+    unsigned long elapsed = benchTime(benchCases[i].run);
+    elapsed = elapsed > overhead ? elapsed - overhead : 0;
+
+    Serial.print("bench ");
+    Serial.print(benchCases[i].name);
+    Serial.print(" ");
+    Serial.print(elapsed * 1000UL / BENCH_ITERATIONS);
+    Serial.print(" ");
+    Serial.println(elapsed * (F_CPU / 1000000UL) / BENCH_ITERATIONS);
+  }
+
+  benchFinish();
+}
+
+#endif // USE_BENCHMARKS
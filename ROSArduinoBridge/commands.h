@@ -21,7 +21,17 @@
 #define DIGITAL_WRITE  'w'
 #define ANALOG_WRITE   'x'
 #define SET_ENC_DIR    'y'
-#define MECANUM_TWIST  'n'  // vx:vy:wz -> PWM-Mix (optional)
+#define MECANUM_TWIST  'n'  // vx:vy (mm/s) wz (mrad/s) -> wheel targets
+#define TELEMETRY      'g'  // streams:decimation[:analog_mask] -> pushed samples
+#define READ_ODOMETRY  'i'  // [1 = zero afterwards] -> x y (mm) theta (mrad)
+#define SETPOINT_QUEUE 'q'  // dt:speeds (as 'm') -> points queued
+#define SET_BAUDRATE   'j'  // rate -> rate, then switch; confirm with 'b' at the new rate
+#define QUIET_MODE     'h'  // 0|1 -> replies dropped so far; 1 leaves out the m/o/n acks
+#define LOOP_STATS     'v'  // stage[:1 = reset afterwards] -> count min max mean (us) and histogram
+#define CONFIG_VALUE   'k'  // op:key[:value] -> value; 0 get, 1 set, 2 commit to EEPROM, 3 forget (config.h)
+#define CONTROL_RATE   'z'  // [hz, 0 asks] -> control loop rate in use (control_rate.h)
+#define RECORDER       'l'  // op -> 0 state, 1 freeze and dump, 2 record again (recorder.h)
+#define RECORDER_FRAME 'L'  // opcode of the pushed dump frames, not a command
 #define DRIVE           0
 #define STEER           1
 
@@ -0,0 +1,119 @@
+/***************************************************************
+   Stored configuration
+
+   The values that differ from robot to robot live in one versioned
+   blob at the start of the EEPROM: the PID gains of every wheel,
+   the mecanum geometry, the TB6612 direction offsets, trims and
+   deadzone, the encoder directions, the home baud rate and the
+   control loop rate. At boot
+   configLoad() reads it with a single eeprom_read_block() and takes
+   it only if magic, version, size and CRC-16 all match; otherwise
+   the compiled-in values stay. The host works with single values:
+
+     k 0 <key>          ->  <value>   get
+     k 1 <key> <value>  ->  <value>   set, in effect at once (RAM)
+     k 2                ->  OK        commit the running values
+     k 3                ->  OK        forget the stored blob; the
+                                      compiled-in values from the
+                                      next boot on
+
+   Keys:
+      0-15  Kp Kd Ki Ko of wheel 0-3 (FL FR RL RR), 4 * wheel + gain;
+            the differential drive has wheel 0 only, the 'u' gains
+     16-18  wheel radius (5-500 mm), wheel base and track width
+            (20 mm - 5 m), in um
+     19-20  maximum linear (mm/s, up to 10 m/s) and angular
+            (mrad/s, up to 50 rad/s) speed
+     21     encoder ticks per wheel revolution (1/1000 tick, 1 to
+            100000 ticks)
+     22-25  direction offset (1 or -1) of motor channel 0-3
+     26-29  trim (-255 .. 255) of motor channel 0-3
+     30     deadzone (0 .. 255)
+     31-32  direction (1 or -1) of the LEFT and RIGHT encoder
+     33     home baud rate (baud.h), used from the next boot or
+            fallback on
+     34     control loop rate (Hz, control_rate.h)
+
+   A geometry value is also refused if, with the others, a wheel
+   would have to turn faster than CONFIG_MAX_WHEEL_TICKS per frame
+   at full speed and rotation, beyond what the fixed-point inverse
+   kinematics (mecanum_controller.h) can hold. A stored geometry
+   that fails these checks is ignored as a whole.
+
+   Motor channels are the TB6612's L1 L2 R1 R2 (motor_driver.h).
+   A key the build has no use for, say the geometry on a
+   differential drive, is rejected; the blob keeps a place for it
+   anyway, so every build shares one layout.
+
+   A commit writes only the bytes that changed, 3.4 ms each with
+   loop() held up, and the geometry is rebuilt in floating point on
+   every set, so both are for a robot standing still.
+   *************************************************************/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define CONFIG_MAGIC   0xB71C
+#define CONFIG_VERSION 1
+#define CONFIG_ADDRESS 0     // EEPROM offset of the blob
+
+/* Operations */
+#define CONFIG_GET    0
+#define CONFIG_SET    1
+#define CONFIG_COMMIT 2
+#define CONFIG_FORGET 3
+
+/* First key of every group */
+#define CONFIG_KEY_GAINS      0   // + 4 * wheel + (Kp, Kd, Ki, Ko)
+#define CONFIG_KEY_KINEMATICS 16  // + MecanumParams field
+#define CONFIG_KEY_OFFSET     22  // + motor channel
+#define CONFIG_KEY_TRIM       26  // + motor channel
+#define CONFIG_KEY_DEADZONE   30
+#define CONFIG_KEY_ENC_DIR    31  // + LEFT / RIGHT
+#define CONFIG_KEY_BAUD       33
+#define CONFIG_KEY_RATE       34
+#define CONFIG_KEYS           35
+
+/* Fastest wheel target a geometry may ask for, ticks per frame;
+   Q16 in the inverse kinematics, far from a long's range */
+#define CONFIG_MAX_WHEEL_TICKS 8192
+
+/* Wheels with their own gains */
+#if defined(USE_MECANUM)
+  #define CONFIG_WHEELS 4
+#elif defined(USE_BASE)
+  #define CONFIG_WHEELS 1
+#else
+  #define CONFIG_WHEELS 0
+#endif
+
+/* The blob; no padding on the AVR or the host */
+typedef struct {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t size;               // sizeof(BridgeConfig)
+  int16_t gains[4][4];        // Kp Kd Ki Ko per wheel
+  float kinematics[6];        // MecanumParams, field by field
+  uint32_t baud;
+  int16_t motorTrim[4];
+  int8_t motorOffset[4];
+  int8_t encoderDir[2];
+  uint8_t deadzone;
+  uint8_t controlPeriod;      // ms; 0, as in older blobs, is PID_INTERVAL
+  uint8_t spare[2];           // zero
+  uint16_t crc;               // CRC-16/CCITT-FALSE of everything above
+} BridgeConfig;
+
+/*
+ * Read the blob and, if it is valid, apply it over the compiled-in
+ * values, the home baud rate included. Called from setup() after
+ * the base is initialized and before initBaud(). True if a stored
+ * configuration was taken.
+ */
+bool configLoad();
+
+/* Reply to the config command; false for an unknown operation or
+   key, or a value out of range */
+bool configReply(long op, long key, long value);
+
+#endif // CONFIG_H
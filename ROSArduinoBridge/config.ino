@@ -0,0 +1,268 @@
+/***************************************************************
+   Stored configuration implementation
+   *************************************************************/
+
+/* Key -> integer scale of the MecanumParams fields, and the
+   physical range of each in those units */
+const float configKinematicScale[6] = { 1e6, 1e6, 1e6, 1e3, 1e3, 1e3 };
+const long configKinematicMin[6] = { 5000L, 20000L, 20000L, 10L, 10L, 1000L };
+const long configKinematicMax[6] = { 500000L, 5000000L, 5000000L, 10000L, 50000L, 100000000L };
+
+/* Encoder directions last applied; the drivers keep no readable copy */
+int8_t configEncoderDir[2] = { 1, 1 };
+
+static uint16_t configCrc(const BridgeConfig *c) {
+  const uint8_t *bytes = (const uint8_t *)c;
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < offsetof(BridgeConfig, crc); i++) crc = crc16Update(crc, bytes[i]);
+  return crc;
+}
+
+/* The running values into c */
+static void configCapture(BridgeConfig *c) {
+  memset(c, 0, sizeof(*c));
+  c->magic = CONFIG_MAGIC;
+  c->version = CONFIG_VERSION;
+  c->size = sizeof(*c);
+  c->baud = baudHomeRate();
+  c->encoderDir[0] = configEncoderDir[0];
+  c->encoderDir[1] = configEncoderDir[1];
+#ifdef USE_BASE
+  #ifdef USE_MECANUM
+    for (uint8_t w = 0; w < 4; w++) {
+      const PIDGains *g = &wheelPID.gains[w];
+      c->gains[w][0] = g->Kp;
+      c->gains[w][1] = g->Kd;
+      c->gains[w][2] = g->Ki;
+      c->gains[w][3] = g->scale.divisor;
+    }
+    c->kinematics[0] = mecanumParams.wheelRadius;
+    c->kinematics[1] = mecanumParams.wheelBase;
+    c->kinematics[2] = mecanumParams.trackWidth;
+    c->kinematics[3] = mecanumParams.maxLinearVel;
+    c->kinematics[4] = mecanumParams.maxAngularVel;
+    c->kinematics[5] = mecanumParams.ticksPerRev;
+  #else
+    c->gains[0][0] = Kp;
+    c->gains[0][1] = Kd;
+    c->gains[0][2] = Ki;
+    c->gains[0][3] = Ko;
+  #endif
+  #ifdef SPARKFUN_TB6612
+    for (uint8_t i = 0; i < MOTOR_CHANNELS; i++) {
+      c->motorOffset[i] = motorOffset[i];
+      c->motorTrim[i] = motorTrim[i];
+    }
+    c->deadzone = motorDeadzone;
+  #endif
+  c->controlPeriod = controlPeriod;
+#endif
+}
+
+/*
+ * Apply the group of values that key belongs to, or every group
+ * for a key of CONFIG_KEYS. Everything the control tick reads is
+ * changed with the interrupts off.
+ */
+static void configApply(const BridgeConfig *c, uint8_t key) {
+  bool all = key == CONFIG_KEYS;
+#ifdef USE_BASE
+  if (all || key < CONFIG_KEY_KINEMATICS) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      #ifdef USE_MECANUM
+        for (uint8_t w = 0; w < 4; w++) {
+          wheelPID.setGains(w, c->gains[w][0], c->gains[w][1], c->gains[w][2], c->gains[w][3]);
+        }
+      #else
+        Kp = c->gains[0][0];
+        Kd = c->gains[0][1];
+        Ki = c->gains[0][2];
+        Ko = c->gains[0][3];
+      #endif
+    }
+  }
+  #ifdef USE_MECANUM
+    if (all || (key >= CONFIG_KEY_KINEMATICS && key < CONFIG_KEY_OFFSET)) {
+      mecanumParams.wheelRadius = c->kinematics[0];
+      mecanumParams.wheelBase = c->kinematics[1];
+      mecanumParams.trackWidth = c->kinematics[2];
+      mecanumParams.maxLinearVel = c->kinematics[3];
+      mecanumParams.maxAngularVel = c->kinematics[4];
+      mecanumParams.ticksPerRev = c->kinematics[5];
+      mecanumUpdateKinematics();
+    }
+  #endif
+  #ifdef SPARKFUN_TB6612
+    if (all || (key >= CONFIG_KEY_OFFSET && key <= CONFIG_KEY_DEADZONE)) {
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < MOTOR_CHANNELS; i++) {
+          motorOffset[i] = c->motorOffset[i];
+          motorTrim[i] = c->motorTrim[i];
+        }
+        motorDeadzone = c->deadzone;
+        forgetMotorOutputs();
+      }
+    }
+  #endif
+  #ifndef NO_ENCODERS
+    // The HC89 driver restarts its direction detection on every call
+    for (uint8_t e = LEFT; e <= RIGHT; e++) {
+      if ((all || key == CONFIG_KEY_ENC_DIR + e) && c->encoderDir[e] != configEncoderDir[e]) {
+        setEncoderDirection(e, c->encoderDir[e]);
+        configEncoderDir[e] = c->encoderDir[e];
+      }
+    }
+  #endif
+  if (all || key == CONFIG_KEY_RATE) {
+    uint8_t period = c->controlPeriod ? c->controlPeriod : PID_INTERVAL;
+    if (period != controlPeriod) setControlPeriod(period);
+  }
+#endif
+  if (all || key == CONFIG_KEY_BAUD) baudSetHome(c->baud);
+}
+
+/* Is every field of c's geometry in its range, and the fastest
+   wheel target it asks for, at full vx, vy and rotation at once,
+   small enough for the fixed-point inverse kinematics? */
+static bool configGeometryValid(const BridgeConfig *c) {
+  const float *k = c->kinematics;
+  for (uint8_t i = 0; i < 6; i++) {
+    float v = k[i] * configKinematicScale[i];
+    if (!(v >= configKinematicMin[i] && v <= configKinematicMax[i])) return false;
+  }
+  #ifdef USE_MECANUM
+    float rim = 2 * k[3] + (k[1] + k[2]) / 2 * k[4];
+    if (rim / (2 * PI * k[0]) * k[5] / PID_RATE > CONFIG_MAX_WHEEL_TICKS) return false;
+  #endif
+  return true;
+}
+
+/* Is the key of a value this build has? */
+static bool configHasKey(long key) {
+  if (key < 0 || key >= CONFIG_KEYS) return false;
+  if (key < CONFIG_KEY_KINEMATICS) return key < 4 * CONFIG_WHEELS;
+#ifdef USE_MECANUM
+  if (key < CONFIG_KEY_OFFSET) return true;
+#endif
+#ifdef SPARKFUN_TB6612
+  if (key >= CONFIG_KEY_OFFSET && key <= CONFIG_KEY_DEADZONE) return true;
+#endif
+#if defined(USE_BASE) && !defined(NO_ENCODERS)
+  if (key == CONFIG_KEY_ENC_DIR + LEFT || key == CONFIG_KEY_ENC_DIR + RIGHT) return true;
+#endif
+#ifdef USE_BASE
+  if (key == CONFIG_KEY_RATE) return true;
+#endif
+  return key == CONFIG_KEY_BAUD;
+}
+
+/* Read a value from c, or check it and write it to c */
+static bool configField(BridgeConfig *c, uint8_t key, long *value, bool write) {
+  long v = *value;
+  if (key < CONFIG_KEY_KINEMATICS) {
+    int16_t *gain = &c->gains[key / 4][key % 4];
+    if (!write) *value = *gain;
+    else if (v < (key % 4 == 3 ? 1 : -32768L) || v > 32767L) return false;
+    else *gain = v;
+  } else if (key < CONFIG_KEY_OFFSET) {
+    uint8_t i = key - CONFIG_KEY_KINEMATICS;
+    if (!write) {
+      *value = lround(c->kinematics[i] * configKinematicScale[i]);
+    } else {
+      float previous = c->kinematics[i];
+      c->kinematics[i] = v / configKinematicScale[i];
+      if (!configGeometryValid(c)) {
+        c->kinematics[i] = previous;
+        return false;
+      }
+    }
+  } else if (key < CONFIG_KEY_TRIM) {
+    int8_t *offset = &c->motorOffset[key - CONFIG_KEY_OFFSET];
+    if (!write) *value = *offset;
+    else if (v != 1 && v != -1) return false;
+    else *offset = v;
+  } else if (key < CONFIG_KEY_DEADZONE) {
+    int16_t *trim = &c->motorTrim[key - CONFIG_KEY_TRIM];
+    if (!write) *value = *trim;
+    else if (v < -255 || v > 255) return false;
+    else *trim = v;
+  } else if (key == CONFIG_KEY_DEADZONE) {
+    if (!write) *value = c->deadzone;
+    else if (v < 0 || v > 255) return false;
+    else c->deadzone = v;
+  } else if (key < CONFIG_KEY_BAUD) {
+    int8_t *dir = &c->encoderDir[key - CONFIG_KEY_ENC_DIR];
+    if (!write) *value = *dir;
+    else if (v != 1 && v != -1) return false;
+    else *dir = v;
+  } else if (key == CONFIG_KEY_BAUD) {
+    if (!write) *value = c->baud;
+    else if (!baudSupported(v)) return false;
+    else c->baud = v;
+  } else {
+  #ifdef USE_BASE
+    if (!write) *value = 1000 / (c->controlPeriod ? c->controlPeriod : PID_INTERVAL);
+    else if (!controlPeriodFor(v)) return false;
+    else c->controlPeriod = controlPeriodFor(v);
+  #endif
+  }
+  return true;
+}
+
+bool configLoad() {
+  BridgeConfig stored;
+  eeprom_read_block(&stored, (const void *)CONFIG_ADDRESS, sizeof(stored));
+  if (stored.magic != CONFIG_MAGIC || stored.version != CONFIG_VERSION ||
+      stored.size != sizeof(stored) || stored.crc != configCrc(&stored)) {
+    return false;
+  }
+
+  // Every value passes the checks of a set; one that does not, say
+  // from a build with another driver, leaves the compiled-in value.
+  // The geometry is only valid as a whole, so it is taken whole or
+  // not at all.
+  BridgeConfig c;
+  configCapture(&c);
+  bool geometry = configGeometryValid(&stored);
+  if (geometry) memcpy(c.kinematics, stored.kinematics, sizeof(c.kinematics));
+  for (uint8_t key = 0; key < CONFIG_KEYS; key++) {
+    if (!configHasKey(key)) continue;
+    if (key >= CONFIG_KEY_KINEMATICS && key < CONFIG_KEY_OFFSET && !geometry) continue;
+    long value;
+    configField(&stored, key, &value, false);
+    configField(&c, key, &value, true);
+  }
+  configApply(&c, CONFIG_KEYS);
+  return true;
+}
+
+bool configReply(long op, long key, long value) {
+  BridgeConfig c;
+  configCapture(&c);
+  switch (op) {
+  case CONFIG_GET:
+    if (!configHasKey(key)) return false;
+    configField(&c, key, &value, false);
+    replyValue(value);
+    return true;
+  case CONFIG_SET:
+    if (!configHasKey(key) || !configField(&c, key, &value, true)) return false;
+    configApply(&c, key);
+    configCapture(&c);
+    configField(&c, key, &value, false);
+    replyValue(value);
+    return true;
+  case CONFIG_COMMIT:
+    c.crc = configCrc(&c);
+    eeprom_update_block(&c, (void *)CONFIG_ADDRESS, sizeof(c));
+    replyOK();
+    return true;
+  case CONFIG_FORGET: {
+    uint16_t blank = 0xFFFF;
+    eeprom_update_block(&blank, (void *)CONFIG_ADDRESS, sizeof(blank));
+    replyOK();
+    return true;
+  }
+  }
+  return false;
+}
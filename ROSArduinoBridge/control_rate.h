@@ -0,0 +1,57 @@
+/***************************************************************
+   Control loop rate
+
+   The control tick runs at PID_RATE unless the host asks for more:
+
+     z <hz>
+
+   sets the rate of the control tick (and of the telemetry task
+   that follows it) and replies with the rate actually used, as the
+   scheduler runs tasks on whole milliseconds: 'z 300' runs every
+   3 ms and answers 333. Rates from PID_RATE up to 1000 Hz are
+   accepted; "z" alone (or "z 0") returns the current rate. The
+   rate can also be stored with the configuration (config.h).
+
+   Everything the host sees stays in units of a frame, the tick
+   length PID_INTERVAL of the reference rate: speeds for 'm' and
+   'q' are ticks per frame, the velocity estimate and the gains are
+   per frame, and the slew and steering limits keep their meaning.
+   A faster loop only samples and corrects more often, so a robot
+   tuned at 30 Hz needs no new gains at 500 Hz. Only the spacing of
+   'q' points is counted in control ticks, as before.
+
+   A tick is the fraction pidTickStep (Q12, pid_kernel.h) of a
+   frame; controlTicksPerFrame is its inverse. Changing the rate
+   holds the steering where it is (steering.h).
+   *************************************************************/
+
+#ifndef CONTROL_RATE_H
+#define CONTROL_RATE_H
+
+#define CONTROL_MAX_RATE 1000  // Hz, one scheduler tick
+
+/* Scheduler ticks (ms) between two control ticks */
+extern uint8_t controlPeriod;
+
+/* Control ticks per frame, Q8 */
+extern uint16_t controlTicksPerFrame;
+
+/* Back to PID_RATE; called from setup() before the controllers
+   are initialized */
+void initControlRate();
+
+/* The nearest whole-millisecond period to hz; 0 outside PID_RATE
+   .. CONTROL_MAX_RATE */
+uint8_t controlPeriodFor(long hz);
+
+/* Run the control tick every period ms, 1 .. PID_INTERVAL */
+void setControlPeriod(uint8_t period);
+
+/* setControlPeriod(controlPeriodFor(hz)); false, changing nothing,
+   for a rate out of range */
+bool setControlRate(long hz);
+
+/* The rate in use, Hz */
+int controlRate();
+
+#endif // CONTROL_RATE_H
@@ -0,0 +1,51 @@
+/***************************************************************
+   Control loop rate implementation
+   *************************************************************/
+
+#ifdef USE_BASE
+
+uint8_t controlPeriod = PID_INTERVAL;
+uint16_t controlTicksPerFrame = PID_ONE;
+
+void initControlRate() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    controlPeriod = PID_INTERVAL;
+    pidTickStep = PID_STEP_ONE;
+    controlTicksPerFrame = PID_ONE;
+  }
+}
+
+uint8_t controlPeriodFor(long hz) {
+  if (hz < PID_RATE || hz > CONTROL_MAX_RATE) return 0;
+  long period = (1000 + hz / 2) / hz;
+  return period < PID_INTERVAL ? period : PID_INTERVAL;
+}
+
+void setControlPeriod(uint8_t period) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    controlPeriod = period;
+    pidTickStep = (uint16_t)(((uint32_t)period << PID_STEP_Q) / PID_INTERVAL);
+    controlTicksPerFrame = (uint16_t)(((uint32_t)PID_INTERVAL << PID_Q) / period);
+  }
+  // Telemetry keeps following the control tick
+  schedulerSetPeriod(TASK_CONTROL, period);
+  schedulerSetPeriod(TASK_TELEMETRY, period);
+
+  // The trajectory limits are per tick
+  #ifdef HAS_STEERING_SUPPORT
+    initSteering();
+  #endif
+}
+
+bool setControlRate(long hz) {
+  uint8_t period = controlPeriodFor(hz);
+  if (!period) return false;
+  setControlPeriod(period);
+  return true;
+}
+
+int controlRate() {
+  return 1000 / controlPeriod;
+}
+
+#endif // USE_BASE
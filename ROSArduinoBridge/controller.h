@@ -0,0 +1,171 @@
+/***************************************************************
+   N-channel PID controller
+
+   The one control loop behind both drive modes: the differential
+   controller runs a single DRIVE channel, the mecanum controller
+   four wheels (FL, FR, RL, RR).
+
+   Controller<N, Encoders, Driver> keeps the channel state as one
+   array per field (structure of arrays) and expands the per-channel
+   work into straight-line code for channels 0 .. N-1 at compile
+   time, so there is no loop counter, no struct indexing and no
+   run-time decision about which encoder feeds which wheel:
+
+     Encoders  template <uint8_t I> static long read(const EncoderSnapshot &);
+               template <uint8_t I> static unsigned long edge(const EncoderSnapshot &);
+               the encoder count of channel I in a snapshot and the
+               time of its latest edge
+     Driver    static void write(const long *output);
+               applies all N outputs to the motors
+
+   Each tick latches all encoders in one snapshotEncoders() call, so
+   every channel works on counts from the same instant; the snapshot
+   is kept in `encoders` for telemetry. The PID input is the M/T
+   velocity estimate of velocity.h, not the raw count difference.
+
+   The arithmetic of every step is the shared fixed-point kernel
+   (pid_kernel.h).
+   *************************************************************/
+
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+/* Compile-time expansion of the per-channel members for I = 0 .. N-1 */
+template <uint8_t N>
+struct ControllerChannels {
+  template <class C> static inline void read(C &c) {
+    ControllerChannels<N - 1>::read(c);
+    c.template readChannel<N - 1>();
+  }
+  template <class C> static inline void reset(C &c) {
+    ControllerChannels<N - 1>::reset(c);
+    c.template resetChannel<N - 1>();
+  }
+  template <class C> static inline void step(C &c) {
+    ControllerChannels<N - 1>::step(c);
+    c.template stepChannel<N - 1>();
+  }
+  /* Has any channel run since the last reset? */
+  template <class C> static inline bool started(const C &c) {
+    return ControllerChannels<N - 1>::started(c) || c.prevInput[N - 1] != 0;
+  }
+};
+
+template <>
+struct ControllerChannels<0> {
+  template <class C> static inline void read(C &) {}
+  template <class C> static inline void reset(C &) {}
+  template <class C> static inline void step(C &) {}
+  template <class C> static inline bool started(const C &) { return false; }
+};
+
+/*
+ * Wheel -> encoder mapping, resolved at compile time. With as many
+ * encoders as wheels each wheel reads its own; otherwise the even
+ * wheels (the left side) share LEFT and the odd ones RIGHT.
+ */
+template <uint8_t Wheels>
+struct EncoderMap {
+  static const uint8_t SAME = ENCODER_CHANNELS >= Wheels;
+
+  template <uint8_t I> static inline long read(const EncoderSnapshot &snapshot) {
+    return snapshot.count[SAME ? I : ((I & 1) ? RIGHT : LEFT)];
+  }
+  template <uint8_t I> static inline unsigned long edge(const EncoderSnapshot &snapshot) {
+    return snapshot.edge[SAME ? I : ((I & 1) ? RIGHT : LEFT)];
+  }
+};
+
+template <uint8_t N, class Encoders, class Driver>
+class Controller {
+public:
+  long targetQ8[N];              // target speed, Q8 ticks per frame
+  long encoder[N];               // encoder count
+  long prevEnc[N];               // last encoder count
+  unsigned long prevEdge[N];     // start of the velocity edge window
+
+  /*
+  * Using previous input (prevInput) instead of the previous error to
+  * avoid derivative kick, and the integrated term (iTerm) instead of
+  * the integrated error to allow tuning changes, see
+  * http://brettbeauregard.com/blog/2011/04/improving-the-beginner%E2%80%99s-pid-derivative-kick/
+  * http://brettbeauregard.com/blog/2011/04/improving-the-beginner%E2%80%99s-pid-tuning-changes/
+  */
+  long prevInput[N];             // last input (velocity), Q8
+  long iTerm[N];                 // integrated term, Q8
+  long carry[N];                 // numerator not yet in the output, Q8
+
+  long output[N];                // last motor setting
+
+  PIDGains gains[N];             // per channel
+  EncoderSnapshot encoders;      // counts and time of the latest latch
+
+  /* Take over the tunable gains of one channel; cheap when Ko did
+     not change */
+  void setGains(uint8_t channel, int kp, int kd, int ki, int ko) {
+    pidSetGains(&gains[channel], kp, kd, ki, ko);
+  }
+
+  /* The same gains for every channel */
+  void setGains(int kp, int kd, int ki, int ko) {
+    for (uint8_t i = 0; i < N; i++) setGains(i, kp, kd, ki, ko);
+  }
+
+  /*
+  * Zero every channel and take the current encoder counts as the
+  * starting point, to prevent startup spikes, see
+  * http://brettbeauregard.com/blog/2011/04/improving-the-beginner%E2%80%99s-pid-initialization/
+  */
+  void reset() {
+    snapshotEncoders(&encoders);
+    ControllerChannels<N>::reset(*this);
+  }
+
+  /* Latch the encoders and read every channel's count from them */
+  void latch() {
+    snapshotEncoders(&encoders);
+    ControllerChannels<N>::read(*this);
+  }
+
+  /*
+  * One control tick: latch the encoders and, while moving, run the
+  * PID step of every channel and drive the motors. When not moving
+  * the channels are reset once; prevInput is a good proxy for
+  * whether that already happened.
+  */
+  void update(unsigned char moving) {
+    latch();
+    if (!moving) {
+      if (ControllerChannels<N>::started(*this)) reset();
+      return;
+    }
+    ControllerChannels<N>::step(*this);
+    STATS_BEGIN(STATS_MOTORS);
+    Driver::write(output);
+    STATS_END(STATS_MOTORS);
+  }
+
+  template <uint8_t I> inline void readChannel() {
+    encoder[I] = Encoders::template read<I>(encoders);
+  }
+
+  template <uint8_t I> inline void resetChannel() {
+    targetQ8[I] = 0;
+    encoder[I] = Encoders::template read<I>(encoders);
+    prevEnc[I] = encoder[I];
+    prevEdge[I] = Encoders::template edge<I>(encoders);
+    output[I] = 0;
+    prevInput[I] = 0;
+    iTerm[I] = 0;
+    carry[I] = 0;
+  }
+
+  template <uint8_t I> inline void stepChannel() {
+    long input = velocityEstimate(encoder[I] - prevEnc[I], Encoders::template edge<I>(encoders),
+                                  encoders.micros, &prevEdge[I], prevInput[I]);
+    output[I] = pidStep(targetQ8[I], input, &prevInput[I], &iTerm[I], &carry[I], output[I], &gains[I]);
+    prevEnc[I] = encoder[I];
+  }
+};
+
+#endif // CONTROLLER_H
@@ -16,29 +16,223 @@ bool encodersAvailable();
 int getEncoderCount();
 
 // Core encoder interface functions
+void initEncoders();
 long readEncoder(int i);
 void resetEncoder(int i);
 void resetEncoders();
 void setEncoderDirection(int enc, int dir);
 
-// Conditional compilation for encoder hardware
-#ifdef NO_ENCODERS
+/*
+ * All encoder counts latched at one instant.
+ *
+ * The counts are 32-bit and updated from interrupts, so a plain read
+ * on the AVR can tear when an edge arrives between its bytes, and
+ * reading the encoders one after the other gives counts from
+ * slightly different moments. snapshotEncoders() copies every
+ * channel and micros() with interrupts disabled, so the counts are
+ * whole and consistent with each other and with the timestamp.
+ * Drivers that see the individual edges also record when the
+ * latest one was counted, for the velocity estimate (velocity.h);
+ * the others report the snapshot time.
+ *
+ * count[] is indexed like readEncoder(): LEFT/DRIVE and RIGHT/STEER.
+ */
+#define ENCODER_SNAPSHOT_SIZE 2
+
+typedef struct {
+  long count[ENCODER_SNAPSHOT_SIZE];
+  unsigned long edge[ENCODER_SNAPSHOT_SIZE]; // micros() of the latest counted edge
+  unsigned long micros;          // micros() when the counts were latched
+} EncoderSnapshot;
+
+/***************************************************************
+   Encoder Pin Configuration
+   *************************************************************/
+
+// Quadrature encoders directly on the Arduino (ARDUINO_ENC_COUNTER)
+//below can be changed, but should be PORTD pins;
+//otherwise additional changes in the code are required
+#define LEFT_ENC_PIN_A PD2  //pin 2
+#define LEFT_ENC_PIN_B PD3  //pin 3
+
+//below can be changed, but should be PORTC pins
+#define RIGHT_ENC_PIN_A PC4  //pin A4
+#define RIGHT_ENC_PIN_B PC5   //pin A5
+
+// HC89 pulse counters, one pin each (ARDUINO_HC89_COUNTER)
+#define DRIVE_ENC_PIN PD2
+#define STEER_ENC_PIN PD3
+
+/***************************************************************
+   Encoder Driver Policies
+
+   Like the motor drivers (motor_driver.h), every encoder driver
+   is a class of static members with one shape:
+
+     CHANNELS                  encoders, 0 or 2
+     init()                    pins and interrupts
+     snapshot(s)               every count at one instant
+     read(i), reset(i)         one count, i < CHANNELS
+     setDirection(i, dir)      1 or -1: counts from now on go the
+                               other way round for -1
+     commanded(i, speed)       the motor encoder i watches was just
+                               given speed; for counters that can
+                               not see the direction themselves
+
+   Whichever is selected at the bottom of this file is
+   EncoderDriver; snapshot() is inline so the control tick reads
+   the counters without a call. The storage, the interrupt
+   routines and the cold members are defined in encoder_driver.ino
+   for the selected driver only, since two drivers may want the
+   same interrupt vector. Any encoder driver goes with any motor
+   driver.
+   *************************************************************/
+
+struct NoEncoders {
+  static const uint8_t CHANNELS = 0;
+
+  static void init() {}
+
+  static inline void snapshot(EncoderSnapshot *snapshot) {
+    snapshot->micros = micros();
+    snapshot->count[LEFT] = 0L;
+    snapshot->count[RIGHT] = 0L;
+    snapshot->edge[LEFT] = snapshot->edge[RIGHT] = snapshot->micros;
+  }
+
+  static long read(uint8_t) { return 0L; }
+  static void reset(uint8_t) {}
+  static void setDirection(uint8_t, int) {}
+  static inline void commanded(uint8_t, int) {}
+};
+
+/* Two quadrature encoders on pin-change interrupts: LEFT on PORTD,
+   RIGHT on PORTC */
+struct QuadratureEncoders {
+  static const uint8_t CHANNELS = 2;
+
+  static volatile long count[2];
+  static volatile unsigned long edge[2];   // micros() of the latest counted edge
+  static volatile int8_t direction[2];     // -1 counts the other way round
+
+  static void init();
+
+  static inline void snapshot(EncoderSnapshot *snapshot) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      snapshot->micros = micros();
+      snapshot->count[LEFT] = count[LEFT];
+      snapshot->count[RIGHT] = count[RIGHT];
+      snapshot->edge[LEFT] = edge[LEFT];
+      snapshot->edge[RIGHT] = edge[RIGHT];
+    }
+  }
+
+  static long read(uint8_t i);
+  static void reset(uint8_t i);
+
+  /* The count so far stays */
+  static void setDirection(uint8_t i, int dir) { direction[i] = dir; }
+
+  /* Quadrature carries its own direction */
+  static inline void commanded(uint8_t, int) {}
+};
+
+/* Two HC89 single-channel pulse counters on INT0/INT1: DRIVE and
+   STEER. A pulse has no direction, so it is counted in the one
+   the motor was last commanded, with some inertia after a stop. */
+struct HC89Encoders {
+  static const uint8_t CHANNELS = 2;
+
+  static volatile long count[2];
+  static volatile unsigned long edge[2];   // micros() of the latest counted edge
+  static volatile int direction[2];        // +1 = forward/right, -1 = reverse/left
+
+  // Inertia detection
+  static volatile long lastCount[2];                 // count before the latest pulse
+  static volatile unsigned long lastDirectionChange[2];
+  static volatile int commandDirection[2];           // last commanded motor direction
+  static const unsigned long INERTIA_DELAY = 500;    // ms before a stopped motor may turn
+
+  static void init();
+  static void driveISR();
+  static void steerISR();
+
+  static inline void snapshot(EncoderSnapshot *snapshot) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      snapshot->micros = micros();
+      snapshot->count[DRIVE] = count[DRIVE];
+      snapshot->count[STEER] = count[STEER];
+      snapshot->edge[DRIVE] = edge[DRIVE];
+      snapshot->edge[STEER] = edge[STEER];
+    }
+  }
+
+  static long read(uint8_t i);
+  static void reset(uint8_t i);
+  static void setDirection(uint8_t i, int dir);
+  static void commanded(uint8_t i, int speed);
+};
+
+#ifdef ROBOGAIA
+  /* The Robogaia Mega Encoder shield */
+  #include "MegaEncoderCounter.h"
+
+  /* The shield counts; LEFT is its Y axis, RIGHT its X axis */
+  struct RobogaiaEncoders {
+    static const uint8_t CHANNELS = 2;
+
+    static MegaEncoderCounter counter;
+
+    static void init() {}
+
+    static inline void snapshot(EncoderSnapshot *snapshot) {
+      // The shield latches the counters itself; read both back to back
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        snapshot->micros = micros();
+        snapshot->count[LEFT] = counter.YAxisGetCount();
+        snapshot->count[RIGHT] = counter.XAxisGetCount();
+      }
+      // Edges are counted on the shield; no times for them
+      snapshot->edge[LEFT] = snapshot->edge[RIGHT] = snapshot->micros;
+    }
+
+    static long read(uint8_t i) {
+      return i == LEFT ? counter.YAxisGetCount() : counter.XAxisGetCount();
+    }
+
+    static void reset(uint8_t i) {
+      if (i == LEFT) counter.YAxisReset();
+      else counter.XAxisReset();
+    }
+
+    // Robogaia encoder direction is handled in hardware
+    static void setDirection(uint8_t, int) {}
+    static inline void commanded(uint8_t, int) {}
+  };
+#endif
+
+/***************************************************************
+   Encoder Selection
+   *************************************************************/
+
+#if defined(NO_ENCODERS)
   // When NO_ENCODERS is defined, all encoder functions return safe values
   // This allows the firmware to compile and run without encoder hardware
+  typedef NoEncoders EncoderDriver;
+#elif defined(ROBOGAIA)
+  typedef RobogaiaEncoders EncoderDriver;
+#elif defined(ARDUINO_ENC_COUNTER)
+  typedef QuadratureEncoders EncoderDriver;
+#elif defined(ARDUINO_HC89_COUNTER)
+  typedef HC89Encoders EncoderDriver;
 #else
-  // Encoder hardware configuration
-  #ifdef ARDUINO_ENC_COUNTER
-    //below can be changed, but should be PORTD pins; 
-    //otherwise additional changes in the code are required
-    #define LEFT_ENC_PIN_A PD2  //pin 2
-    #define LEFT_ENC_PIN_B PD3  //pin 3
-    
-    //below can be changed, but should be PORTC pins
-    #define RIGHT_ENC_PIN_A PC4  //pin A4
-    #define RIGHT_ENC_PIN_B PC5   //pin A5
-  #elif defined(ARDUINO_HC89_COUNTER)
-    #define DRIVE_ENC_PIN PD2
-    #define STEER_ENC_PIN PD3
-  #endif
+  #error An encoder driver must be selected when NO_ENCODERS is not defined!
 #endif
 
+// Number of encoders the selected hardware provides (getEncoderCount()),
+// known at compile time so the controllers can map wheels to encoders
+#define ENCODER_CHANNELS EncoderDriver::CHANNELS
+
+inline void snapshotEncoders(EncoderSnapshot *snapshot) {
+  EncoderDriver::snapshot(snapshot);
+}
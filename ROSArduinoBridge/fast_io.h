@@ -0,0 +1,92 @@
+/***************************************************************
+   Compile-time pin access for the motor drivers
+
+   digitalWrite() and analogWrite() look the pin up in three flash
+   tables (port, bit mask, timer), check for a PWM timer to switch
+   off and save/restore SREG on every call. The motor pins are all
+   #define constants, so FastPin<pin> and FastPwm<pin> resolve the
+   port, bit and compare register once, at compile time; a level
+   change is a single sbi/cbi instruction and a duty change an OCR
+   store.
+
+   On the ATmega328P/168 (Uno, Nano, Pro Mini) pins 0-7 are PORTD,
+   8-13 PORTB and A0-A5 PORTC. PWM is available on the Timer0 and
+   Timer1 pins 5, 6, 9 and 10, which are the ones every supported
+   driver uses; Timer2 (pins 3 and 11) belongs to the scheduler
+   (scheduler.h).
+   Other boards fall back to digitalWrite()/analogWrite() behind the
+   same interface.
+   *************************************************************/
+
+#ifndef FAST_IO_H
+#define FAST_IO_H
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+  #define FAST_IO
+#endif
+
+#ifdef FAST_IO
+
+template <uint8_t Pin>
+struct FastPin {
+  static_assert(Pin < 20, "FastPin: not an ATmega328P pin");
+
+  static const uint8_t mask = 1 << (Pin < 8 ? Pin : (Pin < 14 ? Pin - 8 : Pin - 14));
+
+  static inline volatile uint8_t &port() { return Pin < 8 ? PORTD : (Pin < 14 ? PORTB : PORTC); }
+  static inline volatile uint8_t &ddr()  { return Pin < 8 ? DDRD : (Pin < 14 ? DDRB : DDRC); }
+
+  static inline void output() { ddr() |= mask; }
+
+  static inline void set(bool high) {
+    if (high) port() |= mask;
+    else port() &= ~mask;
+  }
+};
+
+template <uint8_t Pin>
+struct FastPwm {
+  static_assert(Pin == 5 || Pin == 6 || Pin == 9 || Pin == 10,
+                "FastPwm: only the Timer0/Timer1 pins 5, 6, 9 and 10");
+
+  static const uint8_t com = Pin == 5 ? COM0B1 : Pin == 6 ? COM0A1 : Pin == 9 ? COM1A1 : COM1B1;
+
+  static inline volatile uint8_t &tccr() { return Pin == 5 || Pin == 6 ? TCCR0A : TCCR1A; }
+
+  static inline void output() { FastPin<Pin>::output(); }
+
+  /* analogWrite() semantics: 0 and 255 are plain levels with the
+     compare output disconnected, anything else is PWM */
+  static inline void duty(uint8_t value) {
+    if (value == 0 || value == 255) {
+      tccr() &= ~(1 << com);
+      FastPin<Pin>::set(value);
+      return;
+    }
+    switch (Pin) {
+      case 5:  OCR0B = value; break;
+      case 6:  OCR0A = value; break;
+      case 9:  OCR1A = value; break;
+      case 10: OCR1B = value; break;
+    }
+    tccr() |= (1 << com);
+  }
+};
+
+#else
+
+template <uint8_t Pin>
+struct FastPin {
+  static inline void output() { pinMode(Pin, OUTPUT); }
+  static inline void set(bool high) { digitalWrite(Pin, high ? HIGH : LOW); }
+};
+
+template <uint8_t Pin>
+struct FastPwm {
+  static inline void output() { pinMode(Pin, OUTPUT); }
+  static inline void duty(uint8_t value) { analogWrite(Pin, value); }
+};
+
+#endif // FAST_IO
+
+#endif // FAST_IO_H
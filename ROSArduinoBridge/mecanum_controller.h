@@ -22,20 +22,20 @@
 #define MECANUM_CONTROLLER_H
 
 /***************************************************************
-   Mecanum Wheel PID Structure
+   Mecanum Wheel PID Controller
    
-   Individual PID control structure for each mecanum wheel.
-   Based on the existing SetPointInfo structure but adapted
-   for 4-wheel independent control.
+   The four wheels as channels of the shared controller template
+   (controller.h). With two encoders the left wheels (FL, RL) read
+   LEFT and the right wheels (FR, RR) read RIGHT; the mapping is
+   resolved at compile time.
    *************************************************************/
-typedef struct {
-  double TargetTicksPerFrame;    // target speed in ticks per frame
-  long Encoder;                  // encoder count
-  long PrevEnc;                  // last encoder count
-  int PrevInput;                 // last input (for derivative kick avoidance)
-  int ITerm;                     // integrated term
-  long output;                   // last motor PWM setting
-} MecanumWheelPID;
+struct MecanumMotors {
+  static inline void write(const long *output) {
+    setMecanumMotorSpeeds(output[0], output[1], output[2], output[3]);
+  }
+};
+
+typedef Controller<4, EncoderMap<4>, MecanumMotors> MecanumController;
 
 /***************************************************************
    Mecanum Kinematics Parameters
@@ -49,19 +49,40 @@ typedef struct {
   float trackWidth;       // Distance between front and rear wheels in meters
   float maxLinearVel;     // Maximum linear velocity in m/s
   float maxAngularVel;    // Maximum angular velocity in rad/s
+  float ticksPerRev;      // Encoder ticks per wheel revolution
 } MecanumParams;
 
+/***************************************************************
+   Inverse Kinematics
+
+   MECANUM_TWIST takes vx, vy (mm/s) and wz (mrad/s) and turns them
+   into a target of every wheel in ticks per frame, Q8 as the PID
+   kernel expects. The 4x3 matrix from twist to wheel targets
+   depends only on mecanumParams, so mecanumUpdateKinematics()
+   builds it once in floating point and every twist is then three
+   integer multiply-adds per wheel:
+
+     target[i] = sum_j mecanumIK[i][j] * twist[j] / 2^MECANUM_IK_SHIFT
+
+   Call mecanumUpdateKinematics() after changing mecanumParams.
+   *************************************************************/
+
+#define MECANUM_IK_SHIFT 8   // extra fraction bits of the matrix over Q8
+
+// Q8 ticks per frame per unit of vx, vy, wz, scaled by 2^MECANUM_IK_SHIFT
+extern long mecanumIK[4][3];
+
 /***************************************************************
    Global Variables
    *************************************************************/
 
-// PID control structures for each wheel
-extern MecanumWheelPID wheelPID[4];
+// PID state of the four wheels (FL, FR, RL, RR)
+extern MecanumController wheelPID;
 
 // Mecanum kinematics parameters (initialized with default values)
 extern MecanumParams mecanumParams;
 
-// PID parameters (shared across all wheels)
+// Default PID parameters, given to every wheel by initMecanumParams()
 extern int MecanumKp;
 extern int MecanumKd; 
 extern int MecanumKi;
@@ -88,18 +109,35 @@ void resetMecanumPID();
 void updateMecanumPID();
 
 /*
- * Individual wheel PID calculation
- * Computes PID output for a single wheel
- * 
- * @param p Pointer to MecanumWheelPID structure for the wheel
- * @param wheelIndex Index of the wheel (0-3) for encoder reading
+ * Rebuild the inverse kinematics matrix from mecanumParams
+ */
+void mecanumUpdateKinematics();
+
+/*
+ * Convert a twist into per-wheel targets with the precomputed matrix
+ * The twist is clamped to maxLinearVel and maxAngularVel first
+ *
+ * @param vx Linear velocity in x direction (forward/backward) in mm/s
+ * @param vy Linear velocity in y direction (left positive) in mm/s
+ * @param wz Angular velocity around z axis (counter-clockwise) in mrad/s
+ * @param targetQ8 Output array of 4 wheel targets, Q8 ticks per frame
+ */
+void mecanumTwistToTargets(long vx, long vy, long wz, long *targetQ8);
+
+/*
+ * Drive the robot with a twist (MECANUM_TWIST)
+ * With encoders the wheel targets go to the PID; without them the
+ * wheels are driven open-loop, see mecanumTwistToWheels()
+ *
+ * @param vx, vy Linear velocity in mm/s
+ * @param wz Angular velocity in mrad/s
  */
-void doMecanumPID(MecanumWheelPID * p, int wheelIndex);
+void setMecanumTwist(long vx, long vy, long wz);
 
 /*
- * Convert twist commands to individual wheel speeds
- * Implements mecanum wheel kinematics to convert desired robot
- * velocity (vx, vy, wz) into individual wheel speeds
+ * Convert twist commands to individual wheel speeds (open-loop)
+ * Each wheel gets a PWM proportional to its rim speed, with
+ * maxLinearVel as full scale; see scaleMecanumSpeeds()
  * 
  * @param vx Linear velocity in x direction (forward/backward) in m/s
  * @param vy Linear velocity in y direction (left/right) in m/s  
@@ -139,9 +177,10 @@ void setMecanumDirectSpeeds(int fl, int fr, int rl, int rr);
 
 /*
  * Convert wheel speeds from m/s to ticks per frame
- * Utility function for converting physical velocities to encoder units
+ * Utility function for converting physical velocities to encoder units,
+ * from the wheel radius and the encoder ticks per revolution
  * 
- * @param wheelSpeed_ms Wheel speed in meters per second
+ * @param wheelSpeed_ms Wheel rim speed in meters per second
  * @return Equivalent speed in ticks per frame
  */
 double wheelSpeedToTicksPerFrame(float wheelSpeed_ms);
@@ -157,7 +196,9 @@ void scaleMecanumSpeeds(int* wheelSpeeds);
 
 /*
  * Initialize mecanum parameters with default values
- * Sets up default robot dimensions and velocity limits
+ * Sets up default robot dimensions and velocity limits, builds
+ * the inverse kinematics matrix and gives every wheel the default
+ * gains
  * Can be called during setup or when parameters need to be reset
  */
 void initMecanumParams();
@@ -172,6 +213,7 @@ void initMecanumParams();
 
 // Mecanum wheel kinematic coefficients
 // For standard mecanum wheel arrangement (45-degree rollers)
+// Rim speed = VX * vx + VY * vy + WZ * (wheelBase + trackWidth) / 2 * wz
 #define MECANUM_FL_VX_COEFF   1.0    // Front left X coefficient
 #define MECANUM_FL_VY_COEFF  -1.0    // Front left Y coefficient  
 #define MECANUM_FL_WZ_COEFF  -1.0    // Front left rotation coefficient
@@ -200,6 +242,7 @@ void initMecanumParams();
 #define DEFAULT_TRACK_WIDTH      0.25    // 250mm between front/rear wheels  
 #define DEFAULT_MAX_LINEAR_VEL   1.0     // 1 m/s maximum linear velocity
 #define DEFAULT_MAX_ANGULAR_VEL  2.0     // 2 rad/s maximum angular velocity
+#define DEFAULT_TICKS_PER_REV    (TICKS_PER_METER * 2 * PI * DEFAULT_WHEEL_RADIUS)
 
 /***************************************************************
    Velocity Scaling Constants
@@ -209,6 +252,6 @@ void initMecanumParams();
 
 #define VEL_SCALE_FACTOR        100.0    // Scale factor for twist command parsing
 #define PWM_TO_VELOCITY_RATIO   0.01     // Approximate PWM to m/s conversion
-#define TICKS_PER_METER         1000     // Encoder ticks per meter (adjust for your setup)
+#define TICKS_PER_METER         1000     // Encoder ticks per meter of default wheel travel
 
 #endif // MECANUM_CONTROLLER_H
\ No newline at end of file
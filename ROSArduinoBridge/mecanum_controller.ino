@@ -11,8 +11,8 @@
    Global Variable Definitions
    *************************************************************/
 
-// PID control structures for each wheel (FL, FR, RL, RR)
-MecanumWheelPID wheelPID[4];
+// PID state of the four wheels (FL, FR, RL, RR)
+MecanumController wheelPID;
 
 // Mecanum kinematics parameters
 MecanumParams mecanumParams;
@@ -29,6 +29,12 @@ unsigned char mecanumMoving = 0;
 // Current motor speeds for open-loop operation
 int currentMecanumSpeeds[4] = {0, 0, 0, 0}; // FL, FR, RL, RR
 
+// Inverse kinematics, rebuilt by mecanumUpdateKinematics()
+long mecanumIK[4][3];
+long mecanumFullScaleQ8;   // wheel target at maxLinearVel (open-loop full PWM)
+long mecanumMaxLinear;     // mm/s
+long mecanumMaxAngular;    // mrad/s
+
 /***************************************************************
    Mecanum PID Control Functions
    *************************************************************/
@@ -38,140 +44,111 @@ int currentMecanumSpeeds[4] = {0, 0, 0, 0}; // FL, FR, RL, RR
  * Resets all PID variables to prevent startup spikes
  */
 void resetMecanumPID() {
-  for (int i = 0; i < 4; i++) {
-    wheelPID[i].TargetTicksPerFrame = 0.0;
-    
-    #ifndef NO_ENCODERS
-      wheelPID[i].Encoder = readEncoder(i);
-      wheelPID[i].PrevEnc = wheelPID[i].Encoder;
-    #else
-      wheelPID[i].Encoder = 0;
-      wheelPID[i].PrevEnc = 0;
-    #endif
-    
-    wheelPID[i].output = 0;
-    wheelPID[i].PrevInput = 0;
-    wheelPID[i].ITerm = 0;
-  }
+  wheelPID.reset();
 }
 
 /*
- * Individual wheel PID calculation
- * Based on the existing doPID function but adapted for mecanum wheels
+ * Main mecanum PID update function
+ * Updates all four wheel PID controllers and sets motor speeds
  */
-void doMecanumPID(MecanumWheelPID * p, int wheelIndex) {
-  long Perror;
-  long output;
-  int input;
-
-  #ifndef NO_ENCODERS
-    // Map mecanum wheel indices to available encoders
-    // For 2-encoder systems: FL+RL use LEFT encoder, FR+RR use RIGHT encoder
-    // For 4-encoder systems: direct mapping (when available)
-    int encoderIndex;
-    if (getEncoderCount() >= 4) {
-      // Direct mapping for 4-encoder systems
-      encoderIndex = wheelIndex;
-    } else {
-      // Map to 2-encoder system: left wheels (0,2) -> LEFT, right wheels (1,3) -> RIGHT
-      encoderIndex = (wheelIndex == 0 || wheelIndex == 2) ? LEFT : RIGHT;
-    }
-    
-    p->Encoder = readEncoder(encoderIndex);
-    input = p->Encoder - p->PrevEnc;
+void updateMecanumPID() {
+  #ifdef NO_ENCODERS
+    // In open-loop mode, use direct motor control; the snapshot still
+    // dates the tick for telemetry
+    wheelPID.latch();
+    updateDirectMecanum();
   #else
-    // In encoder-less mode, assume perfect tracking
-    input = (int)p->TargetTicksPerFrame;
-    p->Encoder += input;
+    // If not moving, the controller resets once to prevent startup spikes
+    wheelPID.update(mecanumMoving);
   #endif
+}
 
-  Perror = p->TargetTicksPerFrame - input;
+/***************************************************************
+   Mecanum Kinematics Functions
+   *************************************************************/
 
-  // PID calculation with derivative kick avoidance
-  output = (MecanumKp * Perror - MecanumKd * (input - p->PrevInput) + p->ITerm) / MecanumKo;
-  p->PrevEnc = p->Encoder;
+/*
+ * Rebuild the inverse kinematics matrix from mecanumParams
+ * The only floating point of the twist path, run when the params change
+ */
+void mecanumUpdateKinematics() {
+  static const float coeff[4][3] = {
+    { MECANUM_FL_VX_COEFF, MECANUM_FL_VY_COEFF, MECANUM_FL_WZ_COEFF },
+    { MECANUM_FR_VX_COEFF, MECANUM_FR_VY_COEFF, MECANUM_FR_WZ_COEFF },
+    { MECANUM_RL_VX_COEFF, MECANUM_RL_VY_COEFF, MECANUM_RL_WZ_COEFF },
+    { MECANUM_RR_VX_COEFF, MECANUM_RR_VY_COEFF, MECANUM_RR_WZ_COEFF },
+  };
+  const float scale = PID_ONE * (float)(1L << MECANUM_IK_SHIFT);
 
-  output += p->output;
-  
-  // Clamp output to PWM limits and handle integral windup
-  if (output >= MAX_PWM) {
-    output = MAX_PWM;
-  } else if (output <= -MAX_PWM) {
-    output = -MAX_PWM;
-  } else {
-    // Only accumulate integral term if output is not saturated
-    p->ITerm += MecanumKi * Perror;
+  // Rim speed of 1 mm/s, and of 1 mrad/s of rotation about the center
+  float perLinear = wheelSpeedToTicksPerFrame(0.001) * scale;
+  float leverArm = (mecanumParams.wheelBase + mecanumParams.trackWidth) / 2;
+  float perAngular = wheelSpeedToTicksPerFrame(0.001 * leverArm) * scale;
+
+  for (uint8_t i = 0; i < 4; i++) {
+    mecanumIK[i][0] = lround(coeff[i][0] * perLinear);
+    mecanumIK[i][1] = lround(coeff[i][1] * perLinear);
+    mecanumIK[i][2] = lround(coeff[i][2] * perAngular);
   }
 
-  p->output = output;
-  p->PrevInput = input;
+  mecanumFullScaleQ8 = lround(wheelSpeedToTicksPerFrame(mecanumParams.maxLinearVel) * PID_ONE);
+  if (mecanumFullScaleQ8 < 1) mecanumFullScaleQ8 = 1;
+  mecanumMaxLinear = lround(mecanumParams.maxLinearVel * 1000);
+  mecanumMaxAngular = lround(mecanumParams.maxAngularVel * 1000);
+
+  #ifdef USE_ODOMETRY
+    odometryUpdateGeometry();
+  #endif
 }
 
 /*
- * Main mecanum PID update function
- * Updates all four wheel PID controllers and sets motor speeds
+ * Convert a twist into per-wheel targets with the precomputed matrix
  */
-void updateMecanumPID() {
-  #ifdef NO_ENCODERS
-    // In open-loop mode, use direct motor control
-    updateDirectMecanum();
-    return;
-  #endif
-
-  // If not moving, reset PID once to prevent startup spikes
-  if (!mecanumMoving) {
-    if (wheelPID[0].PrevInput != 0 || wheelPID[1].PrevInput != 0 || 
-        wheelPID[2].PrevInput != 0 || wheelPID[3].PrevInput != 0) {
-      resetMecanumPID();
-    }
-    return;
+void mecanumTwistToTargets(long vx, long vy, long wz, long *targetQ8) {
+  vx = constrain(vx, -mecanumMaxLinear, mecanumMaxLinear);
+  vy = constrain(vy, -mecanumMaxLinear, mecanumMaxLinear);
+  wz = constrain(wz, -mecanumMaxAngular, mecanumMaxAngular);
+  for (uint8_t i = 0; i < 4; i++) {
+    long sum = mecanumIK[i][0] * vx + mecanumIK[i][1] * vy + mecanumIK[i][2] * wz;
+    targetQ8[i] = sum / (1L << MECANUM_IK_SHIFT);
   }
+}
 
-  // Update PID for each wheel
-  for (int i = 0; i < 4; i++) {
-    doMecanumPID(&wheelPID[i], i);
+/* Open-loop PWM in proportion to the wheel targets */
+void mecanumTargetsToPwm(const long *targetQ8, int *wheelSpeeds) {
+  for (uint8_t i = 0; i < 4; i++) {
+    long pwm = targetQ8[i] * MAX_PWM / mecanumFullScaleQ8;
+    // Scaled back below with the others if out of range
+    wheelSpeeds[i] = constrain(pwm, -32767L, 32767L);
   }
-
-  // Set motor speeds based on PID outputs
-  setMecanumMotorSpeeds(
-    (int)wheelPID[0].output,  // Front Left
-    (int)wheelPID[1].output,  // Front Right
-    (int)wheelPID[2].output,  // Rear Left
-    (int)wheelPID[3].output   // Rear Right
-  );
+  scaleMecanumSpeeds(wheelSpeeds);
 }
 
-/***************************************************************
-   Mecanum Kinematics Functions
-   *************************************************************/
+/*
+ * Drive the robot with a twist (MECANUM_TWIST)
+ */
+void setMecanumTwist(long vx, long vy, long wz) {
+  long targetQ8[4];
+  mecanumTwistToTargets(vx, vy, wz, targetQ8);
+
+  #ifdef NO_ENCODERS
+    int pwm[4];
+    mecanumTargetsToPwm(targetQ8, pwm);
+    setMecanumDirectSpeeds(pwm[0], pwm[1], pwm[2], pwm[3]);
+  #else
+    for (uint8_t i = 0; i < 4; i++) wheelPID.targetQ8[i] = targetQ8[i];
+    mecanumMoving = (targetQ8[0] != 0 || targetQ8[1] != 0 || targetQ8[2] != 0 || targetQ8[3] != 0) ? 1 : 0;
+  #endif
+}
 
 /*
  * Convert twist commands to individual wheel speeds
  * Implements standard mecanum wheel kinematics for open-loop control
  */
 void mecanumTwistToWheels(float vx, float vy, float wz, int* wheelSpeeds) {
-  // Simplified mecanum kinematics for open-loop operation
-  // Input velocities are treated as normalized values (-1.0 to 1.0)
-  // and converted directly to PWM values
-  
-  // Standard mecanum wheel equations for 45-degree rollers
-  // Simplified without complex robot dimension calculations
-  float robotRadius = 1.0; // Normalized robot radius for rotation
-  
-  // Calculate wheel velocities using standard mecanum kinematics
-  float fl = vx - vy - wz * robotRadius;  // Front Left
-  float fr = vx + vy + wz * robotRadius;  // Front Right  
-  float rl = vx + vy - wz * robotRadius;  // Rear Left
-  float rr = vx - vy + wz * robotRadius;  // Rear Right
-  
-  // Convert to PWM values (scale by MAX_PWM for full range)
-  wheelSpeeds[0] = (int)(fl * MAX_PWM);  // Front Left
-  wheelSpeeds[1] = (int)(fr * MAX_PWM);  // Front Right
-  wheelSpeeds[2] = (int)(rl * MAX_PWM);  // Rear Left
-  wheelSpeeds[3] = (int)(rr * MAX_PWM);  // Rear Right
-  
-  // Scale speeds proportionally if any exceed limits
-  scaleMecanumSpeeds(wheelSpeeds);
+  long targetQ8[4];
+  mecanumTwistToTargets(lround(vx * 1000), lround(vy * 1000), lround(wz * 1000), targetQ8);
+  mecanumTargetsToPwm(targetQ8, wheelSpeeds);
 }
 
 /*
@@ -204,10 +181,10 @@ void scaleMecanumSpeeds(int* wheelSpeeds) {
  * Set target speeds for all mecanum wheels (PID mode)
  */
 void setMecanumTargetSpeeds(double fl, double fr, double rl, double rr) {
-  wheelPID[0].TargetTicksPerFrame = fl;  // Front Left
-  wheelPID[1].TargetTicksPerFrame = fr;  // Front Right
-  wheelPID[2].TargetTicksPerFrame = rl;  // Rear Left
-  wheelPID[3].TargetTicksPerFrame = rr;  // Rear Right
+  wheelPID.targetQ8[0] = (long)(fl * PID_ONE);  // Front Left
+  wheelPID.targetQ8[1] = (long)(fr * PID_ONE);  // Front Right
+  wheelPID.targetQ8[2] = (long)(rl * PID_ONE);  // Rear Left
+  wheelPID.targetQ8[3] = (long)(rr * PID_ONE);  // Rear Right
   
   // Set moving flag if any wheel has a non-zero target
   mecanumMoving = (fl != 0 || fr != 0 || rl != 0 || rr != 0) ? 1 : 0;
@@ -234,9 +211,9 @@ void setMecanumDirectSpeeds(int fl, int fr, int rl, int rr) {
  * Convert wheel speeds from m/s to ticks per frame
  */
 double wheelSpeedToTicksPerFrame(float wheelSpeed_ms) {
-  // Convert m/s to ticks per frame
-  // This assumes a certain encoder resolution and control loop frequency
-  double ticksPerSecond = wheelSpeed_ms * TICKS_PER_METER;
+  // Wheel revolutions per second from the rim speed, then ticks
+  double revsPerSecond = wheelSpeed_ms / (2 * PI * mecanumParams.wheelRadius);
+  double ticksPerSecond = revsPerSecond * mecanumParams.ticksPerRev;
   double ticksPerFrame = ticksPerSecond / PID_RATE;
   return ticksPerFrame;
 }
@@ -269,6 +246,11 @@ void initMecanumParams() {
   mecanumParams.trackWidth = DEFAULT_TRACK_WIDTH;
   mecanumParams.maxLinearVel = DEFAULT_MAX_LINEAR_VEL;
   mecanumParams.maxAngularVel = DEFAULT_MAX_ANGULAR_VEL;
+  mecanumParams.ticksPerRev = DEFAULT_TICKS_PER_REV;
+  mecanumUpdateKinematics();
+
+  // The same gains on every wheel until the configuration sets its own
+  wheelPID.setGains(MecanumKp, MecanumKd, MecanumKi, MecanumKo);
 }
 
 #endif // USE_MECANUM
\ No newline at end of file
@@ -7,103 +7,86 @@
 
 /***************************************************************
    Motor Driver Pin Definitions and Configuration
+
+   The pins of every driver are defined whichever is selected, so
+   every policy below compiles in every build; only the selected
+   driver's pins are wired and touched.
    *************************************************************/
 
-#ifdef L298_MOTOR_DRIVER
-  // L298 Motor Driver Pin Configuration
-  #define RIGHT_MOTOR_BACKWARD 5
-  #define LEFT_MOTOR_BACKWARD  6
-  #define RIGHT_MOTOR_FORWARD  9
-  #define LEFT_MOTOR_FORWARD   10
-  #define RIGHT_MOTOR_ENABLE 12
-  #define LEFT_MOTOR_ENABLE 13
-  
-  // Compile-time validation for L298
-  #if defined(USE_MECANUM)
-    #error "L298 motor driver does not support mecanum mode (4-motor control). Use TB6612 or compatible driver."
-  #endif
+// L298 Motor Driver Pin Configuration
+#define RIGHT_MOTOR_BACKWARD 5
+#define LEFT_MOTOR_BACKWARD  6
+#define RIGHT_MOTOR_FORWARD  9
+#define LEFT_MOTOR_FORWARD   10
+#define RIGHT_MOTOR_ENABLE 12
+#define LEFT_MOTOR_ENABLE 13
 
-#elif defined(ZKBM1_MOTOR_DRIVER)
-  // ZKBM1 Motor Driver Pin Configuration
-  #define DRIVE_PWM_IN1 5
-  #define DRIVE_PWM_IN2 6 
-  #define STEER_PWM_IN3 9
-  #define STEER_PWM_IN4 10
-  
-  // Compile-time validation for ZKBM1
-  #if defined(USE_MECANUM)
-    #error "ZKBM1 motor driver does not support mecanum mode (4-motor control). Use TB6612 or compatible driver."
-  #endif
+// ZKBM1 Motor Driver Pin Configuration
+#define DRIVE_PWM_IN1 5
+#define DRIVE_PWM_IN2 6
+#define STEER_PWM_IN3 9
+#define STEER_PWM_IN4 10
 
-#elif defined(SPARKFUN_TB6612)
-  /***************************************************************
+/***************************************************************
    TB6612 Motor Driver Pin Configuration
-   
+
    This configuration supports both 2-motor differential drive
    and 4-motor mecanum drive modes.
-   
+
    Pin Layout:
    - Left Driver (TB6612 #1): Controls FL and RL motors
    - Right Driver (TB6612 #2): Controls FR and RR motors
-   
+
    Wiring Notes:
    - Ensure PWM pins are connected to PWM-capable Arduino pins
    - STBY pins must be connected to digital pins and pulled HIGH to enable
    - Motor direction pins (AIN1, AIN2, BIN1, BIN2) control motor direction
    *************************************************************/
-  
-  // Left TB6612 Driver (Controls Front-Left and Rear-Left motors)
-  #define L_AIN1 2      // Left Motor A Direction Pin 1 (Motor 1)
-  #define L_AIN2 4      // Left Motor A Direction Pin 2 (Motor 1)
-  #define L_PWMA 5      // Left Motor A PWM Pin (Motor 1)
-  
-  #define L_BIN1 7      // Left Motor B Direction Pin 1 (Motor 2)
-  #define L_BIN2 8      // Left Motor B Direction Pin 2 (Motor 2)
-  #define L_PWMB 6      // Left Motor B PWM Pin (Motor 2)
-  
-  #define L_STBY A2     // Left TB6612 Standby Pin (HIGH = enabled)
-
-  // Right TB6612 Driver (Controls Front-Right and Rear-Right motors)
-  #define R_AIN1 0      // Right Motor A Direction Pin 1 (Motor 3)
-  #define R_AIN2 1      // Right Motor A Direction Pin 2 (Motor 3)
-  #define R_PWMA 9      // Right Motor A PWM Pin (Motor 3)
-
-  #define R_BIN1 11     // Right Motor B Direction Pin 1 (Motor 4)
-  #define R_BIN2 12     // Right Motor B Direction Pin 2 (Motor 4)
-  #define R_PWMB 10     // Right Motor B PWM Pin (Motor 4)
-
-  #define R_STBY A3     // Right TB6612 Standby Pin (HIGH = enabled)
-
-  // Motor Direction Offsets (change to -1 if motor spins in wrong direction)
-  #define OFFSET_L1  1  // Motor 1 (Left Driver Motor A) direction offset
-  #define OFFSET_L2  1  // Motor 2 (Left Driver Motor B) direction offset  
-  #define OFFSET_R1  1  // Motor 3 (Right Driver Motor A) direction offset
-  #define OFFSET_R2  1  // Motor 4 (Right Driver Motor B) direction offset
-
-  // Motor Trim Values (fine-tuning for straight movement)
-  #define TRIM_L1    0  // Motor 1 PWM trim offset
-  #define TRIM_L2    0  // Motor 2 PWM trim offset
-  #define TRIM_R1    0  // Motor 3 PWM trim offset
-  #define TRIM_R2    0  // Motor 4 PWM trim offset
-
-  // Motor Control Parameters
-  #define PWM_MAX           255  // Maximum PWM value (8-bit)
-  #define MOTOR_DEADZONE    30   // Minimum PWM to overcome motor friction (0-80)
-  #define MOTOR_SLEW_RATE   8    // Maximum PWM change per control loop (1-30)
-
-  /***************************************************************
-   TB6612 Pin Configuration - Tested Working Configuration
-   
-   Pin conflict validation has been removed as this is a tested,
-   working configuration that uses valid pin assignments.
-   *************************************************************/
 
-#else
-  #error "No motor driver selected! Please define one of: L298_MOTOR_DRIVER, ZKBM1_MOTOR_DRIVER, SPARKFUN_TB6612"
-#endif
+// Left TB6612 Driver (Controls Front-Left and Rear-Left motors)
+#define L_AIN1 2      // Left Motor A Direction Pin 1 (Motor 1)
+#define L_AIN2 4      // Left Motor A Direction Pin 2 (Motor 1)
+#define L_PWMA 5      // Left Motor A PWM Pin (Motor 1)
+
+#define L_BIN1 7      // Left Motor B Direction Pin 1 (Motor 2)
+#define L_BIN2 8      // Left Motor B Direction Pin 2 (Motor 2)
+#define L_PWMB 6      // Left Motor B PWM Pin (Motor 2)
+
+#define L_STBY A2     // Left TB6612 Standby Pin (HIGH = enabled)
+
+// Right TB6612 Driver (Controls Front-Right and Rear-Right motors)
+#define R_AIN1 0      // Right Motor A Direction Pin 1 (Motor 3)
+#define R_AIN2 1      // Right Motor A Direction Pin 2 (Motor 3)
+#define R_PWMA 9      // Right Motor A PWM Pin (Motor 3)
+
+#define R_BIN1 11     // Right Motor B Direction Pin 1 (Motor 4)
+#define R_BIN2 12     // Right Motor B Direction Pin 2 (Motor 4)
+#define R_PWMB 10     // Right Motor B PWM Pin (Motor 4)
+
+#define R_STBY A3     // Right TB6612 Standby Pin (HIGH = enabled)
+
+// Motor Direction Offsets (change to -1 if motor spins in wrong direction)
+#define OFFSET_L1  1  // Motor 1 (Left Driver Motor A) direction offset
+#define OFFSET_L2  1  // Motor 2 (Left Driver Motor B) direction offset
+#define OFFSET_R1  1  // Motor 3 (Right Driver Motor A) direction offset
+#define OFFSET_R2  1  // Motor 4 (Right Driver Motor B) direction offset
+
+// Motor Trim Values (fine-tuning for straight movement)
+#define TRIM_L1    0  // Motor 1 PWM trim offset
+#define TRIM_L2    0  // Motor 2 PWM trim offset
+#define TRIM_R1    0  // Motor 3 PWM trim offset
+#define TRIM_R2    0  // Motor 4 PWM trim offset
+
+// Motor Control Parameters
+#define PWM_MAX           255  // Maximum PWM value (8-bit)
+#define MOTOR_DEADZONE    30   // Minimum PWM to overcome motor friction (0-80)
+#define MOTOR_SLEW_RATE   8    // Maximum PWM change per control loop (1-30)
 
 /***************************************************************
    Motor Driver Function Declarations
+
+   Implemented once, for whichever driver is selected below.
+   setMotorSpeed() gives both sides the same speed.
    *************************************************************/
 
 void initMotorController();
@@ -114,14 +97,245 @@ void setMotorSpeeds(int leftSpeed, int rightSpeed);
   void setMecanumMotorSpeeds(int fl, int fr, int rl, int rr);
 #endif
 
+/***************************************************************
+   Motor Channel Output
+
+   The channels below write their pins through fast_io.h and
+   remember the signed output they applied last, so the control
+   tick re-sending an unchanged speed costs a compare instead of
+   three pin writes. Anything that writes motor pins behind their
+   back (initMotorController(), the raw pin commands) must call
+   forgetMotorOutputs() so the next speed is written in full.
+   *************************************************************/
+
+/* Never a valid output: forces the next write */
+#define MOTOR_OUTPUT_UNKNOWN 0x7FFF
+
+/* The output cache of a driver with N channels */
+template <class Driver, uint8_t N>
+struct MotorOutputs {
+  static const uint8_t CHANNELS = N;
+  static int applied[N];
+
+  static void forget() {
+    for (uint8_t i = 0; i < N; i++) applied[i] = MOTOR_OUTPUT_UNKNOWN;
+  }
+
+  /* False if channel I already has speed; otherwise remember it */
+  template <uint8_t I>
+  static inline bool change(int speed) {
+    static_assert(I < N, "MotorOutputs: no such channel");
+    if (speed == applied[I]) return false;
+    applied[I] = speed;
+    return true;
+  }
+};
+
+template <class Driver, uint8_t N>
+int MotorOutputs<Driver, N>::applied[N];
+
+/*
+ * One motor on a pair of PWM inputs (L298 forward/backward, ZKBM1
+ * IN1/IN2): the input for the other direction is switched off
+ * first, then the active one gets the duty.
+ */
+template <uint8_t Forward, uint8_t Backward>
+inline void driveBridge(int spd) {
+  if (spd >= 0) {
+    FastPwm<Backward>::duty(0);
+    FastPwm<Forward>::duty(spd);
+  } else {
+    FastPwm<Forward>::duty(0);
+    FastPwm<Backward>::duty(-spd);
+  }
+}
+
+/***************************************************************
+   Motor Driver Policies
+
+   Every driver is a class of static members with one shape:
+
+     CHANNELS                  motor outputs
+     LEFT_SIDE, RIGHT_SIDE     bit masks of the channels the left
+                               and right speed of setMotorSpeeds()
+                               drive
+     FL FR RL RR               channel of each mecanum wheel
+                               (four-channel drivers only)
+     init()                    pins and enables
+     write<I>(speed)           channel I to a signed speed,
+                               -255 .. 255
+
+   The rest of the firmware only sees MotorDriver, the one policy
+   selected at the bottom of this file, so write<I>() with its
+   constant channel inlines into the control tick down to the pin
+   writes and nothing is looked up at run time. A new driver is a
+   new class plus a line in the selection.
+   *************************************************************/
+
+/* Direction offset and trim per TB6612 channel and the deadzone.
+   They start as OFFSET_*, TRIM_* and MOTOR_DEADZONE; the stored
+   configuration (config.h) can change them at run time. */
+extern int8_t motorOffset[4];
+extern int motorTrim[4];
+extern uint8_t motorDeadzone;
+
+/* Pins of each TB6612 channel: L1 L2 R1 R2 */
+template <uint8_t I> struct TB6612Channel;
+template <> struct TB6612Channel<0> { static const uint8_t IN1 = L_AIN1, IN2 = L_AIN2, PWM = L_PWMA; };
+template <> struct TB6612Channel<1> { static const uint8_t IN1 = L_BIN1, IN2 = L_BIN2, PWM = L_PWMB; };
+template <> struct TB6612Channel<2> { static const uint8_t IN1 = R_AIN1, IN2 = R_AIN2, PWM = R_PWMA; };
+template <> struct TB6612Channel<3> { static const uint8_t IN1 = R_BIN1, IN2 = R_BIN2, PWM = R_PWMB; };
+
+/* Two TB6612s: one per side, two motors each */
+struct TB6612Motors : MotorOutputs<TB6612Motors, 4> {
+  static const uint8_t LEFT_SIDE = 0x03;
+  static const uint8_t RIGHT_SIDE = 0x0C;
+  static const uint8_t FL = 0, RL = 1, FR = 2, RR = 3;
+
+  static void init();
+
+  /* Direction offset, trim, clamping and deadzone, then IN1/IN2
+     and the PWM duty */
+  template <uint8_t I>
+  static inline void write(int speed) {
+    speed = constrain(speed * motorOffset[I] + motorTrim[I], -PWM_MAX, PWM_MAX);
+
+    // Apply deadzone compensation
+    if (speed > 0 && speed < motorDeadzone) {
+      speed = motorDeadzone;
+    } else if (speed < 0 && speed > -motorDeadzone) {
+      speed = -motorDeadzone;
+    }
+
+    if (!change<I>(speed)) return;
+
+    // Forward: IN1 high, reverse: IN2 high, stop: both low (brake)
+    FastPin<TB6612Channel<I>::IN1>::set(speed > 0);
+    FastPin<TB6612Channel<I>::IN2>::set(speed < 0);
+    FastPwm<TB6612Channel<I>::PWM>::duty(speed > 0 ? speed : -speed);
+  }
+};
+
+/* L298: LEFT and RIGHT, PWM on the direction inputs */
+struct L298Motors : MotorOutputs<L298Motors, 2> {
+  static const uint8_t LEFT_SIDE = 1 << LEFT;
+  static const uint8_t RIGHT_SIDE = 1 << RIGHT;
+
+  static void init();
+
+  template <uint8_t I>
+  static inline void write(int speed) {
+    speed = constrain(speed, -255, 255);
+    if (!change<I>(speed)) return;
+    if (I == LEFT) driveBridge<LEFT_MOTOR_FORWARD, LEFT_MOTOR_BACKWARD>(speed);
+    else driveBridge<RIGHT_MOTOR_FORWARD, RIGHT_MOTOR_BACKWARD>(speed);
+  }
+};
+
+/* ZKBM1: one drive motor, taking the left speed, and the steering
+   motor, which only the steering controller moves (steering.h) */
+struct ZKBM1Motors : MotorOutputs<ZKBM1Motors, 2> {
+  static const uint8_t LEFT_SIDE = 1 << DRIVE;
+  static const uint8_t RIGHT_SIDE = 0;
+
+  static void init();
+
+  template <uint8_t I>
+  static inline void write(int speed) {
+    speed = constrain(speed, -255, 255);
+    if (!change<I>(speed)) return;
+    if (I == DRIVE) driveBridge<DRIVE_PWM_IN1, DRIVE_PWM_IN2>(speed);
+    else driveBridge<STEER_PWM_IN3, STEER_PWM_IN4>(speed);
+  }
+};
+
+/* The Pololu dual shields, through their libraries; M1 is LEFT */
+template <class Shield>
+struct PololuMotors : MotorOutputs<PololuMotors<Shield>, 2> {
+  typedef MotorOutputs<PololuMotors<Shield>, 2> Outputs;
+
+  static const uint8_t LEFT_SIDE = 1 << LEFT;
+  static const uint8_t RIGHT_SIDE = 1 << RIGHT;
+
+  static Shield shield;
+
+  static void init() {
+    Outputs::forget();
+    shield.init();
+  }
+
+  template <uint8_t I>
+  static inline void write(int speed) {
+    if (!Outputs::template change<I>(speed)) return;
+    if (I == LEFT) shield.setM1Speed(speed);
+    else shield.setM2Speed(speed);
+  }
+};
+
+template <class Shield>
+Shield PololuMotors<Shield>::shield;
+
+/***************************************************************
+   Driver Selection
+   *************************************************************/
+
+#if defined(POLOLU_VNH5019)
+  #include "DualVNH5019MotorShield.h"
+  typedef PololuMotors<DualVNH5019MotorShield> MotorDriver;
+#elif defined(POLOLU_MC33926)
+  #include "DualMC33926MotorShield.h"
+  typedef PololuMotors<DualMC33926MotorShield> MotorDriver;
+#elif defined(L298_MOTOR_DRIVER)
+  typedef L298Motors MotorDriver;
+#elif defined(ZKBM1_MOTOR_DRIVER)
+  typedef ZKBM1Motors MotorDriver;
+#elif defined(SPARKFUN_TB6612)
+  typedef TB6612Motors MotorDriver;
+#else
+  #error "No motor driver selected! Please define one of: L298_MOTOR_DRIVER, ZKBM1_MOTOR_DRIVER, SPARKFUN_TB6612, POLOLU_VNH5019, POLOLU_MC33926"
+#endif
+
+#define MOTOR_CHANNELS MotorDriver::CHANNELS
+
+inline void forgetMotorOutputs() { MotorDriver::forget(); }
+
+/*
+ * Channels I-1 down to 0 of driver M from a left and a right
+ * speed, unrolled at compile time: a channel on neither side is
+ * left alone.
+ */
+template <class M, uint8_t I = M::CHANNELS>
+struct MotorSides {
+  static inline void write(int leftSpeed, int rightSpeed) {
+    MotorSides<M, I - 1>::write(leftSpeed, rightSpeed);
+    if (M::LEFT_SIDE & (1 << (I - 1))) M::template write<I - 1>(leftSpeed);
+    else if (M::RIGHT_SIDE & (1 << (I - 1))) M::template write<I - 1>(rightSpeed);
+  }
+};
+
+template <class M>
+struct MotorSides<M, 0> {
+  static inline void write(int, int) {}
+};
+
+/* The four mecanum wheels of driver M */
+template <class M>
+inline void driveWheels(int fl, int fr, int rl, int rr) {
+  static_assert(M::CHANNELS >= 4, "mecanum mode needs a four-channel motor driver");
+  M::template write<M::FL>(fl);
+  M::template write<M::RL>(rl);
+  M::template write<M::FR>(fr);
+  M::template write<M::RR>(rr);
+}
+
 /***************************************************************
    Steering Support Detection and Macro
    *************************************************************/
 
-// Define which motor drivers support steering
-#ifdef ZKBM1_MOTOR_DRIVER
+// Define which motor drivers support steering; the controller
+// (steering.h) holds a position, so it needs the encoders
+#if defined(ZKBM1_MOTOR_DRIVER) && !defined(NO_ENCODERS)
   #define HAS_STEERING_SUPPORT
-  void setSteeringDirection(int target_position);
 #endif
 
 // Macro for conditional steering calls
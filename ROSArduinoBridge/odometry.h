@@ -0,0 +1,82 @@
+/***************************************************************
+   Wheel odometry from the control tick's encoder snapshot
+
+   Every control tick integrates the pose from the encoder counts
+   the controller just latched. The forward kinematics depend on
+   the layout:
+
+     differential   LEFT and RIGHT are the two wheel sides,
+                    ODOM_TRACK_WIDTH apart
+     USE_MECANUM    the transpose of the MECANUM_*_COEFF matrix
+                    over the four wheels (EncoderMap<4>), with
+                    the lever arm (wheelBase + trackWidth) / 2
+
+   The pose is fixed point throughout: x and y in Q8 millimetres,
+   theta a 32-bit binary angle (2^32 = one turn), so it wraps
+   without a check. Each step is the midpoint rule with sin/cos from
+   a quarter-wave table in PROGMEM. The tick-to-distance factors are
+   built once in floating point by odometryUpdateGeometry() as a
+   15-bit multiplier and a shift.
+
+   READ_ODOMETRY replies "x y theta" in mm and mrad; "i 1" zeroes
+   the pose after reading it. TELEM_POSE streams the same values.
+
+   There is no odometry without encoders or on the ZKBM1 drive and
+   steering layout.
+   *************************************************************/
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#if !defined(NO_ENCODERS) && !defined(ZKBM1_MOTOR_DRIVER)
+  #define USE_ODOMETRY
+#endif
+
+#ifdef USE_ODOMETRY
+
+/* Differential layout geometry */
+#ifndef ODOM_TICKS_PER_METER
+  #define ODOM_TICKS_PER_METER 1000   // encoder ticks per metre of wheel travel
+#endif
+#ifndef ODOM_TRACK_WIDTH
+  #define ODOM_TRACK_WIDTH     0.30   // metres between the left and right wheels
+#endif
+
+/* n * factor as (n * mult) >> shift, rounded half away from zero */
+typedef struct {
+  long mult;
+  int8_t shift;
+} OdomScale;
+
+typedef struct {
+  long x;                // Q8 mm
+  long y;                // Q8 mm
+  uint32_t theta;        // binary angle, 2^32 = one turn
+} OdomPose;
+
+extern OdomPose odomPose;
+
+/* Rebuild the scale factors from the geometry (the mecanum params) */
+void odometryUpdateGeometry();
+
+/* Zero the pose and take the snapshot as the new reference */
+void initOdometry(const EncoderSnapshot &snapshot);
+
+/* Take the counts as the reference without moving the pose, e.g.
+   after the encoders were reset */
+void odometryRebase(const EncoderSnapshot &snapshot);
+
+/* Integrate the motion since the last snapshot; called from the
+   control tick */
+void odometryUpdate(const EncoderSnapshot &snapshot);
+
+/* sin of a binary angle, Q15 */
+int odomSin(uint32_t angle);
+
+/* The pose in wire units: mm, and mrad in [-pi, pi) */
+long odomMillimetres(long q8);
+long odomMilliradians(uint32_t angle);
+
+#endif // USE_ODOMETRY
+
+#endif // ODOMETRY_H
@@ -0,0 +1,154 @@
+/***************************************************************
+   Wheel odometry implementation
+   *************************************************************/
+
+#if defined(USE_BASE) && defined(USE_ODOMETRY)
+
+/* sin(i * pi / 256) in Q15: a quarter wave in 128 steps plus the
+   end point, interpolated linearly (error below 1 LSB) */
+const uint16_t odomSinTable[129] PROGMEM = {
+      0,   402,   804,  1206,  1608,  2009,  2410,  2811,
+   3212,  3612,  4011,  4410,  4808,  5205,  5602,  5998,
+   6393,  6786,  7179,  7571,  7962,  8351,  8739,  9126,
+   9512,  9896, 10278, 10659, 11039, 11417, 11793, 12167,
+  12539, 12910, 13279, 13645, 14010, 14372, 14732, 15090,
+  15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+  18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475,
+  20787, 21096, 21403, 21705, 22005, 22301, 22594, 22884,
+  23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+  25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019,
+  27245, 27466, 27683, 27896, 28105, 28310, 28510, 28706,
+  28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+  30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237,
+  31356, 31470, 31580, 31685, 31785, 31880, 31971, 32057,
+  32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+  32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765,
+  32767,
+};
+
+#define ODOM_QUARTER_TURN ((uint32_t)1 << 30)
+
+#ifdef USE_MECANUM
+/* Forward kinematics: the signs of the inverse kinematics matrix,
+   per wheel for x, y and the rotation */
+const int8_t odomSigns[4][3] = {
+  { MECANUM_FL_VX_COEFF > 0 ? 1 : -1, MECANUM_FL_VY_COEFF > 0 ? 1 : -1, MECANUM_FL_WZ_COEFF > 0 ? 1 : -1 },
+  { MECANUM_FR_VX_COEFF > 0 ? 1 : -1, MECANUM_FR_VY_COEFF > 0 ? 1 : -1, MECANUM_FR_WZ_COEFF > 0 ? 1 : -1 },
+  { MECANUM_RL_VX_COEFF > 0 ? 1 : -1, MECANUM_RL_VY_COEFF > 0 ? 1 : -1, MECANUM_RL_WZ_COEFF > 0 ? 1 : -1 },
+  { MECANUM_RR_VX_COEFF > 0 ? 1 : -1, MECANUM_RR_VY_COEFF > 0 ? 1 : -1, MECANUM_RR_WZ_COEFF > 0 ? 1 : -1 },
+};
+#endif
+
+OdomPose odomPose;
+long odomPrev[ENCODER_SNAPSHOT_SIZE];
+OdomScale odomLinear;    // tick sum -> Q8 mm
+OdomScale odomAngular;   // tick sum -> binary angle
+
+/* p / 2^shift, rounded half away from zero */
+long odomRound(long p, uint8_t shift) {
+  long half = 1L << (shift - 1);
+  return p >= 0 ? (p + half) >> shift : -((half - p) >> shift);
+}
+
+long odomApply(long n, const OdomScale &scale) {
+  long p = n * scale.mult;
+  if (scale.shift <= 0) return p * (1L << -scale.shift);
+  return odomRound(p, scale.shift);
+}
+
+/* The multiplier keeps 15 significant bits of the factor */
+void odomScaleFrom(OdomScale *scale, float factor) {
+  int8_t shift = 0;
+  while (factor >= 32768.0 && shift > -16) { factor /= 2; shift--; }
+  while (factor < 16384.0 && shift < 30) { factor *= 2; shift++; }
+  scale->mult = lround(factor);
+  scale->shift = shift;
+}
+
+void odometryUpdateGeometry() {
+  const float turn = 4294967296.0 / (2 * PI);  // binary angle per radian
+  #ifdef USE_MECANUM
+    // Four wheels in every sum; rotation about the center
+    float mmPerTick = 2 * PI * mecanumParams.wheelRadius * 1000 / mecanumParams.ticksPerRev;
+    float leverArm = (mecanumParams.wheelBase + mecanumParams.trackWidth) / 2 * 1000;
+    odomScaleFrom(&odomLinear, mmPerTick / 4 * 256);
+    odomScaleFrom(&odomAngular, mmPerTick / (4 * leverArm) * turn);
+  #else
+    // Left plus right, and right minus left over the track
+    float mmPerTick = 1000.0 / ODOM_TICKS_PER_METER;
+    odomScaleFrom(&odomLinear, mmPerTick / 2 * 256);
+    odomScaleFrom(&odomAngular, mmPerTick / (ODOM_TRACK_WIDTH * 1000) * turn);
+  #endif
+}
+
+void odometryRebase(const EncoderSnapshot &snapshot) {
+  for (uint8_t c = 0; c < ENCODER_SNAPSHOT_SIZE; c++) odomPrev[c] = snapshot.count[c];
+}
+
+void initOdometry(const EncoderSnapshot &snapshot) {
+  odometryUpdateGeometry();
+  odomPose.x = odomPose.y = 0;
+  odomPose.theta = 0;
+  odometryRebase(snapshot);
+}
+
+int odomSin(uint32_t angle) {
+  uint8_t quadrant = angle >> 30;
+  uint32_t a = angle & (ODOM_QUARTER_TURN - 1);
+  if (quadrant & 1) a = ODOM_QUARTER_TURN - a;  // sin(pi - x)
+
+  uint8_t i = a >> 23;
+  unsigned int frac = (a >> 7) & 0xFFFF;
+  long s = pgm_read_word(&odomSinTable[i]);
+  if (frac) s += ((long)pgm_read_word(&odomSinTable[i + 1]) - s) * frac >> 16;
+  return (quadrant & 2) ? -s : s;
+}
+
+void odometryUpdate(const EncoderSnapshot &snapshot) {
+  EncoderSnapshot delta;
+  for (uint8_t c = 0; c < ENCODER_SNAPSHOT_SIZE; c++) {
+    delta.count[c] = snapshot.count[c] - odomPrev[c];
+    odomPrev[c] = snapshot.count[c];
+  }
+
+  long forward = 0, lateral = 0, rotation = 0;
+  #ifdef USE_MECANUM
+    const long wheel[4] = {
+      EncoderMap<4>::read<0>(delta), EncoderMap<4>::read<1>(delta),
+      EncoderMap<4>::read<2>(delta), EncoderMap<4>::read<3>(delta),
+    };
+    for (uint8_t i = 0; i < 4; i++) {
+      forward += odomSigns[i][0] * wheel[i];
+      lateral += odomSigns[i][1] * wheel[i];
+      rotation += odomSigns[i][2] * wheel[i];
+    }
+  #else
+    forward = delta.count[LEFT] + delta.count[RIGHT];
+    rotation = delta.count[RIGHT] - delta.count[LEFT];
+  #endif
+  if (forward == 0 && lateral == 0 && rotation == 0) return;
+
+  // Midpoint rule: the step is taken at the mean heading of the frame
+  long ds = odomApply(forward, odomLinear);
+  long dl = odomApply(lateral, odomLinear);
+  long dtheta = odomApply(rotation, odomAngular);
+  uint32_t mid = odomPose.theta + (uint32_t)(dtheta / 2);
+  long s = odomSin(mid);
+  long c = odomSin(mid + ODOM_QUARTER_TURN);
+
+  // Q8 mm times Q15: exact in 32 bits below 128 mm per frame
+  odomPose.x += odomRound(ds * c - dl * s, 15);
+  odomPose.y += odomRound(ds * s + dl * c, 15);
+  odomPose.theta += (uint32_t)dtheta;
+}
+
+long odomMillimetres(long q8) {
+  return odomRound(q8, 8);
+}
+
+long odomMilliradians(uint32_t angle) {
+  // 2 pi * 1000 / 2^32, in two steps that stay within 32 bits
+  return ((long)(int32_t)angle / 65536L) * 6283L / 65536L;
+}
+
+#endif // USE_BASE && USE_ODOMETRY
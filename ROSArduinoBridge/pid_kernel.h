@@ -0,0 +1,95 @@
+/***************************************************************
+   Fixed-point PID kernel
+
+   The arithmetic of the PID controllers (controller.h), without
+   software floating point and without a 32-bit division per wheel
+   per tick.
+
+   Targets and measured speeds are kept in Q8 fixed point (PID_ONE
+   = one encoder tick per frame), so fractional targets and the
+   fractional speeds of the M/T estimate (velocity.h) survive
+   without a double; the integral and derivative state are Q8 as
+   well, and only the numerator is truncated to whole units before
+   the division. The
+   output scaling "/ Ko" is done with a shift when Ko is a power of
+   two and otherwise with a 16-bit reciprocal built once per Ko
+   change, followed by a one-step remainder correction, so it
+   always equals C's truncating division.
+
+   Before dividing, the numerator is clamped to the range in which
+   the output can still end up below MAX_PWM. Any numerator beyond
+   it saturates the output either way, so the clamp changes nothing
+   and keeps the quotient within ten bits.
+
+   The gains act per frame of the reference rate PID_RATE, whatever
+   the loop rate (control_rate.h): a tick that is the fraction
+   pidTickStep of a frame adds that fraction of the proportional and
+   integral increments, while the derivative, a difference of
+   speeds, needs no scaling. At the reference rate the step is
+   PID_STEP_ONE and changes nothing.
+
+   For whole-tick targets and speeds the result is bit-exact with
+   the former double/long code; the host
+   test tests/host/test_pid_kernel.cpp checks this against the old
+   math.
+   *************************************************************/
+
+#ifndef PID_KERNEL_H
+#define PID_KERNEL_H
+
+#define PID_Q   8
+#define PID_ONE (1L << PID_Q)
+
+/* Whole ticks <-> Q8 targets. pidTicks() truncates toward zero,
+   like the former (long) cast of a double target. */
+#define pidTicksToQ8(t) ((long)(t) * PID_ONE)
+#define pidTicks(q8)    ((q8) / PID_ONE)
+
+/* A tick's length in frames, Q12 */
+#define PID_STEP_Q   12
+#define PID_STEP_ONE (1 << PID_STEP_Q)
+
+/* Set with the loop rate (control_rate.h) */
+extern uint16_t pidTickStep;
+
+/* v * pidTickStep, truncated toward zero; v itself at the
+   reference rate */
+long pidPerTick(long v);
+
+/* Marks a divisor that is not a power of two */
+#define PID_NO_SHIFT 0xFF
+
+/* Division by Ko, rebuilt by pidSetGains() when Ko changes */
+typedef struct {
+  int divisor;        // Ko this scale was built for (0: not built)
+  uint8_t shift;      // Ko == 1 << shift, or PID_NO_SHIFT
+  uint8_t preShift;   // bit length of Ko minus one
+  uint16_t recip;     // ceil(2^(preShift + 15) / Ko)
+  long limit;         // largest numerator that can avoid saturation
+} PIDScale;
+
+typedef struct {
+  int Kp;
+  int Kd;
+  int Ki;
+  PIDScale scale;
+} PIDGains;
+
+/* Take over the tunable gains; cheap when Ko did not change. A Ko
+   below 1 is treated as 1. */
+void pidSetGains(PIDGains *g, int kp, int kd, int ki, int ko);
+
+/* n / Ko with C truncation, for |n| <= scale->limit */
+long pidDivide(long n, const PIDScale *scale);
+
+/*
+ * One PID step on a channel's state: returns the new output and
+ * updates the previous input, the integrated term (both Q8) and,
+ * away from the reference rate, the carried numerator (Q8).
+ *
+ * @param targetQ8 Target speed, Q8 ticks per frame
+ * @param inputQ8  Measured speed, Q8 ticks per frame
+ */
+long pidStep(long targetQ8, long inputQ8, long *prevInput, long *iTerm, long *carry, long output, const PIDGains *g);
+
+#endif // PID_KERNEL_H
@@ -0,0 +1,86 @@
+/***************************************************************
+   Fixed-point PID kernel implementation
+   *************************************************************/
+
+#ifdef USE_BASE
+
+uint16_t pidTickStep = PID_STEP_ONE;
+
+long pidPerTick(long v) {
+  if (pidTickStep == PID_STEP_ONE) return v;
+  bool negative = v < 0;
+  uint32_t m = negative ? -v : v;
+  // In two parts, so that the product never overflows
+  uint32_t scaled = (m >> PID_STEP_Q) * pidTickStep +
+                    (((m & (PID_STEP_ONE - 1)) * pidTickStep) >> PID_STEP_Q);
+  return negative ? -(long)scaled : (long)scaled;
+}
+
+void pidSetGains(PIDGains *g, int kp, int kd, int ki, int ko) {
+  g->Kp = kp;
+  g->Kd = kd;
+  g->Ki = ki;
+
+  if (ko < 1) ko = 1;
+  PIDScale *s = &g->scale;
+  if (s->divisor == ko) return;
+
+  s->divisor = ko;
+  uint8_t bits = 0;
+  while ((ko >> bits) > 1) bits++;
+  s->preShift = bits;
+  s->shift = (ko == (1 << bits)) ? bits : PID_NO_SHIFT;
+  s->recip = (uint16_t)((((uint32_t)1 << (bits + 15)) + ko - 1) / ko);
+  // |output| >= 2 * MAX_PWM + 1 saturates whatever the previous output
+  s->limit = (2L * MAX_PWM + 1) * ko;
+}
+
+long pidDivide(long n, const PIDScale *s) {
+  bool negative = n < 0;
+  uint32_t m = negative ? -n : n;
+  uint16_t q;
+
+  if (s->shift != PID_NO_SHIFT) {
+    q = m >> s->shift;
+  } else {
+    // m < 2^(preShift + 10), so the pre-shifted value fits 16 bits
+    // and the estimate is off by at most one either way
+    uint16_t top = m >> s->preShift;
+    q = ((uint32_t)top * s->recip) >> 15;
+    long r = (long)m - (long)((uint32_t)q * (uint16_t)s->divisor);
+    if (r < 0) q--;
+    else if (r >= s->divisor) q++;
+  }
+  return negative ? -(long)q : (long)q;
+}
+
+long pidStep(long targetQ8, long inputQ8, long *prevInput, long *iTerm, long *carry, long output, const PIDGains *g) {
+  long Perror = targetQ8 - inputQ8;
+  long numeratorQ8 = pidPerTick(g->Kp * Perror + *iTerm) - g->Kd * (inputQ8 - *prevInput);
+
+  // Whole units (truncated) from here on, as the former long math.
+  // A shorter tick adds mostly a fraction of a PWM step; what did
+  // not make it into the output carries over to the next tick.
+  if (pidTickStep != PID_STEP_ONE) numeratorQ8 += *carry;
+  long numerator = constrain(pidTicks(numeratorQ8), -g->scale.limit, g->scale.limit);
+  long change = pidDivide(numerator, &g->scale);
+  if (pidTickStep != PID_STEP_ONE) *carry = numeratorQ8 - pidTicksToQ8(change * g->scale.divisor);
+  output += change;
+
+  // Accumulate Integral error *or* Limit output.
+  // Stop accumulating when output saturates
+  if (output >= MAX_PWM) {
+    output = MAX_PWM;
+    *carry = 0;
+  } else if (output <= -MAX_PWM) {
+    output = -MAX_PWM;
+    *carry = 0;
+  } else {
+    *iTerm += pidPerTick(g->Ki * Perror);
+  }
+
+  *prevInput = inputQ8;
+  return output;
+}
+
+#endif // USE_BASE
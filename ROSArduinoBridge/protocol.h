@@ -0,0 +1,133 @@
+/***************************************************************
+   Serial protocol - command parsing, replies and binary framing
+
+   Commands normally arrive as ASCII lines ("m 20\r") and are
+   answered with text. The ASCII parser works on one byte at a
+   time: arguments are accumulated as signed integers while the
+   digits arrive, separated by spaces or colons, so there are no
+   string buffers to overrun and no atoi() pass at the end of the
+   line. A line with a malformed or out-of-range argument, or more
+   than CMD_MAX_ARGS arguments, is answered "Invalid Argument".
+
+   Several commands can share one line, separated by ';':
+
+     "o 20 20 20 20;e;a 3\r"  ->  "OK;120 -4;512\r\n"
+
+   The commands of such a batch are queued while the line arrives
+   and run back-to-back when the CR is seen, so no control tick or
+   telemetry sample falls between them. Their replies come back in
+   order on a single line, joined with ';'. If any command of the
+   batch is malformed nothing runs and the whole line is answered
+   "Invalid Argument".
+
+   With USE_BINARY_PROTOCOL the same commands
+   can also be sent as fixed-layout binary frames:
+
+     0x00 | COBS( opcode seq payload crc_lo crc_hi ) | 0x00
+
+   opcode  - the single-letter command from commands.h
+   seq     - chosen by the host, echoed in the reply
+   payload - the arguments, little-endian, layout per opcode
+             (see binLayouts in protocol.ino)
+   crc     - CRC-16/CCITT-FALSE over opcode, seq and payload
+
+   COBS keeps 0x00 out of the frame body, so a NUL byte always
+   marks a frame boundary and can never appear in an ASCII line.
+   Every frame must be preceded and followed by a NUL; repeated
+   NULs between frames are ignored. Replies use the same framing
+   with a status byte (BIN_STATUS_*) after seq, followed by the
+   reply values. Frames with a bad CRC are dropped and counted.
+
+   The binary batch opcode ';' carries several commands in one
+   frame, each as its opcode followed by its usual payload:
+
+     ';' seq  op1 args1  op2 args2 ...
+
+   The frame is rejected as a whole (BAD_COMMAND / BAD_LENGTH) if
+   any command is unknown or truncated; otherwise all of them run
+   and a single ';' reply frame carries one entry per command:
+
+     op status len values[len bytes]
+
+   BIN_STATUS_TRUNCATED means the later entries did not fit into
+   the reply frame (the commands still ran).
+   *************************************************************/
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/* Most arguments a single command can carry */
+#define CMD_MAX_ARGS 8
+
+/* Largest decoded frame, including opcode, seq and CRC */
+#define BIN_MAX_FRAME 64
+
+/* Limits of a ';' batch: commands, and arguments of all of them */
+#define BATCH_MAX_COMMANDS 8
+#define BATCH_MAX_ARGS     16
+
+/* Batch separator in ASCII lines, and the binary batch opcode */
+#define BATCH_SEPARATOR ';'
+
+/* Reply status codes */
+#define BIN_STATUS_OK           0
+#define BIN_STATUS_BAD_COMMAND  1  // unknown or disabled opcode
+#define BIN_STATUS_BAD_LENGTH   2  // payload does not match the layout
+#define BIN_STATUS_BAD_ARGUMENT 3  // argument rejected by the command
+#define BIN_STATUS_TRUNCATED    4  // batch replies did not all fit
+
+/* Field codes of the per-opcode layouts */
+#define BIN_U8  'B'
+#define BIN_I8  'b'
+#define BIN_I16 'h'
+#define BIN_I32 'l'
+
+/*
+ * Replies shared by the ASCII and the binary path. runCommand()
+ * only ever answers through these, so every command works in
+ * both wire formats.
+ */
+void replyOK();
+void replyInvalid();
+void replyBadArgument();
+void replyValue(long value);
+void replyValues(const long *values, uint8_t count);
+
+/*
+ * The OK of a command that only sets motion (m, o, n). In quiet
+ * mode it is left out: nothing for a single command, an empty
+ * field in an ASCII batch, and still an entry in a binary batch
+ * so the entries line up with the commands. Errors are always
+ * answered.
+ */
+void replyAck();
+extern bool replyQuiet;
+
+/* True while the command being run arrived as a binary frame */
+extern bool replyBinary;
+
+/* Feed one received byte to the ASCII parser; a CR runs the command
+   (or the batch of ';'-separated commands) */
+void asciiReceiveByte(uint8_t c);
+
+/* Drop a partially received ASCII line */
+void asciiReset();
+
+/* CRC-16/CCITT-FALSE (poly 0x1021), start with 0xFFFF */
+uint16_t crc16Update(uint16_t crc, uint8_t data);
+
+#ifdef USE_BINARY_PROTOCOL
+  /* True while the bytes of a binary frame are being received */
+  bool binFrameActive();
+
+  /* Feed one received byte (starting with the opening NUL) */
+  void binReceiveByte(uint8_t b);
+
+  /* Send an unsolicited frame (e.g. a telemetry sample) */
+  void binSendFrame(uint8_t opcode, uint8_t seq, uint8_t status, const uint8_t *payload, uint8_t len);
+
+  /* Frames dropped for bad CRC, truncation or overflow */
+  extern unsigned int binFrameErrors;
+#endif
+
+#endif // PROTOCOL_H
@@ -0,0 +1,565 @@
+/***************************************************************
+   Serial protocol implementation
+
+   The incremental ASCII parser, reply helpers for both wire
+   formats, and the COBS/CRC16 binary frame decoder and encoder.
+   *************************************************************/
+
+/* Set while a binary frame is being executed, so the reply helpers
+   answer with a frame instead of text */
+bool replyBinary = false;
+
+/***************************************************************
+   ASCII parser
+   *************************************************************/
+
+/* Largest magnitude an argument may have */
+#define ASCII_MAX_VALUE 2147483647L
+
+long asciiValue = 0;        // magnitude of the argument being read
+bool asciiNegative = false; // a '-' started the current argument
+bool asciiDigits = false;   // the current argument has digits
+bool asciiError = false;    // rest of the command is ignored
+
+/* Commands of a ';' batch, queued until the CR */
+char batchCmd[BATCH_MAX_COMMANDS];
+uint8_t batchArgc[BATCH_MAX_COMMANDS];
+long batchArgs[BATCH_MAX_ARGS];
+uint8_t batchCount = 0;
+uint8_t batchArgCount = 0;
+bool batchActive = false;   // a ';' was seen on this line
+bool batchError = false;    // a queued command was malformed
+
+/* ASCII replies of a running batch share one line */
+bool replyBatch = false;
+uint8_t replyBatchCount = 0;
+
+void asciiReset() {
+  asciiValue = 0;
+  asciiNegative = false;
+  asciiDigits = false;
+  asciiError = false;
+  batchCount = 0;
+  batchArgCount = 0;
+  batchActive = false;
+  batchError = false;
+  resetCommand();
+}
+
+/* Store the argument collected so far, if any */
+void asciiEndArgument() {
+  if (asciiDigits) {
+    if (argc < CMD_MAX_ARGS) args[argc++] = asciiNegative ? -asciiValue : asciiValue;
+    else asciiError = true;
+  } else if (asciiNegative) {
+    asciiError = true;  // a lone '-'
+  }
+  asciiValue = 0;
+  asciiNegative = false;
+  asciiDigits = false;
+}
+
+/* Move the command parsed so far into the batch queue */
+void asciiQueueCommand() {
+  asciiEndArgument();
+  if (asciiError) {
+    batchError = true;
+  } else if (cmd != 0) {
+    if (batchCount < BATCH_MAX_COMMANDS && batchArgCount + argc <= BATCH_MAX_ARGS) {
+      batchCmd[batchCount] = cmd;
+      batchArgc[batchCount] = argc;
+      memcpy(&batchArgs[batchArgCount], args, argc * sizeof(long));
+      batchCount++;
+      batchArgCount += argc;
+    } else {
+      batchError = true;
+    }
+  }
+  asciiError = false;
+  resetCommand();
+}
+
+/* Run the queued commands back-to-back with a single reply line */
+void asciiRunBatch() {
+  if (batchError) {
+    replyBadArgument();
+    return;
+  }
+  txBegin();
+  replyBatch = true;
+  replyBatchCount = 0;
+  uint8_t first = 0;
+  for (uint8_t i = 0; i < batchCount; i++) {
+    resetCommand();
+    cmd = batchCmd[i];
+    argc = batchArgc[i];
+    memcpy(args, &batchArgs[first], argc * sizeof(long));
+    first += argc;
+    runCommand();
+  }
+  replyBatch = false;
+  txPutString("\r\n");
+  txEnd();
+}
+
+void asciiReceiveByte(uint8_t c) {
+  // Terminate a command with a CR (Carriage Return)
+  if (c == 13) {
+    if (batchActive) {
+      asciiQueueCommand();
+      asciiRunBatch();
+    } else {
+      asciiEndArgument();
+      if (cmd != 0) {
+        if (asciiError) replyBadArgument();
+        else runCommand();
+      }
+    }
+    asciiReset();
+    return;
+  }
+
+  // A ';' ends one command of a batch
+  if (c == BATCH_SEPARATOR) {
+    batchActive = true;
+    asciiQueueCommand();
+    return;
+  }
+  if (asciiError) return;
+
+  // Spaces, colons and stray line feeds delimit the arguments
+  if (c == ' ' || c == ':' || c == '\n' || c == '\t') {
+    asciiEndArgument();
+    return;
+  }
+
+  // The first character is the single-letter command
+  if (cmd == 0) {
+    cmd = c;
+    return;
+  }
+
+  if (c >= '0' && c <= '9') {
+    uint8_t digit = c - '0';
+    if (asciiValue > (ASCII_MAX_VALUE - digit) / 10) {
+      asciiError = true;
+      return;
+    }
+    asciiValue = asciiValue * 10 + digit;
+    asciiDigits = true;
+  } else if (c == '-' && !asciiDigits && !asciiNegative) {
+    asciiNegative = true;
+  } else {
+    asciiError = true;
+  }
+}
+
+/***************************************************************
+   Binary protocol
+   *************************************************************/
+
+uint16_t crc16Update(uint16_t crc, uint8_t data) {
+  // Byte-wise CRC-CCITT without a lookup table
+  uint8_t x = (crc >> 8) ^ data;
+  x ^= x >> 4;
+  return (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+}
+
+#ifdef USE_BINARY_PROTOCOL
+
+/***************************************************************
+   Opcode layouts
+
+   args  - one field code per argument, in order
+   reply - field code used for every value of the reply
+           (0 if the command only answers with a status)
+   *************************************************************/
+
+typedef struct {
+  char cmd;
+  char args[6];
+  char reply;
+} BinLayout;
+
+#ifdef USE_MECANUM
+  #define BIN_WHEEL_ARGS "hhhh"  // fl fr rl rr
+#else
+  #define BIN_WHEEL_ARGS "hh"    // left right
+#endif
+
+const BinLayout binLayouts[] PROGMEM = {
+  { ANALOG_READ,    "B",            BIN_I16 },
+  { GET_BAUDRATE,   "",             BIN_I32 },
+  { PIN_MODE,       "BB",           0       },
+  { DIGITAL_READ,   "B",            BIN_U8  },
+  { READ_ENCODERS,  "",             BIN_I32 },
+  { STEERING_DIR,   "l",            0       },
+  { MOTOR_SPEEDS,   BIN_WHEEL_ARGS, 0       },
+  { MOTOR_RAW_PWM,  BIN_WHEEL_ARGS, 0       },
+  { PING,           "B",            BIN_I32 },
+  { RESET_ENCODERS, "",             0       },
+  { SERVO_WRITE,    "Bh",           0       },
+  { SERVO_READ,     "B",            BIN_I16 },
+  { UPDATE_PID,     "hhhh",         0       },
+  { DIGITAL_WRITE,  "BB",           0       },
+  { ANALOG_WRITE,   "Bh",           0       },
+  { SET_ENC_DIR,    "Bb",           0       },
+  { MECANUM_TWIST,  "hhh",          0       },
+  { TELEMETRY,      "BBB",          0       },
+  { READ_ODOMETRY,  "B",            BIN_I32 },
+  { SETPOINT_QUEUE, "B" BIN_WHEEL_ARGS, BIN_U8 },
+  { QUIET_MODE,     "B",            BIN_I32 },
+  { SET_BAUDRATE,   "l",            BIN_I32 },
+  { LOOP_STATS,     "BB",           BIN_I32 },
+  { CONFIG_VALUE,   "BBl",          BIN_I32 },
+  { CONTROL_RATE,   "h",            BIN_I16 },
+  { RECORDER,       "B",            BIN_I32 },
+};
+
+#define BIN_LAYOUT_COUNT (sizeof(binLayouts) / sizeof(binLayouts[0]))
+
+/* Receive state */
+uint8_t binFrame[BIN_MAX_FRAME];
+uint8_t binLen = 0;
+uint8_t binRemaining = 0;    // data bytes left in the current COBS block
+uint8_t binBlockCode = 0xFF; // code byte of the current COBS block
+bool binActive = false;
+bool binOverflow = false;
+unsigned int binFrameErrors = 0;
+
+/* The frame being answered */
+uint8_t binReplyOpcode;
+uint8_t binReplySeq;
+char binReplyField;
+
+uint8_t binFieldSize(char code) {
+  switch (code) {
+    case BIN_U8:
+    case BIN_I8:  return 1;
+    case BIN_I16: return 2;
+    case BIN_I32: return 4;
+  }
+  return 0;
+}
+
+bool binFindLayout(uint8_t opcode, BinLayout *layout) {
+  for (uint8_t i = 0; i < BIN_LAYOUT_COUNT; i++) {
+    memcpy_P(layout, &binLayouts[i], sizeof(BinLayout));
+    if ((uint8_t)layout->cmd == opcode) return true;
+  }
+  return false;
+}
+
+/* COBS-encode a frame body, wrap it in NUL delimiters and write it
+   out in a single call. Frames are far shorter than 254 bytes, so a
+   block never needs the 0xFF continuation code. */
+void binWriteFrame(const uint8_t *data, uint8_t len) {
+  uint8_t out[BIN_MAX_FRAME + 4];
+  uint8_t n = 0;
+  out[n++] = 0;
+  uint8_t codeIndex = n++;
+  uint8_t code = 1;
+  for (uint8_t i = 0; i < len; i++) {
+    if (data[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = n++;
+      code = 1;
+    } else {
+      out[n++] = data[i];
+      code++;
+    }
+  }
+  out[codeIndex] = code;
+  out[n++] = 0;
+  txBegin();
+  txPutBytes(out, n);
+  txEnd();
+}
+
+void binSendFrame(uint8_t opcode, uint8_t seq, uint8_t status, const uint8_t *payload, uint8_t len) {
+  uint8_t frame[BIN_MAX_FRAME];
+  uint8_t n = 0;
+  frame[n++] = opcode;
+  frame[n++] = seq;
+  frame[n++] = status;
+  for (uint8_t i = 0; i < len && n + 2 < BIN_MAX_FRAME; i++) frame[n++] = payload[i];
+
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < n; i++) crc = crc16Update(crc, frame[i]);
+  frame[n++] = crc & 0xFF;
+  frame[n++] = crc >> 8;
+  binWriteFrame(frame, n);
+}
+
+/* Reply entries of a running binary batch */
+bool binBatch = false;
+uint8_t binBatchReply[BIN_MAX_FRAME - 5];
+uint8_t binBatchLen = 0;
+bool binBatchTruncated = false;
+
+void binSendReply(uint8_t status, const long *values, uint8_t count) {
+  uint8_t payload[BIN_MAX_FRAME];
+  uint8_t n = 0;
+  uint8_t size = binFieldSize(binReplyField);
+  for (uint8_t i = 0; i < count && n + size <= BIN_MAX_FRAME - 5; i++) {
+    long v = values[i];
+    for (uint8_t b = 0; b < size; b++) {
+      payload[n++] = (uint8_t)v;
+      v >>= 8;
+    }
+  }
+
+  if (binBatch) {
+    // Append an "op status len values" entry to the batch reply
+    if (binBatchTruncated || binBatchLen + 3 + n > (int)sizeof(binBatchReply)) {
+      binBatchTruncated = true;
+      return;
+    }
+    binBatchReply[binBatchLen++] = binReplyOpcode;
+    binBatchReply[binBatchLen++] = status;
+    binBatchReply[binBatchLen++] = n;
+    memcpy(&binBatchReply[binBatchLen], payload, n);
+    binBatchLen += n;
+    return;
+  }
+  binSendFrame(binReplyOpcode, binReplySeq, status, payload, n);
+}
+
+/* Payload bytes the layout's arguments take */
+uint8_t binArgsSize(const BinLayout *layout) {
+  uint8_t size = 0;
+  for (uint8_t i = 0; layout->args[i] != '\0'; i++) size += binFieldSize(layout->args[i]);
+  return size;
+}
+
+/* Decode a command's arguments into args/argc and run it */
+void binRunCommand(uint8_t opcode, const BinLayout *layout, const uint8_t *payload) {
+  uint8_t pos = 0;
+  resetCommand();
+  uint8_t i;
+  for (i = 0; layout->args[i] != '\0'; i++) {
+    char code = layout->args[i];
+    uint8_t size = binFieldSize(code);
+    uint32_t raw = 0;
+    for (uint8_t b = 0; b < size; b++) raw |= (uint32_t)payload[pos + b] << (8 * b);
+    pos += size;
+
+    if (code == BIN_I8) args[i] = (int8_t)raw;
+    else if (code == BIN_I16) args[i] = (int16_t)raw;
+    else args[i] = (long)raw;
+  }
+  argc = i;
+
+  binReplyOpcode = opcode;
+  binReplyField = layout->reply;
+  cmd = opcode;
+  replyBinary = true;
+  runCommand();
+  replyBinary = false;
+  resetCommand();
+}
+
+/* Check every command of a batch frame, then run them all and
+   answer with one frame */
+void binDispatchBatch(uint8_t seq, const uint8_t *payload, uint8_t len) {
+  BinLayout layout;
+  uint8_t pos = 0;
+  uint8_t count = 0;
+  while (pos < len) {
+    if (count == BATCH_MAX_COMMANDS || !binFindLayout(payload[pos], &layout)) {
+      binSendReply(BIN_STATUS_BAD_COMMAND, NULL, 0);
+      return;
+    }
+    pos += 1 + binArgsSize(&layout);
+    count++;
+  }
+  if (pos != len) {
+    binSendReply(BIN_STATUS_BAD_LENGTH, NULL, 0);
+    return;
+  }
+
+  binBatch = true;
+  binBatchLen = 0;
+  binBatchTruncated = false;
+  for (pos = 0; pos < len; pos += 1 + binArgsSize(&layout)) {
+    binFindLayout(payload[pos], &layout);
+    binRunCommand(payload[pos], &layout, payload + pos + 1);
+  }
+  binBatch = false;
+
+  binSendFrame(BATCH_SEPARATOR, seq, binBatchTruncated ? BIN_STATUS_TRUNCATED : BIN_STATUS_OK,
+               binBatchReply, binBatchLen);
+}
+
+/* Decode the arguments of a checked frame and run the command */
+void binDispatch(uint8_t opcode, uint8_t seq, const uint8_t *payload, uint8_t len) {
+  binReplyOpcode = opcode;
+  binReplySeq = seq;
+  binReplyField = 0;
+
+  if (opcode == BATCH_SEPARATOR) {
+    binDispatchBatch(seq, payload, len);
+    return;
+  }
+
+  BinLayout layout;
+  if (!binFindLayout(opcode, &layout)) {
+    binSendReply(BIN_STATUS_BAD_COMMAND, NULL, 0);
+    return;
+  }
+
+  if (len != binArgsSize(&layout)) {
+    binSendReply(BIN_STATUS_BAD_LENGTH, NULL, 0);
+    return;
+  }
+
+  binRunCommand(opcode, &layout, payload);
+}
+
+void binEndFrame() {
+  if (binOverflow || binRemaining != 0 || binLen < 4) {
+    binFrameErrors++;
+    return;
+  }
+
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < binLen - 2; i++) crc = crc16Update(crc, binFrame[i]);
+  if (crc != (binFrame[binLen - 2] | ((uint16_t)binFrame[binLen - 1] << 8))) {
+    binFrameErrors++;
+    return;
+  }
+
+  binDispatch(binFrame[0], binFrame[1], binFrame + 2, binLen - 4);
+}
+
+bool binFrameActive() {
+  return binActive;
+}
+
+/* Incremental COBS decoder: bytes are unstuffed as they arrive, so a
+   frame is ready to check the moment its closing NUL is seen */
+void binReceiveByte(uint8_t b) {
+  if (b == 0) {
+    if (binActive && (binLen > 0 || binOverflow || binRemaining != 0)) {
+      binEndFrame();
+      binActive = false;
+    } else {
+      binActive = true;
+    }
+    binLen = 0;
+    binRemaining = 0;
+    binBlockCode = 0xFF;
+    binOverflow = false;
+    return;
+  }
+
+  if (binRemaining == 0) {
+    // Start of a COBS block: the previous block (unless it was a
+    // full 254-byte run) stood for a zero in the data
+    if (binBlockCode != 0xFF) {
+      if (binLen < BIN_MAX_FRAME) binFrame[binLen++] = 0;
+      else binOverflow = true;
+    }
+    binBlockCode = b;
+    binRemaining = b - 1;
+    return;
+  }
+
+  if (binLen < BIN_MAX_FRAME) binFrame[binLen++] = b;
+  else binOverflow = true;
+  binRemaining--;
+}
+
+#endif // USE_BINARY_PROTOCOL
+
+/***************************************************************
+   Replies
+   *************************************************************/
+
+bool replyQuiet = false;
+
+/* A reply is one TX message. In a batch, replies after the first
+   are preceded by the separator and the message is the whole line,
+   ended once the batch has run. */
+void replyBegin() {
+  if (!replyBatch) txBegin();
+  else if (replyBatchCount++ > 0) txPut(BATCH_SEPARATOR);
+}
+
+void replyEnd() {
+  if (!replyBatch) {
+    txPutString("\r\n");
+    txEnd();
+  }
+}
+
+void replyValues(const long *values, uint8_t count) {
+  #ifdef USE_BINARY_PROTOCOL
+    if (replyBinary) {
+      binSendReply(BIN_STATUS_OK, values, count);
+      return;
+    }
+  #endif
+  replyBegin();
+  for (uint8_t i = 0; i < count; i++) {
+    if (i > 0) txPut(' ');
+    txPutLong(values[i]);
+  }
+  replyEnd();
+}
+
+void replyValue(long value) {
+  replyValues(&value, 1);
+}
+
+void replyOK() {
+  #ifdef USE_BINARY_PROTOCOL
+    if (replyBinary) {
+      binSendReply(BIN_STATUS_OK, NULL, 0);
+      return;
+    }
+  #endif
+  replyBegin();
+  txPutString("OK");
+  replyEnd();
+}
+
+void replyAck() {
+  if (!replyQuiet) {
+    replyOK();
+    return;
+  }
+  #ifdef USE_BINARY_PROTOCOL
+    if (replyBinary) {
+      // A batch reply keeps one entry per command
+      if (binBatch) binSendReply(BIN_STATUS_OK, NULL, 0);
+      return;
+    }
+  #endif
+  // An empty field keeps the later batch replies in place
+  if (replyBatch) replyBegin();
+}
+
+void replyInvalid() {
+  #ifdef USE_BINARY_PROTOCOL
+    if (replyBinary) {
+      binSendReply(BIN_STATUS_BAD_COMMAND, NULL, 0);
+      return;
+    }
+  #endif
+  replyBegin();
+  txPutString("Invalid Command");
+  replyEnd();
+}
+
+void replyBadArgument() {
+  #ifdef USE_BINARY_PROTOCOL
+    if (replyBinary) {
+      binSendReply(BIN_STATUS_BAD_ARGUMENT, NULL, 0);
+      return;
+    }
+  #endif
+  replyBegin();
+  txPutString("Invalid Argument");
+  replyEnd();
+}
@@ -0,0 +1,60 @@
+/***************************************************************
+   Non-blocking ultrasonic ranging
+
+   Ping() used to trigger a PING))) style sensor and then wait in
+   pulseIn() for the echo, up to a second when nothing came back,
+   so every 'p' command stalled loop() and everything it serves.
+
+   The ranging engine measures in the background instead. The
+   sensors (one pin for trigger and echo, as before) are measured
+   one after the other, round robin, so their pings do not hear
+   each other: a scheduler task fires the trigger pulse, the
+   pin-change interrupt of the sensor's port timestamps the rising
+   and the falling edge of the echo, and the next task run stores
+   the range. An echo that has not ended after RANGER_TIMEOUT_US
+   reads as 0, like the former pulseIn() timeout.
+
+   A pin joins the round robin the first time it is asked for;
+   'p <pin>' and the telemetry stream answer at once with the
+   latest range in cm and its age in ms (RANGER_AGE_NONE until
+   the first measurement).
+
+   Any pin with a pin-change interrupt can be used, except that the
+   quadrature encoder counter (ARDUINO_ENC_COUNTER) owns the PORTC
+   and PORTD vectors; with it the sensors go on pins 8-13.
+   *************************************************************/
+
+#ifndef RANGING_H
+#define RANGING_H
+
+#define RANGER_SENSORS    4        // sensors in the round robin
+#define RANGER_INTERVAL   5        // ms between runs of the ranging task
+#define RANGER_TIMEOUT_US 30000UL  // echo time limit, about 5 m
+
+#define RANGER_AGE_NONE   -1
+
+/* Pin-change vectors (PCICR bits) the engine may take */
+#if defined(USE_BASE) && defined(ARDUINO_ENC_COUNTER) && !defined(NO_ENCODERS)
+  #define RANGER_PCIE_MASK (1 << PCIE0)
+#else
+  #define RANGER_PCIE_MASK ((1 << PCIE0) | (1 << PCIE1) | (1 << PCIE2))
+#endif
+
+/* Forget all sensors and stop measuring */
+void initRanging();
+
+/*
+ * Latest range (cm) and its age (ms) for a sensor pin, adding the
+ * pin to the round robin if it is new. Returns false if the pin
+ * cannot be used or all RANGER_SENSORS slots are taken.
+ */
+bool rangerLatest(uint8_t pin, long *range, long *age);
+
+/* The sensors in the round robin, in the order they were added */
+uint8_t rangerCount();
+void rangerReport(uint8_t slot, long *range, long *age);
+
+/* Scheduler task: trigger the next sensor or collect an echo */
+void rangingTick();
+
+#endif // RANGING_H
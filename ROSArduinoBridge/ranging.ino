@@ -0,0 +1,154 @@
+/***************************************************************
+   Non-blocking ultrasonic ranging implementation
+   *************************************************************/
+
+#include <util/atomic.h>
+
+typedef struct {
+  uint8_t pin;
+  uint16_t range;               // cm, 0 without an echo
+  unsigned long measured;       // millis() when the range was stored
+  bool valid;                   // measured at least once
+} Ranger;
+
+Ranger rangers[RANGER_SENSORS];
+uint8_t rangerSensors = 0;
+uint8_t rangerCurrent = 0;      // slot being measured
+bool rangerArmed = false;       // trigger fired, echo not yet collected
+unsigned long rangerTriggered;  // micros() of the trigger
+
+/* Echo capture, shared with the pin-change interrupts */
+volatile uint8_t *rangerInput;          // PINx of the armed sensor
+volatile uint8_t rangerMask = 0;        // its bit; 0 once the echo ended
+volatile bool rangerEchoHigh = false;   // rising edge seen
+volatile unsigned long rangerEchoStart;
+volatile unsigned long rangerEchoWidth;
+
+void rangerPinChange() {
+  uint8_t mask = rangerMask;
+  if (!mask) return;
+  unsigned long now = micros();
+  if (*rangerInput & mask) {
+    rangerEchoStart = now;
+    rangerEchoHigh = true;
+  } else if (rangerEchoHigh) {
+    rangerEchoWidth = now - rangerEchoStart;
+    rangerMask = 0;
+  }
+}
+
+ISR(PCINT0_vect) {
+  rangerPinChange();
+}
+
+#if RANGER_PCIE_MASK & (1 << PCIE1)
+ISR(PCINT1_vect) {
+  rangerPinChange();
+}
+#endif
+
+#if RANGER_PCIE_MASK & (1 << PCIE2)
+ISR(PCINT2_vect) {
+  rangerPinChange();
+}
+#endif
+
+void initRanging() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rangerMask = 0;
+  }
+  for (uint8_t i = 0; i < rangerSensors; i++) {
+    *digitalPinToPCMSK(rangers[i].pin) &= ~(1 << digitalPinToPCMSKbit(rangers[i].pin));
+  }
+  rangerSensors = 0;
+  rangerCurrent = 0;
+  rangerArmed = false;
+}
+
+int8_t rangerFind(uint8_t pin) {
+  for (uint8_t i = 0; i < rangerSensors; i++) {
+    if (rangers[i].pin == pin) return i;
+  }
+  return -1;
+}
+
+int8_t rangerAdd(uint8_t pin) {
+  if (rangerSensors == RANGER_SENSORS || pin >= NUM_DIGITAL_PINS) return -1;
+  if (digitalPinToPCICR(pin) == 0 || !(RANGER_PCIE_MASK & (1 << digitalPinToPCICRbit(pin)))) return -1;
+
+  Ranger *r = &rangers[rangerSensors];
+  r->pin = pin;
+  r->range = 0;
+  r->valid = false;
+  return rangerSensors++;
+}
+
+void rangerReport(uint8_t slot, long *range, long *age) {
+  const Ranger *r = &rangers[slot];
+  *range = r->range;
+  *age = r->valid ? (long)(millis() - r->measured) : RANGER_AGE_NONE;
+}
+
+bool rangerLatest(uint8_t pin, long *range, long *age) {
+  int8_t slot = rangerFind(pin);
+  if (slot < 0) slot = rangerAdd(pin);
+  if (slot < 0) return false;
+  rangerReport(slot, range, age);
+  return true;
+}
+
+uint8_t rangerCount() {
+  return rangerSensors;
+}
+
+/* Fire the trigger pulse and listen for the echo on the same pin */
+void rangerTrigger(uint8_t pin) {
+  // The PING))) is triggered by a HIGH pulse of 2 or more microseconds.
+  // Give a short LOW pulse beforehand to ensure a clean HIGH pulse:
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  delayMicroseconds(2);
+  digitalWrite(pin, HIGH);
+  delayMicroseconds(5);
+  digitalWrite(pin, LOW);
+  pinMode(pin, INPUT);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rangerInput = portInputRegister(digitalPinToPort(pin));
+    rangerEchoHigh = false;
+    rangerMask = digitalPinToBitMask(pin);
+    *digitalPinToPCMSK(pin) |= (1 << digitalPinToPCMSKbit(pin));
+    PCICR |= (1 << digitalPinToPCICRbit(pin));
+  }
+  rangerTriggered = micros();
+  rangerArmed = true;
+}
+
+void rangingTick() {
+  if (rangerSensors == 0) return;
+  if (!rangerArmed) {
+    rangerTrigger(rangers[rangerCurrent].pin);
+    return;
+  }
+
+  bool ended;
+  unsigned long width;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ended = rangerMask == 0;
+    width = rangerEchoWidth;
+  }
+  if (!ended && micros() - rangerTriggered < RANGER_TIMEOUT_US) return;
+
+  Ranger *r = &rangers[rangerCurrent];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rangerMask = 0;
+    *digitalPinToPCMSK(r->pin) &= ~(1 << digitalPinToPCMSKbit(r->pin));
+  }
+  r->range = ended ? microsecondsToCm(width) : 0;
+  r->measured = millis();
+  r->valid = true;
+
+  // The next sensor fires on the next run, after the echoes faded
+  rangerArmed = false;
+  if (++rangerCurrent == rangerSensors) rangerCurrent = 0;
+}
@@ -0,0 +1,108 @@
+/***************************************************************
+   Flight recorder
+
+   When a robot misbehaves in the field, the host log only has what
+   the host happened to ask for. With USE_RECORDER every control
+   tick also writes one packed record into a RAM ring holding the
+   last RECORDER_RECORDS ticks: the tick number, the target and PWM
+   output of every wheel (0 while the base is stopped), the encoder
+   counts since the tick before, the opcode of the latest command
+   and the time since the tick before, as measured between the two
+   encoder latches, so a late tick shows as one.
+
+   The ring freezes at the first fault, keeping what led up to it:
+
+     RECORDER_AUTO_STOP  the auto-stop stopped a base that was
+                         moving (one already at rest is no fault)
+     RECORDER_OVERRUN    a control tick came due while the
+                         previous one still ran
+     RECORDER_HOST       the host asked for a dump, e.g. from its
+                         own watchdog
+
+   and is read with
+
+     l 0  ->  <records> <cause> <tick>   state; cause 0 = recording,
+                                         tick = control ticks so far
+     l 1  ->  <records>                  freeze (RECORDER_HOST unless
+                                         frozen already) and dump
+     l 2  ->  OK                         clear, record again
+
+   The dump follows the reply as binary frames with opcode
+   RECORDER_FRAME, seq counting the frames from 0, status 0, and as
+   many whole records as fit, oldest first. loop() queues the next
+   frame as soon as the TX ring has room for it, so the dump goes
+   out in one burst at the speed of the link without a frame being
+   dropped. It is binary only: asked in ASCII, 'l 1' answers
+   "Invalid Argument".
+
+   A record is RecorderEntry as it lies in RAM: int16 fields,
+   little-endian, then two bytes. Writing one takes the control
+   tick a few field copies and an index mask, no loop over the ring
+   and no division, so the recorder can stay on in production.
+   *************************************************************/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#ifdef USE_RECORDER
+
+/* Ring size in records, a power of two no larger than 128 */
+#ifndef RECORDER_RECORDS
+  #define RECORDER_RECORDS 16
+#endif
+
+/* Freeze causes */
+#define RECORDER_RECORDING 0
+#define RECORDER_AUTO_STOP 1
+#define RECORDER_OVERRUN   2
+#define RECORDER_HOST      3
+
+/* Operations of the recorder command */
+#define RECORDER_STATE  0
+#define RECORDER_DUMP   1
+#define RECORDER_REARM  2
+
+#ifdef USE_MECANUM
+  #define RECORDER_WHEELS 4
+#else
+  #define RECORDER_WHEELS 1
+#endif
+
+/* The steering motor's PWM follows the wheels' */
+#ifdef HAS_STEERING_SUPPORT
+  #define RECORDER_OUTPUTS (RECORDER_WHEELS + 1)
+#else
+  #define RECORDER_OUTPUTS RECORDER_WHEELS
+#endif
+
+typedef struct {
+  uint16_t tick;                          // control ticks so far, mod 2^16
+  int16_t target[RECORDER_WHEELS];        // ticks per frame
+  int16_t delta[ENCODER_SNAPSHOT_SIZE];   // counts since the tick before
+  int16_t output[RECORDER_OUTPUTS];       // PWM
+  uint8_t command;                        // opcode of the latest command
+  uint8_t period;                         // ms since the tick before, up to 255
+} RecorderEntry;
+
+/* Opcode of the command being run; set by runCommand() */
+extern uint8_t recorderCommand;
+
+/* Empty the ring and record from the current encoder counts on */
+void initRecorder();
+
+/* Record the control tick that just ran; called at its end */
+void recorderTick();
+
+/* Freeze the ring, unless it is already; see the causes above */
+void recorderFault(uint8_t cause);
+
+/* Queue the next dump frame if the TX ring has room; from loop() */
+void recorderService();
+
+/* Reply to the recorder command; false for an unknown operation,
+   and for a dump asked in ASCII */
+bool recorderReply(long op);
+
+#endif // USE_RECORDER
+
+#endif // RECORDER_H
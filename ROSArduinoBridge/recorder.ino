@@ -0,0 +1,149 @@
+/***************************************************************
+   Flight recorder implementation
+   *************************************************************/
+
+#ifdef USE_RECORDER
+
+#define RECORDER_MASK (RECORDER_RECORDS - 1)
+
+/* A stopped base keeps its last targets and outputs; they are
+   recorded as 0 */
+#ifdef USE_MECANUM
+  #define RECORDER_PID    wheelPID
+  #define RECORDER_MOVING mecanumMoving
+#else
+  #define RECORDER_PID    drivePID
+  #define RECORDER_MOVING moving
+#endif
+
+/* Whole records in one frame next to opcode, seq, status and CRC,
+   and the ring space the frame takes once encoded */
+#define RECORDER_PER_FRAME  ((BIN_MAX_FRAME - 5) / sizeof(RecorderEntry))
+#define RECORDER_FRAME_ROOM (5 + RECORDER_PER_FRAME * sizeof(RecorderEntry) + 3)
+
+RecorderEntry recorderRing[RECORDER_RECORDS];
+uint8_t recorderHead = 0;         // where the next record goes
+uint8_t recorderFill = 0;         // records held
+uint16_t recorderTicks = 0;
+long recorderCounts[ENCODER_SNAPSHOT_SIZE];
+unsigned long recorderMicros;     // latch time of the tick before
+volatile uint8_t recorderCause = RECORDER_RECORDING;
+uint8_t recorderCommand = 0;
+
+/* Dump in progress: next record to send and frame number */
+bool recorderDumping = false;
+uint8_t recorderDumpNext = 0;
+uint8_t recorderDumpSeq = 0;
+
+void initRecorder() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    recorderHead = 0;
+    recorderFill = 0;
+    recorderCause = RECORDER_RECORDING;
+    recorderDumping = false;
+    for (uint8_t c = 0; c < ENCODER_SNAPSHOT_SIZE; c++) recorderCounts[c] = RECORDER_PID.encoders.count[c];
+    recorderMicros = RECORDER_PID.encoders.micros;
+  }
+}
+
+void recorderTick() {
+  recorderTicks++;
+  // The counts and the latch time are followed while frozen too,
+  // so a re-armed ring starts with one tick's delta
+  const EncoderSnapshot &latched = RECORDER_PID.encoders;
+  int16_t delta[ENCODER_SNAPSHOT_SIZE];
+  for (uint8_t c = 0; c < ENCODER_SNAPSHOT_SIZE; c++) {
+    delta[c] = latched.count[c] - recorderCounts[c];
+    recorderCounts[c] = latched.count[c];
+  }
+  unsigned long interval = (latched.micros - recorderMicros + 500) / 1000;
+  recorderMicros = latched.micros;
+  if (recorderCause != RECORDER_RECORDING) return;
+
+  RecorderEntry *e = &recorderRing[recorderHead];
+  e->tick = recorderTicks;
+  for (uint8_t c = 0; c < ENCODER_SNAPSHOT_SIZE; c++) e->delta[c] = delta[c];
+  bool driving = RECORDER_MOVING;
+  for (uint8_t i = 0; i < RECORDER_WHEELS; i++) {
+    e->target[i] = driving ? pidTicks(RECORDER_PID.targetQ8[i]) : 0;
+    #if defined(USE_MECANUM) && defined(NO_ENCODERS)
+      e->output[i] = driving ? currentMecanumSpeeds[i] : 0;  // open loop
+    #else
+      e->output[i] = driving ? RECORDER_PID.output[i] : 0;
+    #endif
+  }
+  #ifdef HAS_STEERING_SUPPORT
+    e->output[RECORDER_WHEELS] = steering.output;
+  #endif
+  e->command = recorderCommand;
+  e->period = interval < 255 ? interval : 255;
+
+  recorderHead = (recorderHead + 1) & RECORDER_MASK;
+  if (recorderFill < RECORDER_RECORDS) recorderFill++;
+}
+
+/* Did the latest record drive anything? */
+static bool recorderMoving() {
+  if (recorderFill == 0) return false;
+  const RecorderEntry *e = &recorderRing[(recorderHead - 1) & RECORDER_MASK];
+  for (uint8_t i = 0; i < RECORDER_WHEELS; i++) {
+    if (e->target[i] != 0) return true;
+  }
+  for (uint8_t i = 0; i < RECORDER_OUTPUTS; i++) {
+    if (e->output[i] != 0) return true;
+  }
+  return false;
+}
+
+void recorderFault(uint8_t cause) {
+  if (recorderCause != RECORDER_RECORDING) return;
+  // The auto-stop check fires every few ms while the host is quiet
+  if (cause == RECORDER_AUTO_STOP && !recorderMoving()) return;
+  recorderCause = cause;
+}
+
+void recorderService() {
+  if (!recorderDumping || txRoom() < RECORDER_FRAME_ROOM) return;
+
+  uint8_t payload[RECORDER_PER_FRAME * sizeof(RecorderEntry)];
+  uint8_t len = 0;
+  uint8_t first = (recorderHead - recorderFill) & RECORDER_MASK;
+  for (uint8_t n = 0; n < RECORDER_PER_FRAME && recorderDumpNext < recorderFill; n++) {
+    const RecorderEntry *e = &recorderRing[(first + recorderDumpNext++) & RECORDER_MASK];
+    memcpy(payload + len, e, sizeof(*e));
+    len += sizeof(*e);
+  }
+  binSendFrame(RECORDER_FRAME, recorderDumpSeq++, BIN_STATUS_OK, payload, len);
+  if (recorderDumpNext >= recorderFill) recorderDumping = false;
+}
+
+bool recorderReply(long op) {
+  switch (op) {
+  case RECORDER_STATE: {
+    long values[3];
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      values[0] = recorderFill;
+      values[1] = recorderCause;
+      values[2] = recorderTicks;
+    }
+    replyValues(values, 3);
+    return true;
+  }
+  case RECORDER_DUMP:
+    if (!replyBinary) return false;
+    // Frozen, the ring holds still while the frames go out
+    recorderFault(RECORDER_HOST);
+    recorderDumping = recorderFill > 0;
+    recorderDumpNext = 0;
+    recorderDumpSeq = 0;
+    replyValue(recorderFill);
+    return true;
+  case RECORDER_REARM:
+    initRecorder();
+    replyOK();
+    return true;
+  }
+  return false;
+}
+
+#endif // USE_RECORDER
@@ -0,0 +1,96 @@
+/***************************************************************
+   Deterministic task scheduler
+
+   The control tick used to run from loop() once millis() had passed
+   nextPID, so it was late by however long loop() had been busy
+   parsing serial input or waiting in Ping(), and the comparison
+   broke when millis() wrapped.
+
+   A 1 kHz timer compare interrupt, which also pumps the serial RX
+   ring (serial_rx.h), is now the time base of a static task
+   table. Every task has a period and a phase in ticks (ms), kept
+   as a countdown that is reloaded on expiry, so there is no
+   absolute time to wrap.
+
+   SCHED_INTERRUPT tasks run inside the timer interrupt, with
+   interrupts re-enabled so encoder edges and serial bytes are still
+   served. They start within microseconds of their tick whatever
+   loop() is doing. These are the tasks that drive the motors, so
+   loop() code that changes controller state or motor outputs does
+   so inside ATOMIC_BLOCK.
+
+   SCHED_LOOP tasks are only released by the interrupt and run from
+   loop() via schedulerRun(). They write to Serial or are not time
+   critical.
+
+   A task that comes due while its previous release has not finished
+   (SCHED_INTERRUPT) or not started (SCHED_LOOP) is not queued again;
+   the missed release is counted as an overrun.
+
+   The time base takes a timer none of the motor drivers' PWM pins
+   is on: Timer2 (pins 3 and 11) on the ATmega328P/168, Timer1
+   (pins 11 and 12, direction and enable pins only) on the
+   ATmega1280/2560, where Timer2 drives the PWM on pins 9 and 10
+   and the Servo library takes Timer5. Other boards are refused at
+   compile time until their timer is chosen in scheduler.ino.
+   *************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/* Where a task runs */
+#define SCHED_LOOP      0
+#define SCHED_INTERRUPT 1
+
+/* Task indices; the table in scheduler.ino is in this order */
+#ifdef USE_BASE
+  #define TASK_CONTROL     0
+  #define TASK_AUTO_STOP   1
+  #define TASK_TELEMETRY   2
+  #define SCHED_BASE_TASKS 3
+#else
+  #define SCHED_BASE_TASKS 0
+#endif
+
+#define TASK_RANGING SCHED_BASE_TASKS
+
+#ifdef USE_SERVOS
+  #define TASK_SERVOS (TASK_RANGING + 1)
+  #define SCHED_TASKS (TASK_RANGING + 2)
+#else
+  #define SCHED_TASKS (TASK_RANGING + 1)
+#endif
+
+/* Check the auto-stop timeout this often (ms) */
+#define AUTO_STOP_CHECK_INTERVAL 10
+
+typedef struct {
+  void (*run)();
+  uint16_t period;   // ticks between releases, unless changed
+  uint16_t phase;    // tick of the first release, 1 .. period
+  uint8_t context;   // SCHED_INTERRUPT or SCHED_LOOP
+} SchedTask;
+
+/* Start the 1 kHz timer tick */
+void initScheduler();
+
+/* Release due tasks and run the SCHED_INTERRUPT ones. Called from
+   the timer interrupt, with interrupts disabled. */
+void schedulerTick();
+
+/* Run the released SCHED_LOOP tasks; called from loop() */
+void schedulerRun();
+
+/* Completed runs and missed releases of a task since start */
+unsigned int schedulerRuns(uint8_t task);
+unsigned int schedulerOverruns(uint8_t task);
+
+/* micros() at the latest release of a task */
+unsigned long schedulerReleaseTime(uint8_t task);
+
+/* A new period for a task, first released one period from now.
+   The control and telemetry tasks start at the control rate's
+   period (control_rate.h). */
+void schedulerSetPeriod(uint8_t task, uint16_t period);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,173 @@
+/***************************************************************
+   Deterministic task scheduler implementation
+   *************************************************************/
+
+#include <util/atomic.h>
+
+#if SCHED_TASKS > 0
+
+const SchedTask schedTasks[SCHED_TASKS] = {
+#ifdef USE_BASE
+  // run                period                    phase                     context
+  { controlTick,        PID_INTERVAL,             PID_INTERVAL,             SCHED_INTERRUPT },
+  { autoStopCheck,      AUTO_STOP_CHECK_INTERVAL, AUTO_STOP_CHECK_INTERVAL, SCHED_INTERRUPT },
+  // Same period and phase as the control tick: samples follow it
+  { telemetryTick,      PID_INTERVAL,             PID_INTERVAL,             SCHED_LOOP      },
+#endif
+  { rangingTick,        RANGER_INTERVAL,          RANGER_INTERVAL,          SCHED_LOOP      },
+#ifdef USE_SERVOS
+  { sweepServos,        1,                        1,                        SCHED_LOOP      },
+#endif
+};
+
+typedef struct {
+  uint16_t period;              // ticks between releases
+  uint16_t countdown;           // ticks to the next release
+  volatile bool due;            // released and not yet finished/started
+  unsigned long released;       // micros() at the latest release
+  unsigned int runs;
+  unsigned int overruns;
+} SchedState;
+
+SchedState schedState[SCHED_TASKS];
+
+/* Set while the outermost tick runs SCHED_INTERRUPT tasks; nested
+   ticks then only release, and the outer one picks the tasks up */
+volatile bool schedBusy = false;
+
+#endif // SCHED_TASKS > 0
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega168__)
+  #define SCHED_TIMER_VECT TIMER2_COMPA_vect
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  #define SCHED_TIMER_VECT TIMER1_COMPA_vect
+#else
+  #error "No scheduler time base for this board: pick a timer no motor PWM pin uses (scheduler.h)"
+#endif
+
+/* 1 kHz tick: 16 MHz / 64 / (249 + 1) */
+void initScheduler() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    #if SCHED_TASKS > 0
+      for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+        schedState[i].period = schedTasks[i].period;
+        schedState[i].countdown = schedTasks[i].phase;
+        schedState[i].due = false;
+        schedState[i].runs = 0;
+        schedState[i].overruns = 0;
+      }
+      #ifdef USE_BASE
+        // The stored configuration may have set another rate
+        schedState[TASK_CONTROL].period = schedState[TASK_CONTROL].countdown = controlPeriod;
+        schedState[TASK_TELEMETRY].period = schedState[TASK_TELEMETRY].countdown = controlPeriod;
+      #endif
+      schedBusy = false;
+    #endif
+    #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+      TCCR1A = 0;
+      TCCR1B = (1 << WGM12) | (1 << CS11) | (1 << CS10);  // CTC mode, clk/64
+      OCR1A = 249;
+      TIMSK1 |= (1 << OCIE1A);
+    #else
+      TCCR2A = (1 << WGM21);   // CTC mode
+      TCCR2B = (1 << CS22);    // clk/64
+      OCR2A = 249;
+      TIMSK2 |= (1 << OCIE2A);
+    #endif
+  }
+}
+
+ISR(SCHED_TIMER_VECT) {
+  rxPump();
+  txPump();
+  schedulerTick();
+}
+
+void schedulerTick() {
+  #if SCHED_TASKS > 0
+    bool interruptWork = false;
+    for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+      SchedState *s = &schedState[i];
+      if (--s->countdown) continue;
+      s->countdown = s->period;
+      if (s->due) {
+        s->overruns++;
+        #ifdef USE_RECORDER
+          if (i == TASK_CONTROL) recorderFault(RECORDER_OVERRUN);
+        #endif
+        continue;
+      }
+      s->due = true;
+      s->released = micros();
+      if (schedTasks[i].context == SCHED_INTERRUPT) interruptWork = true;
+    }
+    if (!interruptWork || schedBusy) return;
+
+    // Run released interrupt tasks in table order until none is left;
+    // ticks nested in the meantime may release more
+    schedBusy = true;
+    for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+      if (schedTasks[i].context != SCHED_INTERRUPT || !schedState[i].due) continue;
+      sei();
+      schedTasks[i].run();
+      cli();
+      schedState[i].runs++;
+      schedState[i].due = false;
+      i = (uint8_t)-1;  // rescan from the start
+    }
+    schedBusy = false;
+  #endif
+}
+
+void schedulerRun() {
+  #if SCHED_TASKS > 0
+    for (uint8_t i = 0; i < SCHED_TASKS; i++) {
+      if (schedTasks[i].context != SCHED_LOOP || !schedState[i].due) continue;
+      // Started: a release from now on is a new one
+      schedState[i].due = false;
+      schedTasks[i].run();
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        schedState[i].runs++;
+      }
+    }
+  #endif
+}
+
+unsigned int schedulerRuns(uint8_t task) {
+  unsigned int runs = 0;
+  #if SCHED_TASKS > 0
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      runs = schedState[task].runs;
+    }
+  #endif
+  return runs;
+}
+
+unsigned int schedulerOverruns(uint8_t task) {
+  unsigned int overruns = 0;
+  #if SCHED_TASKS > 0
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      overruns = schedState[task].overruns;
+    }
+  #endif
+  return overruns;
+}
+
+unsigned long schedulerReleaseTime(uint8_t task) {
+  unsigned long released = 0;
+  #if SCHED_TASKS > 0
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      released = schedState[task].released;
+    }
+  #endif
+  return released;
+}
+
+void schedulerSetPeriod(uint8_t task, uint16_t period) {
+  #if SCHED_TASKS > 0
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      schedState[task].period = period;
+      schedState[task].countdown = period;
+    }
+  #endif
+}
@@ -7,28 +7,3 @@ float microsecondsToCm(long microseconds)
   // object we take half of the distance travelled.
   return microseconds / 29 / 2;
 }
-
-long Ping(int pin) {
-  long duration, range;
-
-  // The PING))) is triggered by a HIGH pulse of 2 or more microseconds.
-  // Give a short LOW pulse beforehand to ensure a clean HIGH pulse:
-  pinMode(pin, OUTPUT);
-  digitalWrite(pin, LOW);
-  delayMicroseconds(2);
-  digitalWrite(pin, HIGH);
-  delayMicroseconds(5);
-  digitalWrite(pin, LOW);
-
-  // The same pin is used to read the signal from the PING))): a HIGH
-  // pulse whose duration is the time (in microseconds) from the sending
-  // of the ping to the reception of its echo off of an object.
-  pinMode(pin, INPUT);
-  duration = pulseIn(pin, HIGH);
-
-  // convert the time into meters
-  range = microsecondsToCm(duration);
-  
-  return(range);
-}
-
@@ -0,0 +1,37 @@
+/***************************************************************
+   Interrupt-fed serial receive ring buffer
+
+   The Arduino core only buffers 64 received bytes. At 115200 baud
+   that is about 5.5 ms of traffic, so a burst from the host that
+   arrives while a PID tick or a Ping() is running can overflow it.
+
+   The scheduler's 1 kHz timer tick (scheduler.h) moves bytes from
+   the core's buffer into a larger ring, and loop() parses from the
+   ring. The tick's timer drives none of the motor drivers' PWM
+   pins on any supported board.
+   *************************************************************/
+
+#ifndef SERIAL_RX_H
+#define SERIAL_RX_H
+
+/* Ring size, must be a power of two no larger than 256 */
+#define RX_RING_SIZE 128
+
+/* Times the pump found the ring full and left bytes behind in the
+   core's buffer */
+extern volatile unsigned int rxRingFull;
+
+/* Move the core's buffer into the ring; interrupts must be off.
+   Runs on every scheduler tick. */
+void rxPump();
+
+/* Drain the core's buffer into the ring from the main loop */
+void rxService();
+
+/* Bytes waiting in the ring */
+bool rxAvailable();
+
+/* Take the next byte from the ring (only when rxAvailable()) */
+uint8_t rxRead();
+
+#endif // SERIAL_RX_H
@@ -0,0 +1,43 @@
+/***************************************************************
+   Interrupt-fed serial receive ring buffer implementation
+   *************************************************************/
+
+#include <util/atomic.h>
+
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+
+uint8_t rxRing[RX_RING_SIZE];
+volatile uint8_t rxHead = 0;  // written by the pump
+volatile uint8_t rxTail = 0;  // written by the reader
+volatile unsigned int rxRingFull = 0;
+
+/* Move everything the core has received into the ring. Only ever
+   runs with interrupts disabled, so the scheduler tick and the main
+   loop never read the core's buffer at the same time. */
+void rxPump() {
+  while (Serial.available() > 0) {
+    uint8_t next = (rxHead + 1) & RX_RING_MASK;
+    if (next == rxTail) {
+      rxRingFull++;
+      return;
+    }
+    rxRing[rxHead] = Serial.read();
+    rxHead = next;
+  }
+}
+
+void rxService() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rxPump();
+  }
+}
+
+bool rxAvailable() {
+  return rxHead != rxTail;
+}
+
+uint8_t rxRead() {
+  uint8_t b = rxRing[rxTail];
+  rxTail = (rxTail + 1) & RX_RING_MASK;
+  return b;
+}
@@ -0,0 +1,69 @@
+/***************************************************************
+   Non-blocking serial transmit queue
+
+   Serial.print() blocks as soon as the core's 64-byte TX buffer is
+   full; at 115200 baud one full buffer takes 5.5 ms to drain, and
+   the whole time loop() parses nothing. Serial.print(long) also
+   divides by ten per digit in 32-bit software arithmetic.
+
+   Every reply, telemetry sample and binary frame is now put
+   together as one message in a ring buffer and published with
+   txEnd(). A message that does not fit into the free space is
+   dropped whole and counted in txDropped, so the host never sees a
+   partial line or frame; a message longer than the ring can never
+   be sent. Like the RX ring (serial_rx.h), the scheduler's 1 kHz
+   tick and loop() move the ring into the core's buffer, but only
+   as many bytes as availableForWrite() says will not block.
+
+   Numbers are formatted by repeated subtraction of the powers of
+   ten, which on the AVR is several times faster than the core's
+   division per digit.
+   *************************************************************/
+
+#ifndef SERIAL_TX_H
+#define SERIAL_TX_H
+
+/* Ring size, must be a power of two no larger than 256 */
+#define TX_RING_SIZE 128
+
+/* The core's TX buffer (HardwareSerial.h defines it on the AVR) */
+#ifndef SERIAL_TX_BUFFER_SIZE
+  #define SERIAL_TX_BUFFER_SIZE 64
+#endif
+
+/* Messages dropped because the ring was full */
+extern volatile unsigned int txDropped;
+
+/* Start a message; only one is built at a time, from loop() */
+void txBegin();
+
+/* Append to the message being built */
+void txPut(uint8_t b);
+void txPutBytes(const uint8_t *data, uint8_t len);
+void txPutString(const char *s);
+void txPutLong(long value);
+void txPutUnsigned(unsigned long value);
+
+/* Publish the message; false if it did not fit and was dropped */
+bool txEnd();
+
+/*
+ * Write value in decimal to out (at least 10 bytes, not NUL
+ * terminated). Returns the number of characters.
+ */
+uint8_t txFormatUnsigned(unsigned long value, char *out);
+
+/* Nothing queued in the ring */
+bool txIdle();
+
+/* Bytes a message may have and still fit right now */
+uint8_t txRoom();
+
+/* Move the ring into the core's TX buffer as far as it has room;
+   interrupts must be off. Runs on every scheduler tick. */
+void txPump();
+
+/* The same from the main loop */
+void txService();
+
+#endif // SERIAL_TX_H
@@ -0,0 +1,108 @@
+/***************************************************************
+   Non-blocking serial transmit queue implementation
+   *************************************************************/
+
+#include <util/atomic.h>
+
+#define TX_RING_MASK (TX_RING_SIZE - 1)
+
+uint8_t txRing[TX_RING_SIZE];
+volatile uint8_t txHead = 0;  // end of the published messages
+volatile uint8_t txTail = 0;  // written by the pump
+volatile unsigned int txDropped = 0;
+
+/* The message being built sits after txHead until txEnd() */
+uint8_t txLen = 0;
+bool txOverflow = false;
+
+const uint32_t txDecades[] PROGMEM = {
+  1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+  10000UL, 1000UL, 100UL, 10UL,
+};
+
+void txBegin() {
+  txLen = 0;
+  txOverflow = false;
+}
+
+void txPut(uint8_t b) {
+  // The pump only ever frees space, so checking against a stale
+  // tail is safe
+  uint8_t room = (txTail - txHead - 1) & TX_RING_MASK;
+  if (txOverflow || txLen >= room) {
+    txOverflow = true;
+    return;
+  }
+  txRing[(txHead + txLen) & TX_RING_MASK] = b;
+  txLen++;
+}
+
+void txPutBytes(const uint8_t *data, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) txPut(data[i]);
+}
+
+void txPutString(const char *s) {
+  while (*s) txPut(*s++);
+}
+
+uint8_t txFormatUnsigned(unsigned long value, char *out) {
+  uint32_t v = value;
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < sizeof(txDecades) / sizeof(txDecades[0]); i++) {
+    uint32_t decade = pgm_read_dword(&txDecades[i]);
+    char digit = '0';
+    while (v >= decade) {
+      v -= decade;
+      digit++;
+    }
+    if (digit != '0' || n > 0) out[n++] = digit;
+  }
+  out[n++] = '0' + v;
+  return n;
+}
+
+void txPutUnsigned(unsigned long value) {
+  char digits[10];
+  txPutBytes((const uint8_t *)digits, txFormatUnsigned(value, digits));
+}
+
+void txPutLong(long value) {
+  if (value < 0) {
+    txPut('-');
+    txPutUnsigned(-(uint32_t)value);
+  } else {
+    txPutUnsigned(value);
+  }
+}
+
+uint8_t txRoom() {
+  return (txTail - txHead - 1) & TX_RING_MASK;
+}
+
+bool txEnd() {
+  if (txOverflow) {
+    txDropped++;
+    return false;
+  }
+  txHead = (txHead + txLen) & TX_RING_MASK;
+  txService();
+  return true;
+}
+
+bool txIdle() {
+  return txHead == txTail;
+}
+
+void txPump() {
+  int room = Serial.availableForWrite();
+  while (room-- > 0 && txTail != txHead) {
+    Serial.write(txRing[txTail]);
+    txTail = (txTail + 1) & TX_RING_MASK;
+  }
+}
+
+void txService() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    txPump();
+  }
+}
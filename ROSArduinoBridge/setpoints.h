@@ -0,0 +1,63 @@
+/***************************************************************
+   Timestamped setpoint queue
+
+   MOTOR_SPEEDS takes effect the moment its line is parsed, so any
+   jitter between the host and the serial port shows up as jitter
+   in the wheel speeds. Instead, the host can stream a trajectory a
+   few points ahead:
+
+     q <dt> <speeds...>
+
+   queues the speeds (the arguments of 'm': ticks per frame with
+   encoders, PWM without) to be reached dt control ticks after the
+   previously queued point, or after the current tick if the queue
+   has run dry. The control tick consumes the queue; between two
+   points the target moves linearly, and by at most
+   MOTOR_SLEW_RATE per tick. When the queue runs dry the last point
+   is held. The reply is the number of points still queued, and a
+   full queue answers "Invalid Argument".
+
+   'm', 'o', 'n' and the auto-stop drop the queue and take over.
+   The auto-stop still applies, so a stream has to send a point at
+   least every AUTO_STOP_INTERVAL.
+   *************************************************************/
+
+#ifndef SETPOINTS_H
+#define SETPOINTS_H
+
+#define SETPOINT_QUEUE_SIZE 8     // points
+#define SETPOINT_MAX_DT     255   // control ticks between two points
+
+#ifdef USE_MECANUM
+  #define SETPOINT_WHEELS 4
+#else
+  #define SETPOINT_WHEELS 1
+#endif
+
+/* Every driver has a slew limit; the TB6612 section sets its own */
+#ifndef MOTOR_SLEW_RATE
+  #define MOTOR_SLEW_RATE 8
+#endif
+
+typedef struct {
+  uint16_t at;                    // control tick to reach the point at
+  int target[SETPOINT_WHEELS];    // speeds as given to 'm'
+} Setpoint;
+
+/*
+ * Queue a point dt control ticks after the last one.
+ * Returns false if the queue is full or dt is out of range.
+ */
+bool setpointQueue(long dt, const long *speeds);
+
+/* Points still waiting */
+uint8_t setpointPending();
+
+/* Drop the queue; the caller sets the speeds it wants */
+void setpointClear();
+
+/* Advance the queue by one tick and apply the interpolated target;
+   called from the control tick before the PID update */
+void setpointTick();
+
+#endif // SETPOINTS_H
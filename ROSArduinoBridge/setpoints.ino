@@ -0,0 +1,113 @@
+/***************************************************************
+   Setpoint queue implementation
+   *************************************************************/
+
+#ifdef USE_BASE
+
+Setpoint setpointRing[SETPOINT_QUEUE_SIZE];
+uint8_t setpointHead = 0;
+uint8_t setpointCount = 0;
+uint16_t setpointClock = 0;     // control ticks
+bool setpointActive = false;
+
+long setpointQ8[SETPOINT_WHEELS];     // the target applied last
+long setpointGoalQ8[SETPOINT_WHEELS]; // where it is heading
+
+/* The target in effect when streaming starts, so it ramps from
+   the current speed */
+void setpointStart() {
+  for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) {
+    #if defined(USE_MECANUM) && defined(NO_ENCODERS)
+      setpointQ8[i] = mecanumMoving ? pidTicksToQ8(currentMecanumSpeeds[i]) : 0;
+    #elif defined(USE_MECANUM)
+      setpointQ8[i] = mecanumMoving ? wheelPID.targetQ8[i] : 0;
+    #elif defined(NO_ENCODERS)
+      setpointQ8[i] = moving ? pidTicksToQ8(drivePID.output[0]) : 0;
+    #else
+      setpointQ8[i] = moving ? drivePID.targetQ8[0] : 0;
+    #endif
+    setpointGoalQ8[i] = setpointQ8[i];
+  }
+  setpointActive = true;
+}
+
+/* Hand the target to the controller, or as PWM to the motors */
+void setpointApply() {
+  bool any = false;
+  for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) any |= setpointQ8[i] != 0;
+
+  #if defined(USE_MECANUM) && defined(NO_ENCODERS)
+    setMecanumDirectSpeeds(pidTicks(setpointQ8[0]), pidTicks(setpointQ8[1]),
+                           pidTicks(setpointQ8[2]), pidTicks(setpointQ8[3]));
+  #elif defined(USE_MECANUM)
+    for (uint8_t i = 0; i < 4; i++) wheelPID.targetQ8[i] = setpointQ8[i];
+    mecanumMoving = any;
+  #elif defined(NO_ENCODERS)
+    setDirectDriveSpeed(pidTicks(setpointQ8[0]));
+  #else
+    drivePID.targetQ8[0] = setpointQ8[0];
+    moving = any;
+  #endif
+}
+
+bool setpointQueue(long dt, const long *speeds) {
+  if (dt < 1 || dt > SETPOINT_MAX_DT || setpointCount == SETPOINT_QUEUE_SIZE) return false;
+  if (!setpointActive) setpointStart();
+
+  uint16_t base = setpointCount
+    ? setpointRing[(setpointHead + setpointCount - 1) % SETPOINT_QUEUE_SIZE].at
+    : setpointClock;
+  Setpoint *p = &setpointRing[(setpointHead + setpointCount) % SETPOINT_QUEUE_SIZE];
+  p->at = base + dt;
+  for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) p->target[i] = speeds[i];
+  setpointCount++;
+  return true;
+}
+
+uint8_t setpointPending() {
+  return setpointCount;
+}
+
+void setpointClear() {
+  setpointCount = 0;
+  setpointActive = false;
+}
+
+void setpointTick() {
+  setpointClock++;
+  if (!setpointActive) return;
+
+  // Points that are due (late ones too) become the goal; otherwise
+  // head for the next point so as to arrive on its tick
+  long span = 1;
+  bool reached = false;
+  while (setpointCount && (int16_t)(setpointRing[setpointHead].at - setpointClock) <= 0) {
+    for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) {
+      setpointGoalQ8[i] = pidTicksToQ8(setpointRing[setpointHead].target[i]);
+    }
+    setpointHead = (setpointHead + 1) % SETPOINT_QUEUE_SIZE;
+    setpointCount--;
+    reached = true;
+  }
+  if (!reached && setpointCount) {
+    const Setpoint *next = &setpointRing[setpointHead];
+    for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) setpointGoalQ8[i] = pidTicksToQ8(next->target[i]);
+    span = (uint16_t)(next->at - setpointClock) + 1;
+  }
+
+  // The slew rate is per frame, whatever the loop rate
+  const long slew = pidPerTick(pidTicksToQ8(MOTOR_SLEW_RATE));
+  bool settled = setpointCount == 0;
+  for (uint8_t i = 0; i < SETPOINT_WHEELS; i++) {
+    long step = setpointGoalQ8[i] - setpointQ8[i];
+    if (span > 1) step /= span;
+    setpointQ8[i] += constrain(step, -slew, slew);
+    settled &= setpointQ8[i] == 0 && setpointGoalQ8[i] == 0;
+  }
+  setpointApply();
+
+  // Stopped at the end of the stream: the next command starts afresh
+  if (settled) setpointActive = false;
+}
+
+#endif // USE_BASE
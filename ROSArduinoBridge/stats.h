@@ -0,0 +1,64 @@
+/***************************************************************
+   Loop-stage latency statistics
+
+   With USE_STATS every pass through the stages below is timed
+   with micros() and folded into a per-stage record: count, min,
+   max, mean and a log2 histogram of the durations. The host reads
+   them with
+
+     v <stage> [1]   ->  <count> <min> <max> <mean> <h0> ... <h7>
+
+   in microseconds; h0 counts passes under 16 us, every further
+   bucket doubles the bound (h6 < 1024 us) and h7 holds the rest.
+   Stage STATS_STAGES instead answers
+
+     <control tick overruns> <RX ring overflows>
+
+   A second argument of 1 zeroes every record and both counters
+   after the reply, so each read covers the time since the last.
+
+   The stages nest: the serial parse includes the commands it runs,
+   and the control tick includes the motor output. A loop() stage
+   also includes the interrupts that hit it. On the AVR micros()
+   moves in 4 us steps.
+
+   Without USE_STATS the STATS_BEGIN/STATS_END markers expand to
+   nothing and the command is unknown, so the instrumentation
+   costs neither flash, RAM nor cycles.
+   *************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+/* Timed stages */
+#define STATS_PARSE   0  // every loop() pass: RX ring drained and parsed
+#define STATS_COMMAND 1  // runCommand()
+#define STATS_CONTROL 2  // control tick: setpoints, PID, odometry
+#define STATS_MOTORS  3  // motor output of the PID
+#define STATS_SERVOS  4  // servo sweep
+#define STATS_STAGES  5
+
+/* Histogram buckets; the first bound is 2^STATS_FIRST_BUCKET us */
+#define STATS_BUCKETS      8
+#define STATS_FIRST_BUCKET 4
+
+#ifdef USE_STATS
+  #define STATS_BEGIN(stage) unsigned long statsStart_##stage = micros()
+  #define STATS_END(stage)   statsRecord(stage, micros() - statsStart_##stage)
+
+  /* Fold one duration into a stage. A stage is only ever recorded
+     from one context, the timer interrupt or loop(). */
+  void statsRecord(uint8_t stage, unsigned long micros);
+
+  /* Reply to the stats command; reset clears everything afterwards.
+     False for an unknown stage. */
+  bool statsReply(long stage, long reset);
+
+  /* Zero every record and counter */
+  void statsReset();
+#else
+  #define STATS_BEGIN(stage)
+  #define STATS_END(stage)
+#endif
+
+#endif // STATS_H
@@ -0,0 +1,84 @@
+/***************************************************************
+   Loop-stage latency statistics implementation
+   *************************************************************/
+
+#ifdef USE_STATS
+
+#include <util/atomic.h>
+
+typedef struct {
+  unsigned long count;
+  unsigned long sum;       // us
+  uint16_t min;            // us, saturated
+  uint16_t max;
+  uint16_t hist[STATS_BUCKETS];
+} StageStats;
+
+StageStats stageStats[STATS_STAGES];
+
+/* The counters are kept by their owners; a reset moves the base */
+unsigned int statsOverrunBase = 0;
+unsigned int statsRxFullBase = 0;
+
+unsigned int statsOverruns() {
+  #ifdef USE_BASE
+    return schedulerOverruns(TASK_CONTROL);
+  #else
+    return 0;
+  #endif
+}
+
+void statsRecord(uint8_t stage, unsigned long micros) {
+  StageStats *s = &stageStats[stage];
+  uint16_t us = micros > 0xFFFF ? 0xFFFF : micros;
+
+  // log2 bucket without a division: shift until under the first bound
+  uint8_t bucket = 0;
+  for (uint16_t v = us >> STATS_FIRST_BUCKET; v != 0 && bucket < STATS_BUCKETS - 1; v >>= 1) bucket++;
+  if (s->hist[bucket] != 0xFFFF) s->hist[bucket]++;
+
+  if (s->count == 0 || us < s->min) s->min = us;
+  if (us > s->max) s->max = us;
+  s->count++;
+  s->sum += micros;
+}
+
+void statsReset() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(stageStats, 0, sizeof(stageStats));
+    statsOverrunBase = statsOverruns();
+    statsRxFullBase = rxRingFull;
+  }
+}
+
+bool statsReply(long stage, long reset) {
+  if (stage < 0 || stage > STATS_STAGES || reset < 0 || reset > 1) return false;
+
+  long values[4 + STATS_BUCKETS];
+  uint8_t count;
+  if (stage == STATS_STAGES) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      values[0] = (unsigned int)(statsOverruns() - statsOverrunBase);
+      values[1] = (unsigned int)(rxRingFull - statsRxFullBase);
+    }
+    count = 2;
+  } else {
+    // The control stages are written by the timer interrupt
+    StageStats s;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      s = stageStats[stage];
+    }
+    values[0] = s.count;
+    values[1] = s.min;
+    values[2] = s.max;
+    values[3] = s.count ? s.sum / s.count : 0;
+    for (uint8_t i = 0; i < STATS_BUCKETS; i++) values[4 + i] = s.hist[i];
+    count = 4 + STATS_BUCKETS;
+  }
+  replyValues(values, count);
+
+  if (reset) statsReset();
+  return true;
+}
+
+#endif // USE_STATS
@@ -0,0 +1,98 @@
+/***************************************************************
+   Steering position controller (ZKBM1 drive/steer layout)
+
+   'f <position>' sets the steering target in STEER encoder counts
+   and returns; the control tick does the rest, every tick, whether
+   or not another 'f' arrives:
+
+   1. A trajectory moves the reference position towards the target
+      with at most STEER_MAX_SPEED counts/s and STEER_MAX_ACCEL
+      counts/s^2, braking in time to arrive at rest. A new target
+      while moving starts from the current reference and speed.
+   2. A position PID drives the steering motor from the error
+      between the reference and the STEER count of the tick's
+      encoder snapshot. The reference is smooth, so the derivative
+      is taken on the error.
+
+   Saturation is handled at three places: the output is clamped to
+   STEER_MAX_PWM; the integral only accumulates while the output is
+   not saturated and the reference holds the target, as the lag
+   behind a moving reference is no offset to learn; and a travelling
+   reference the motor cannot follow (a stall, an end stop) is held
+   within STEER_MAX_LAG counts of the measured position. So nothing
+   winds up and there is no overshoot once the motor is free again.
+   Within STEER_TOLERANCE counts of a reference at rest the motor is
+   released.
+
+   Positions are Q8 counts; speeds, accelerations and the gains are
+   per frame (control_rate.h), so the trajectory and the tuning do
+   not change with the loop rate. The gains use the PID kernel's
+   fixed point and Ko division (pid_kernel.h).
+
+   Steering needs a position, so there is none without encoders.
+   *************************************************************/
+
+#ifndef STEERING_H
+#define STEERING_H
+
+#ifdef HAS_STEERING_SUPPORT
+
+/* Position PID gains: (Kp e + Kd de + Ki sum e) / Ko */
+#ifndef STEER_KP
+  #define STEER_KP 32
+#endif
+#ifndef STEER_KD
+  #define STEER_KD 128
+#endif
+#ifndef STEER_KI
+  #define STEER_KI 1
+#endif
+#ifndef STEER_KO
+  #define STEER_KO 4
+#endif
+
+/* Trajectory limits, in counts per second and per second^2 */
+#ifndef STEER_MAX_SPEED
+  #define STEER_MAX_SPEED 300
+#endif
+#ifndef STEER_MAX_ACCEL
+  #define STEER_MAX_ACCEL 1500
+#endif
+
+#define STEER_MAX_PWM   255  // output clamp
+#define STEER_TOLERANCE 2    // counts around a reference at rest
+#define STEER_MAX_LAG   32   // counts the reference may lead the motor
+
+typedef struct {
+  long target;           // Q8 counts
+  long reference;        // Q8 counts, where the trajectory is now
+  long speed;            // Q8 counts per frame of the reference
+  long stepCarry;        // Q8 counts << PID_STEP_Q not yet moved
+  long prevError;        // Q8 counts, for the derivative
+  long iTerm;            // integrated term
+  long output;           // last PWM
+  long maxSpeed;         // Q8 counts per frame
+  long maxAccel;         // Q8 counts per frame^2
+  long tickAccel;        // speed change per tick, Q8 counts per frame
+  long brakeDistance;    // Q8 counts to stop from maxSpeed
+  PIDGains gains;
+} Steering;
+
+extern Steering steering;
+
+/* Limits and gains for the control rate; then steeringReset() */
+void initSteering();
+
+/* Hold the given position (counts): target and reference on it,
+   at rest, integral cleared, motor released */
+void steeringReset(long position);
+
+/* A new target in counts; steeringTick() gets there */
+void setSteeringDirection(int target_position);
+
+/* One control tick with the measured STEER count */
+void steeringTick(long position);
+
+#endif // HAS_STEERING_SUPPORT
+
+#endif // STEERING_H
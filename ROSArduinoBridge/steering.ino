@@ -0,0 +1,142 @@
+/***************************************************************
+   Steering position controller implementation
+   *************************************************************/
+
+#ifdef HAS_STEERING_SUPPORT
+
+Steering steering;
+
+/* floor(sqrt(x)), bit by bit */
+static uint32_t steerSqrt(uint32_t x) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > x) bit >>= 2;
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+void initSteering() {
+  // Per frame, as the speeds of the drive; a tick is pidTickStep of one
+  steering.maxSpeed = ((long)STEER_MAX_SPEED << PID_Q) * PID_INTERVAL / 1000;
+  steering.maxAccel = ((long)STEER_MAX_ACCEL << PID_Q) * PID_INTERVAL * PID_INTERVAL / 1000000L;
+  if (steering.maxAccel < 1) steering.maxAccel = 1;
+  steering.tickAccel = pidPerTick(steering.maxAccel);
+  if (steering.tickAccel < 1) steering.tickAccel = 1;
+  steering.brakeDistance = (uint32_t)steering.maxSpeed * (steering.maxSpeed + steering.tickAccel) / (2UL * steering.maxAccel);
+  pidSetGains(&steering.gains, STEER_KP, STEER_KD, STEER_KI, STEER_KO);
+  steeringReset(readEncoder(STEER));
+}
+
+void steeringReset(long position) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    steering.target = steering.reference = pidTicksToQ8(position);
+    steering.speed = 0;
+    steering.stepCarry = 0;
+    steering.prevError = 0;
+    steering.iTerm = 0;
+    steering.output = 0;
+    EncoderDriver::commanded(STEER, 0);
+    MotorDriver::write<STEER>(0);
+  }
+}
+
+void setSteeringDirection(int target_position) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    steering.target = pidTicksToQ8(target_position);
+  }
+}
+
+/*
+ * Advance the reference one tick: towards the target at the
+ * fastest speed from which it can still brake in time, capped at
+ * maxSpeed and changed by at most tickAccel per tick. A tick moves
+ * the reference by the fraction s = pidTickStep of the speed, so
+ * braking from v in steps of a = s maxAccel covers
+ * s v (v + a) / 2a = v (v + a) / 2 maxAccel, and that speed is
+ * (sqrt(a^2 + 8 maxAccel d) - a) / 2.
+ */
+static void steeringTrajectory() {
+  const long a = steering.tickAccel;
+  long d = steering.target - steering.reference;
+  uint32_t distance = labs(d);
+  long brake = distance >= (uint32_t)steering.brakeDistance
+    ? steering.maxSpeed
+    : ((long)steerSqrt((uint32_t)a * a + 8UL * steering.maxAccel * distance) - a) / 2;
+  long want = d >= 0 ? brake : -brake;
+
+  long v = steering.speed;
+  if (want > v + a) v += a;
+  else if (want < v - a) v -= a;
+  else v = want;
+
+  // The fraction of a count a short tick leaves over moves with the
+  // next one
+  long step = v;
+  if (pidTickStep != PID_STEP_ONE) {
+    long moved = v * pidTickStep + steering.stepCarry;
+    step = moved / PID_STEP_ONE;
+    steering.stepCarry = moved - step * PID_STEP_ONE;
+  }
+
+  // The last, slow step lands on the target instead of passing it
+  if ((d >= 0 ? step >= d : step <= d) && labs(v) <= a) {
+    steering.reference = steering.target;
+    steering.speed = 0;
+    steering.stepCarry = 0;
+  } else {
+    steering.reference += step;
+    steering.speed = v;
+  }
+}
+
+void steeringTick(long position) {
+  long measured = pidTicksToQ8(position);
+  steeringTrajectory();
+
+  // A motor that falls behind (saturated, stalled) holds the
+  // travelling reference back; its speed stays, to go on once the
+  // motor is free
+  if (steering.reference != steering.target) {
+    const long lag = pidTicksToQ8(STEER_MAX_LAG);
+    if (steering.reference > measured + lag) steering.reference = measured + lag;
+    else if (steering.reference < measured - lag) steering.reference = measured - lag;
+  }
+
+  // Positional PID: the output is computed afresh every tick
+  long error = steering.reference - measured;
+  long output;
+  if (steering.speed == 0 && steering.reference == steering.target &&
+      labs(error) <= pidTicksToQ8(STEER_TOLERANCE)) {
+    output = 0;
+  } else {
+    // The derivative per frame, the integral a tick's share of one
+    const PIDGains *g = &steering.gains;
+    long derivative = error - steering.prevError;
+    if (pidTickStep != PID_STEP_ONE) derivative = derivative * (long)controlTicksPerFrame / PID_ONE;
+    long numerator = pidTicks(g->Kp * error + g->Kd * derivative + steering.iTerm);
+    numerator = constrain(numerator, -g->scale.limit, g->scale.limit);
+    output = pidDivide(numerator, &g->scale);
+
+    // Integrate only while holding the target and the output is not
+    // saturated: the lag behind a moving reference is not an offset
+    // to learn
+    if (output >= STEER_MAX_PWM) output = STEER_MAX_PWM;
+    else if (output <= -STEER_MAX_PWM) output = -STEER_MAX_PWM;
+    else if (steering.reference == steering.target) steering.iTerm += pidPerTick(g->Ki * error);
+  }
+
+  steering.prevError = error;
+  steering.output = output;
+  EncoderDriver::commanded(STEER, output);
+  MotorDriver::write<STEER>(output);
+}
+
+#endif // HAS_STEERING_SUPPORT
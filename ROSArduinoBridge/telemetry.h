@@ -0,0 +1,55 @@
+/***************************************************************
+   Telemetry push streams
+
+   Instead of polling READ_ENCODERS every cycle, the host can
+   subscribe once with
+
+     g <streams> <decimation> [<analog_mask>]
+
+   and the firmware then pushes a sample on every <decimation>-th
+   control tick, taken right after the PID update so it lines up
+   with the control loop. "g 0" ends the subscription.
+
+   <streams> is a bit mask of the TELEM_* values below; samples
+   carry the selected streams in bit order. In ASCII a sample is a
+   line starting with 'T':
+
+     T <micros> <values...>
+
+   When the subscription was made with a binary frame, samples are
+   binary frames with opcode TELEMETRY, seq counting samples mod
+   256, status 0 and the payload
+
+     u32 micros, i32 per encoder, i16 per wheel and stream, i16
+     per analog channel, i32 per wheel velocity, i16 range and i16
+     age per ranging sensor, i32 x, i32 y (mm) and i16 theta
+     (mrad) of the odometry pose
+   *************************************************************/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#define TELEM_ENCODERS 0x01  // encoder counts, as READ_ENCODERS
+#define TELEM_OUTPUT   0x02  // PID output (PWM) per wheel
+#define TELEM_TARGET   0x04  // PID target (ticks per frame) per wheel
+#define TELEM_ITERM    0x08  // PID integral term per wheel
+#define TELEM_ANALOG   0x10  // analogRead() of every channel in analog_mask
+#define TELEM_VELOCITY 0x20  // measured speed (Q8 ticks per frame) per wheel
+#define TELEM_RANGE    0x40  // latest range (cm) and its age (ms) per ranging sensor
+#define TELEM_POSE     0x80  // odometry x, y (mm) and theta (mrad), as READ_ODOMETRY
+
+#define TELEM_ALL_STREAMS 0xFF
+
+/*
+ * Start, change or (with streams == 0) stop the subscription.
+ * Samples use the wire format of the subscribing command.
+ * Returns false for invalid arguments, and for binary streams
+ * whose samples could exceed one frame.
+ */
+bool telemetrySubscribe(long streams, long decimation, long analogMask);
+
+/* Scheduler task released with every control tick; runs from
+   loop() after the PID update */
+void telemetryTick();
+
+#endif // TELEMETRY_H
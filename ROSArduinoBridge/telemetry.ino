@@ -0,0 +1,164 @@
+/***************************************************************
+   Telemetry push streams implementation
+   *************************************************************/
+
+#ifdef USE_BASE
+
+#ifdef USE_MECANUM
+  #define TELEM_WHEELS 4
+  #define TELEM_PID wheelPID
+#else
+  #define TELEM_WHEELS 1
+  #define TELEM_PID drivePID
+#endif
+
+uint8_t telemStreams = 0;
+uint8_t telemDecimation = 1;
+uint8_t telemAnalogMask = 0;
+uint8_t telemCountdown = 1;
+uint8_t telemSeq = 0;
+bool telemBinary = false;
+
+/* What the latched control tick left behind, copied in one atomic
+   section so a sample never mixes two ticks or catches a value the
+   control interrupt is halfway through writing */
+typedef struct {
+  EncoderSnapshot encoders;
+  long output[TELEM_WHEELS];
+  long targetQ8[TELEM_WHEELS];
+  long iTerm[TELEM_WHEELS];
+  long prevInput[TELEM_WHEELS];
+  #ifdef USE_ODOMETRY
+    OdomPose pose;
+  #endif
+} TelemLatch;
+
+/* Payload bytes of a binary sample with every ranging slot in use */
+uint8_t telemSampleBytes(uint8_t streams, uint8_t analogMask) {
+  uint8_t bytes = 4;
+  if (streams & TELEM_ENCODERS) bytes += 2 * 4;
+  if (streams & TELEM_OUTPUT) bytes += TELEM_WHEELS * 2;
+  if (streams & TELEM_TARGET) bytes += TELEM_WHEELS * 2;
+  if (streams & TELEM_ITERM) bytes += TELEM_WHEELS * 2;
+  if (streams & TELEM_ANALOG) {
+    for (uint8_t ch = 0; ch < 8; ch++) if (analogMask & (1 << ch)) bytes += 2;
+  }
+  if (streams & TELEM_VELOCITY) bytes += TELEM_WHEELS * 4;
+  if (streams & TELEM_RANGE) bytes += RANGER_SENSORS * 4;
+  #ifdef USE_ODOMETRY
+    if (streams & TELEM_POSE) bytes += 4 + 4 + 2;
+  #endif
+  return bytes;
+}
+
+bool telemetrySubscribe(long streams, long decimation, long analogMask) {
+  if (streams < 0 || streams > TELEM_ALL_STREAMS) return false;
+  if (streams != 0 && (decimation < 1 || decimation > 255)) return false;
+  if (analogMask < 0 || analogMask > 255) return false;
+  #ifdef USE_BINARY_PROTOCOL
+    // opcode, seq, status and CRC share the frame with the sample
+    if (replyBinary && telemSampleBytes(streams, analogMask) > BIN_MAX_FRAME - 5) return false;
+  #endif
+
+  telemStreams = streams;
+  telemDecimation = streams ? decimation : 1;
+  telemAnalogMask = analogMask;
+  telemCountdown = 1;  // first sample on the next tick
+  telemSeq = 0;
+  telemBinary = replyBinary;
+  return true;
+}
+
+/* Gather the selected streams in bit order from the latched tick */
+uint8_t telemCollect(const TelemLatch &latched, long *values, uint8_t *sizes) {
+  uint8_t n = 0;
+  if (telemStreams & TELEM_ENCODERS) {
+    values[n] = latched.encoders.count[DRIVE]; sizes[n++] = 4;
+    values[n] = latched.encoders.count[STEER]; sizes[n++] = 4;
+  }
+  if (telemStreams & TELEM_OUTPUT) {
+    for (uint8_t i = 0; i < TELEM_WHEELS; i++) { values[n] = latched.output[i]; sizes[n++] = 2; }
+  }
+  if (telemStreams & TELEM_TARGET) {
+    for (uint8_t i = 0; i < TELEM_WHEELS; i++) { values[n] = pidTicks(latched.targetQ8[i]); sizes[n++] = 2; }
+  }
+  if (telemStreams & TELEM_ITERM) {
+    for (uint8_t i = 0; i < TELEM_WHEELS; i++) { values[n] = pidTicks(latched.iTerm[i]); sizes[n++] = 2; }
+  }
+  if (telemStreams & TELEM_ANALOG) {
+    for (uint8_t ch = 0; ch < 8; ch++) {
+      if (telemAnalogMask & (1 << ch)) { values[n] = analogRead(ch); sizes[n++] = 2; }
+    }
+  }
+  if (telemStreams & TELEM_VELOCITY) {
+    for (uint8_t i = 0; i < TELEM_WHEELS; i++) { values[n] = latched.prevInput[i]; sizes[n++] = 4; }
+  }
+  if (telemStreams & TELEM_RANGE) {
+    for (uint8_t i = 0; i < rangerCount(); i++) {
+      long age;
+      rangerReport(i, &values[n], &age);
+      sizes[n++] = 2;
+      values[n] = min(age, 32767L); sizes[n++] = 2;
+    }
+  }
+  #ifdef USE_ODOMETRY
+    if (telemStreams & TELEM_POSE) {
+      values[n] = odomMillimetres(latched.pose.x); sizes[n++] = 4;
+      values[n] = odomMillimetres(latched.pose.y); sizes[n++] = 4;
+      values[n] = odomMilliradians(latched.pose.theta); sizes[n++] = 2;
+    }
+  #endif
+  return n;
+}
+
+void telemetryTick() {
+  if (telemStreams == 0 || --telemCountdown != 0) return;
+  telemCountdown = telemDecimation;
+
+  // The instant the control tick latched the encoders, not the
+  // moment loop() got here; only the streams asked for are copied
+  TelemLatch latched;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    latched.encoders = TELEM_PID.encoders;
+    if (telemStreams & TELEM_OUTPUT) memcpy(latched.output, TELEM_PID.output, sizeof(latched.output));
+    if (telemStreams & TELEM_TARGET) memcpy(latched.targetQ8, TELEM_PID.targetQ8, sizeof(latched.targetQ8));
+    if (telemStreams & TELEM_ITERM) memcpy(latched.iTerm, TELEM_PID.iTerm, sizeof(latched.iTerm));
+    if (telemStreams & TELEM_VELOCITY) memcpy(latched.prevInput, TELEM_PID.prevInput, sizeof(latched.prevInput));
+    #ifdef USE_ODOMETRY
+      if (telemStreams & TELEM_POSE) latched.pose = odomPose;
+    #endif
+  }
+  unsigned long stamp = latched.encoders.micros;
+  long values[2 + 4 * TELEM_WHEELS + 8 + 2 * RANGER_SENSORS + 3];
+  uint8_t sizes[2 + 4 * TELEM_WHEELS + 8 + 2 * RANGER_SENSORS + 3];
+  uint8_t count = telemCollect(latched, values, sizes);
+
+  #ifdef USE_BINARY_PROTOCOL
+    if (telemBinary) {
+      uint8_t payload[4 + sizeof(values)];
+      uint8_t len = 0;
+      for (uint8_t b = 0; b < 4; b++) payload[len++] = (uint8_t)(stamp >> (8 * b));
+      for (uint8_t i = 0; i < count; i++) {
+        long v = values[i];
+        for (uint8_t b = 0; b < sizes[i]; b++) {
+          payload[len++] = (uint8_t)v;
+          v >>= 8;
+        }
+      }
+      binSendFrame(TELEMETRY, telemSeq++, BIN_STATUS_OK, payload, len);
+      return;
+    }
+  #endif
+
+  txBegin();
+  txPutString("T ");
+  txPutUnsigned(stamp);
+  for (uint8_t i = 0; i < count; i++) {
+    txPut(' ');
+    txPutLong(values[i]);
+  }
+  txPutString("\r\n");
+  txEnd();
+}
+
+#endif // USE_BASE
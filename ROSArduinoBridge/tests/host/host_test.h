@@ -0,0 +1,164 @@
+/* *************************************************************
+   Host test helpers
+
+   Each host test includes the whole sketch (firmware_sketch.h,
+   generated by CMakeLists.txt) and is built once per configuration,
+   so the tests use the same #ifdefs as the firmware to decide what
+   to expect. Failed checks are printed and counted; main() returns
+   the count so ctest reports the test as failed.
+   ************************************************************ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include "firmware_sketch.h"
+#include "mock_control.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      hostTestFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long a_ = (long long)(actual), e_ = (long long)(expected); \
+    if (a_ != e_) { \
+      printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+      hostTestFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_STR(actual, expected) \
+  do { \
+    std::string a_ = (actual), e_ = (expected); \
+    if (a_ != e_) { \
+      printf("%s:%d: %s == \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, a_.c_str(), e_.c_str()); \
+      hostTestFailures++; \
+    } \
+  } while (0)
+
+#define RUN_TEST(fn) \
+  do { \
+    startFirmware(); \
+    fn(); \
+  } while (0)
+
+static inline int testResult() {
+  if (hostTestFailures) printf("%d check(s) failed\n", hostTestFailures);
+  return hostTestFailures ? 1 : 0;
+}
+
+/* Power-on the board and drop the start-up output */
+static inline void startFirmware() {
+  mock_reset();
+  setup();
+  mock_serial_take_output();
+}
+
+/* Let the firmware run for a while in 1 ms steps */
+static inline void runFor(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    mock_advance_micros(1000);
+    loop();
+  }
+}
+
+/* Send bytes, give the firmware a few milliseconds, return its output */
+static inline std::string transact(const std::string &bytes) {
+  mock_serial_feed(bytes);
+  runFor(3);
+  return mock_serial_take_output();
+}
+
+/* An ASCII command line; returns the reply without its CR LF */
+static inline std::string command(const std::string &line) {
+  std::string reply = transact(line + "\r");
+  if (reply.size() >= 2 && reply.compare(reply.size() - 2, 2, "\r\n") == 0) reply.resize(reply.size() - 2);
+  return reply;
+}
+
+/* Reference CRC-16/CCITT-FALSE, bit by bit */
+static inline uint16_t referenceCrc(const std::vector<uint8_t> &data) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < data.size(); i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+/* A complete binary frame: NUL, COBS(opcode seq payload crc), NUL */
+static inline std::string binaryFrame(uint8_t opcode, uint8_t seq, const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> body;
+  body.push_back(opcode);
+  body.push_back(seq);
+  body.insert(body.end(), payload.begin(), payload.end());
+  uint16_t crc = referenceCrc(body);
+  body.push_back(crc & 0xFF);
+  body.push_back(crc >> 8);
+
+  std::string out(1, '\0');
+  size_t codeIndex = out.size();
+  out.push_back(1);
+  for (size_t i = 0; i < body.size(); i++) {
+    if (body[i] == 0) {
+      codeIndex = out.size();
+      out.push_back(1);
+    } else {
+      out.push_back((char)body[i]);
+      out[codeIndex]++;
+    }
+  }
+  out.push_back('\0');
+  return out;
+}
+
+/* Decode the first frame of the output (without the CRC); empty if
+   there is none or its CRC is wrong */
+static inline std::vector<uint8_t> decodeFrame(const std::string &bytes) {
+  std::vector<uint8_t> body;
+  size_t i = bytes.find('\0');
+  if (i == std::string::npos) return body;
+  i++;
+  while (i < bytes.size() && bytes[i] != '\0') {
+    uint8_t code = bytes[i++];
+    for (uint8_t k = 1; k < code && i < bytes.size(); k++) body.push_back(bytes[i++]);
+    if (code != 0xFF && i < bytes.size() && bytes[i] != '\0') body.push_back(0);
+  }
+  if (body.size() < 2) return std::vector<uint8_t>();
+  std::vector<uint8_t> data(body.begin(), body.end() - 2);
+  uint16_t crc = body[body.size() - 2] | (body[body.size() - 1] << 8);
+  if (referenceCrc(data) != crc) return std::vector<uint8_t>();
+  return data;
+}
+
+/* Little-endian int16 for a frame payload */
+static inline void putInt16(std::vector<uint8_t> &p, int v) {
+  p.push_back(v & 0xFF);
+  p.push_back((v >> 8) & 0xFF);
+}
+
+#if defined(USE_BASE) && !defined(NO_ENCODERS)
+/* Move the two encoders by the given number of ticks, behind the
+   encoder driver's interrupts */
+static inline void addEncoderTicks(long left, long right) {
+  #ifdef ROBOGAIA
+    EncoderDriver::counter.y += left;
+    EncoderDriver::counter.x += right;
+  #else
+    EncoderDriver::count[LEFT] += left;
+    EncoderDriver::count[RIGHT] += right;
+  #endif
+}
+#endif
+
+#endif // HOST_TEST_H
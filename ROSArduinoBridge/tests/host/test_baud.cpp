@@ -0,0 +1,119 @@
+/* *************************************************************
+   Host tests for runtime baud rate negotiation: the ack leaves at
+   the old rate, the switch waits for the TX path, a rate the host
+   never confirms falls back to BAUDRATE, and what a stalled loop()
+   costs a stream at 500k and at 1M baud
+   ************************************************************ */
+
+#include "host_test.h"
+
+void testSwitchAndConfirm() {
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  CHECK_STR(command("j 500000"), "500000");
+  CHECK_EQ(mock_serial_baud(), 500000UL);
+
+  CHECK_STR(command("b"), "500000");
+  runFor(BAUD_CONFIRM_TIMEOUT + 100);
+  CHECK_EQ(mock_serial_baud(), 500000UL);
+  CHECK_STR(command("b"), "500000");
+}
+
+void testFallbackWithoutConfirm() {
+  CHECK_STR(command("j 1000000"), "1000000");
+  CHECK_EQ(mock_serial_baud(), 1000000UL);
+  runFor(BAUD_CONFIRM_TIMEOUT - 10);
+  CHECK_EQ(mock_serial_baud(), 1000000UL);
+  runFor(20);
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  CHECK_STR(command("b"), std::to_string(BAUDRATE));
+}
+
+void testSwitchWaitsForTheAck() {
+  mock_serial_set_tx_pacing(true);
+  mock_serial_feed("j 1000000\r");
+  loop();
+  // The ack is still in the core's buffer
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  runFor(2);
+  CHECK_EQ(mock_serial_baud(), 1000000UL);
+  CHECK_STR(mock_serial_take_output(), "1000000\r\n");
+  mock_serial_set_tx_pacing(false);
+}
+
+/* Stream bytesPerMs of "b" lines for ms milliseconds in which only
+   the timer tick runs, not loop() */
+static void streamWhileStalled(int bytesPerMs, int ms) {
+  std::string chunk;
+  while ((int)chunk.size() < bytesPerMs) chunk += "b\r";
+  chunk.resize(bytesPerMs);
+  for (int i = 0; i < ms; i++) {
+    mock_serial_feed(chunk);
+    mock_advance_micros(1000);
+  }
+}
+
+void testRingCarriesAStallAt500k() {
+  CHECK_STR(command("j 500000"), "500000");
+  CHECK_STR(command("b"), "500000");
+  unsigned int full = rxRingFull;
+  // 50 bytes per ms: the tick empties the core's buffer in time
+  streamWhileStalled(50, 2);
+  CHECK_EQ(mock_serial_rx_dropped(), 0U);
+  CHECK_EQ(rxRingFull, full);
+  runFor(20);
+  mock_serial_take_output();
+  CHECK_STR(command("b"), "500000");
+}
+
+void testStreamLostInAStallAt1M() {
+  CHECK_STR(command("j 1000000"), "1000000");
+  CHECK_STR(command("b"), "1000000");
+  unsigned int full = rxRingFull;
+  // 100 bytes per ms overflow the core's buffer between two ticks,
+  // and the ring once loop() has not parsed it for a while
+  streamWhileStalled(100, 3);
+  CHECK(mock_serial_rx_dropped() > 0);
+  CHECK(rxRingFull > full);
+
+  // The bytes are gone, the link is not
+  runFor(20);
+  mock_serial_take_output();
+  command("");
+  CHECK_STR(command("b"), "1000000");
+}
+
+void testUnknownRate() {
+  CHECK_STR(command("j 9600"), "Invalid Argument");
+  CHECK_STR(command("j 2000000"), "Invalid Argument");
+  CHECK_STR(command("j 0"), "Invalid Argument");
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+}
+
+#ifdef USE_BINARY_PROTOCOL
+void testBinaryConfirm() {
+  std::vector<uint8_t> payload;
+  long rate = 250000;
+  for (int i = 0; i < 4; i++) payload.push_back((rate >> (8 * i)) & 0xFF);
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame(SET_BAUDRATE, 3, payload)));
+  CHECK_EQ(reply.size(), 7U);
+  CHECK_EQ(mock_serial_baud(), 250000UL);
+
+  reply = decodeFrame(transact(binaryFrame(GET_BAUDRATE, 4, std::vector<uint8_t>())));
+  CHECK_EQ(reply.size(), 7U);
+  runFor(BAUD_CONFIRM_TIMEOUT + 100);
+  CHECK_EQ(mock_serial_baud(), 250000UL);
+}
+#endif
+
+int main() {
+  RUN_TEST(testSwitchAndConfirm);
+  RUN_TEST(testFallbackWithoutConfirm);
+  RUN_TEST(testSwitchWaitsForTheAck);
+  RUN_TEST(testRingCarriesAStallAt500k);
+  RUN_TEST(testStreamLostInAStallAt1M);
+  RUN_TEST(testUnknownRate);
+#ifdef USE_BINARY_PROTOCOL
+  RUN_TEST(testBinaryConfirm);
+#endif
+  return testResult();
+}
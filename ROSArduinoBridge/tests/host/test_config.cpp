@@ -0,0 +1,314 @@
+/* *************************************************************
+   Host tests for the stored configuration: compiled-in values on
+   a blank EEPROM, get and set per key, commit and reload across a
+   reboot in one block read, the stored control rate, geometry
+   out of its physical range, and blobs that are corrupt or
+   forgotten being ignored
+   ************************************************************ */
+
+#include "host_test.h"
+
+#include <cmath>
+
+#ifdef USE_MECANUM
+  #define DEFAULT_KP MecanumKp
+  #define DEFAULT_KO MecanumKo
+#elif defined(USE_BASE)
+  #define DEFAULT_KP Kp
+  #define DEFAULT_KO Ko
+#endif
+
+/* "k 0 <key>" */
+static std::string get(int key) {
+  return command("k 0 " + std::to_string(key));
+}
+
+static std::string set(int key, long value) {
+  return command("k 1 " + std::to_string(key) + " " + std::to_string(value));
+}
+
+/* Runs first, on the blank EEPROM of a fresh process */
+void testCompiledInValues() {
+  CHECK_EQ(mock_eeprom_reads(), 1);
+  CHECK_STR(get(CONFIG_KEY_BAUD), std::to_string(BAUDRATE));
+  #ifdef USE_BASE
+    CHECK_STR(get(CONFIG_KEY_GAINS), std::to_string(DEFAULT_KP));
+    CHECK_STR(get(CONFIG_KEY_GAINS + 3), std::to_string(DEFAULT_KO));
+  #else
+    CHECK_STR(get(CONFIG_KEY_GAINS), "Invalid Argument");
+  #endif
+  #ifdef USE_MECANUM
+    CHECK_STR(get(CONFIG_KEY_GAINS + 4 * 3 + 3), std::to_string(DEFAULT_KO));
+    CHECK_STR(get(CONFIG_KEY_KINEMATICS), "50000");
+    CHECK_STR(get(CONFIG_KEY_KINEMATICS + 3), "1000");
+  #else
+    CHECK_STR(get(CONFIG_KEY_GAINS + 4), "Invalid Argument");
+    CHECK_STR(get(CONFIG_KEY_KINEMATICS), "Invalid Argument");
+  #endif
+  #ifdef SPARKFUN_TB6612
+    CHECK_STR(get(CONFIG_KEY_OFFSET + 2), "1");
+    CHECK_STR(get(CONFIG_KEY_TRIM), "0");
+    CHECK_STR(get(CONFIG_KEY_DEADZONE), std::to_string(MOTOR_DEADZONE));
+  #else
+    CHECK_STR(get(CONFIG_KEY_DEADZONE), "Invalid Argument");
+  #endif
+}
+
+void testBadArguments() {
+  CHECK_STR(get(CONFIG_KEYS), "Invalid Argument");
+  CHECK_STR(get(-1), "Invalid Argument");
+  CHECK_STR(command("k 4 0"), "Invalid Argument");
+  CHECK_STR(set(CONFIG_KEY_BAUD, 9600), "Invalid Argument");
+  #ifdef USE_BASE
+    CHECK_STR(set(CONFIG_KEY_GAINS + 3, 0), "Invalid Argument");
+    CHECK_STR(set(CONFIG_KEY_GAINS, 40000), "Invalid Argument");
+  #endif
+  #ifdef SPARKFUN_TB6612
+    CHECK_STR(set(CONFIG_KEY_OFFSET, 2), "Invalid Argument");
+    CHECK_STR(set(CONFIG_KEY_TRIM, 300), "Invalid Argument");
+  #endif
+}
+
+#ifdef USE_BASE
+void testGains() {
+  #ifdef USE_MECANUM
+    // Every wheel has its own; the others keep theirs
+    CHECK_STR(set(CONFIG_KEY_GAINS + 4 * 1 + 1, 9), "9");
+    CHECK_STR(set(CONFIG_KEY_GAINS + 4 * 1 + 3, 64), "64");
+    CHECK_EQ(wheelPID.gains[1].Kd, 9);
+    CHECK_EQ(wheelPID.gains[1].scale.divisor, 64);
+    CHECK_EQ(wheelPID.gains[0].Kd, MecanumKd);
+    CHECK_EQ(wheelPID.gains[2].scale.divisor, MecanumKo);
+    CHECK_STR(get(CONFIG_KEY_GAINS + 4 * 1 + 1), "9");
+  #else
+    // The same gains as 'u', either way round
+    CHECK_STR(command("u 1 2 3 4"), "OK");
+    CHECK_STR(get(CONFIG_KEY_GAINS + 2), "3");
+    CHECK_STR(set(CONFIG_KEY_GAINS + 3, 8), "8");
+    CHECK_EQ(Ko, 8);
+    CHECK_STR(command("u 20 12 0 50"), "OK");
+  #endif
+}
+#endif
+
+#ifdef USE_MECANUM
+void testGeometryRanges() {
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS, 100000), "100000");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS, 0), "Invalid Argument");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS, 1000), "Invalid Argument");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS + 1, 10000000), "Invalid Argument");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS + 3, 20000), "Invalid Argument");
+  CHECK_STR(get(CONFIG_KEY_KINEMATICS), "100000");
+  CHECK_STR(get(CONFIG_KEY_KINEMATICS + 3), "1000");
+
+  // Each in range, but together the wheels would have to turn
+  // faster than the inverse kinematics can hold
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS + 3, 10000), "10000");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS + 5, 100000000L), "Invalid Argument");
+  CHECK_STR(get(CONFIG_KEY_KINEMATICS + 5), std::to_string(lround(DEFAULT_TICKS_PER_REV * 1000)));
+
+  // The fastest twist the geometry allows still comes out right:
+  // the front right wheel adds vx, vy and the rotation
+  long targetQ8[4];
+  mecanumTwistToTargets(mecanumMaxLinear, mecanumMaxLinear, mecanumMaxAngular, targetQ8);
+  float leverArm = (mecanumParams.wheelBase + mecanumParams.trackWidth) / 2;
+  double rim = 2 * mecanumParams.maxLinearVel + leverArm * mecanumParams.maxAngularVel;
+  double expected = wheelSpeedToTicksPerFrame(rim) * PID_ONE;
+  CHECK(targetQ8[1] > 0);
+  CHECK(fabs(targetQ8[1] - expected) <= expected / 100);
+}
+
+void testStoredGeometryOutOfRange() {
+  CHECK_STR(set(CONFIG_KEY_GAINS, 33), "33");
+  CHECK_STR(set(CONFIG_KEY_KINEMATICS + 3, 500), "500");
+  CHECK_STR(command("k 2"), "OK");
+
+  // A blob from elsewhere with a geometry no set would take
+  BridgeConfig stored;
+  memcpy(&stored, mock_eeprom_data() + CONFIG_ADDRESS, sizeof(stored));
+  stored.kinematics[3] = 100;  // m/s
+  stored.crc = configCrc(&stored);
+  memcpy(mock_eeprom_data() + CONFIG_ADDRESS, &stored, sizeof(stored));
+
+  startFirmware();
+  CHECK_STR(get(CONFIG_KEY_GAINS), "33");
+  CHECK_STR(get(CONFIG_KEY_KINEMATICS + 3), "1000");
+  CHECK_EQ(mecanumMaxLinear, 1000);
+  CHECK_STR(command("k 3"), "OK");
+  command("u 20 12 0 50");
+}
+#endif
+
+#ifdef SPARKFUN_TB6612
+/* A raw PWM line for the first motor (L1) alone */
+static std::string driveFirst(int speed) {
+  #ifdef USE_MECANUM
+    return command("o " + std::to_string(speed) + " 0 0 0");
+  #else
+    return command("o " + std::to_string(speed) + " 0");
+  #endif
+}
+
+void testMotorTrims() {
+  CHECK_STR(set(CONFIG_KEY_DEADZONE, 40), "40");
+  CHECK_STR(driveFirst(5), "OK");
+  CHECK_EQ(mock_pwm_value(L_PWMA), 40);
+
+  CHECK_STR(set(CONFIG_KEY_TRIM, 10), "10");
+  CHECK_STR(driveFirst(50), "OK");
+  CHECK_EQ(mock_pwm_value(L_PWMA), 60);
+
+  // Reversed channel: -50 plus the trim
+  CHECK_STR(set(CONFIG_KEY_OFFSET, -1), "-1");
+  CHECK_STR(driveFirst(50), "OK");
+  CHECK_EQ(mock_pwm_value(L_PWMA), 40);
+  CHECK_EQ(mock_digital_level(L_AIN1), LOW);
+  CHECK_EQ(mock_digital_level(L_AIN2), HIGH);
+
+  set(CONFIG_KEY_OFFSET, 1);
+  set(CONFIG_KEY_TRIM, 0);
+  set(CONFIG_KEY_DEADZONE, MOTOR_DEADZONE);
+  driveFirst(0);
+}
+#endif
+
+#ifdef ARDUINO_ENC_COUNTER
+static void stepLeft(int steps) {
+  static const uint8_t QUADRATURE[4] = { 0, 1, 3, 2 };
+  static int phase = 0;
+  for (int i = 0; i < steps; i++) {
+    phase = (phase + 1) & 3;
+    mock_set_pind((PIND & ~(3 << LEFT_ENC_PIN_A)) | (QUADRATURE[phase] << LEFT_ENC_PIN_A));
+  }
+}
+
+void testEncoderDirection() {
+  CHECK_STR(command("r"), "OK");
+  stepLeft(10);
+  long forward = readEncoder(LEFT);
+  CHECK_EQ(labs(forward), 10);
+
+  // The same turning counts the other way from now on
+  CHECK_STR(set(CONFIG_KEY_ENC_DIR + LEFT, -1), "-1");
+  stepLeft(10);
+  CHECK_EQ(readEncoder(LEFT), 0);
+  CHECK_STR(get(CONFIG_KEY_ENC_DIR + LEFT), "-1");
+  set(CONFIG_KEY_ENC_DIR + LEFT, 1);
+}
+#endif
+
+#ifdef USE_BASE
+void testControlRate() {
+  CHECK_STR(get(CONFIG_KEY_RATE), std::to_string(1000 / PID_INTERVAL));
+  CHECK_STR(set(CONFIG_KEY_RATE, 2000), "Invalid Argument");
+  CHECK_STR(set(CONFIG_KEY_RATE, 500), "500");
+  CHECK_STR(command("z"), "500");
+
+  // Stored, the next boot runs at it
+  CHECK_STR(command("k 2"), "OK");
+  startFirmware();
+  CHECK_STR(command("z"), "500");
+  CHECK_EQ(controlPeriod, 2);
+
+  CHECK_STR(command("k 3"), "OK");
+  startFirmware();
+  CHECK_STR(get(CONFIG_KEY_RATE), std::to_string(1000 / PID_INTERVAL));
+}
+#endif
+
+void testCommitAndReload() {
+  #ifdef USE_BASE
+    CHECK_STR(set(CONFIG_KEY_GAINS, 33), "33");
+  #endif
+  CHECK_STR(set(CONFIG_KEY_BAUD, 250000), "250000");
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  CHECK_STR(command("k 2"), "OK");
+  CHECK(mock_eeprom_writes() > 0);
+
+  // Unchanged bytes are not written again
+  unsigned long writes = mock_eeprom_writes();
+  CHECK_STR(command("k 2"), "OK");
+  CHECK_EQ(mock_eeprom_writes(), writes);
+
+  // Set but not committed: the reboot brings back the stored values
+  #ifdef USE_BASE
+    set(CONFIG_KEY_GAINS, 44);
+  #endif
+  unsigned long reads = mock_eeprom_reads();
+  startFirmware();
+  CHECK_EQ(mock_eeprom_reads(), reads + 1);
+  CHECK_EQ(mock_serial_baud(), 250000UL);
+  CHECK_STR(command("b"), "250000");
+  #ifdef USE_BASE
+    CHECK_STR(get(CONFIG_KEY_GAINS), "33");
+  #endif
+
+  // Forgotten, the next boot is at the compiled-in rate again
+  CHECK_STR(command("k 3"), "OK");
+  set(CONFIG_KEY_BAUD, BAUDRATE);
+  #ifdef USE_BASE
+    set(CONFIG_KEY_GAINS, 55);
+  #endif
+  startFirmware();
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  #ifdef USE_BASE
+    CHECK(get(CONFIG_KEY_GAINS) != "33");
+    command("u 20 12 0 50");
+  #endif
+}
+
+void testCorruptBlobIgnored() {
+  CHECK_STR(set(CONFIG_KEY_BAUD, 500000), "500000");
+  CHECK_STR(command("k 2"), "OK");
+  set(CONFIG_KEY_BAUD, BAUDRATE);
+  mock_eeprom_data()[CONFIG_ADDRESS + 10] ^= 0x01;
+  startFirmware();
+  CHECK_EQ(mock_serial_baud(), (unsigned long)BAUDRATE);
+  CHECK_STR(get(CONFIG_KEY_BAUD), std::to_string(BAUDRATE));
+  CHECK_STR(command("k 3"), "OK");
+}
+
+#ifdef USE_BINARY_PROTOCOL
+void testBinary() {
+  std::vector<uint8_t> payload(6, 0);
+  payload[0] = CONFIG_GET;
+  payload[1] = CONFIG_KEY_BAUD;
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame(CONFIG_VALUE, 7, payload)));
+  CHECK_EQ(reply.size(), 3U + 4);
+  if (reply.size() == 7) {
+    CHECK_EQ(reply[2], BIN_STATUS_OK);
+    CHECK_EQ(reply[3] | (reply[4] << 8) | ((long)reply[5] << 16), BAUDRATE);
+  }
+
+  payload[0] = CONFIG_SET;
+  reply = decodeFrame(transact(binaryFrame(CONFIG_VALUE, 8, payload)));
+  CHECK(reply.size() == 3 && reply[2] == BIN_STATUS_BAD_ARGUMENT);
+}
+#endif
+
+int main() {
+  RUN_TEST(testCompiledInValues);
+  RUN_TEST(testBadArguments);
+#ifdef USE_BASE
+  RUN_TEST(testGains);
+#endif
+#ifdef USE_MECANUM
+  RUN_TEST(testGeometryRanges);
+  RUN_TEST(testStoredGeometryOutOfRange);
+#endif
+#ifdef SPARKFUN_TB6612
+  RUN_TEST(testMotorTrims);
+#endif
+#ifdef ARDUINO_ENC_COUNTER
+  RUN_TEST(testEncoderDirection);
+#endif
+#ifdef USE_BASE
+  RUN_TEST(testControlRate);
+#endif
+  RUN_TEST(testCommitAndReload);
+  RUN_TEST(testCorruptBlobIgnored);
+#ifdef USE_BINARY_PROTOCOL
+  RUN_TEST(testBinary);
+#endif
+  return testResult();
+}
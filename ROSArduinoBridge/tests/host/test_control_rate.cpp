@@ -0,0 +1,188 @@
+/* *************************************************************
+   Host tests for the selectable control rate: 'z' sets and reports
+   the rate, the control tick follows it, a simulated wheel reaches
+   the same speed with the same gains at 30 and 500 Hz, and at 1 kHz
+   telemetry samples still come whole from the tick they name
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+#include <cmath>
+#include <map>
+#include <sstream>
+
+void testDefaultRate() {
+  CHECK_STR(command("z"), std::to_string(1000 / PID_INTERVAL));
+  CHECK_STR(command("z 0"), std::to_string(1000 / PID_INTERVAL));
+  CHECK_EQ(controlPeriod, PID_INTERVAL);
+  CHECK_EQ(pidTickStep, PID_STEP_ONE);
+  CHECK_EQ(controlTicksPerFrame, PID_ONE);
+}
+
+void testControlTickFollowsTheRate() {
+  CHECK_STR(command("z 500"), "500");
+  CHECK_EQ(controlPeriod, 2);
+  CHECK_STR(command("z"), "500");
+
+  unsigned int before = schedulerRuns(TASK_CONTROL);
+  runFor(100);
+  CHECK(labs((long)(schedulerRuns(TASK_CONTROL) - before) - 50) <= 1);
+  CHECK_EQ(schedulerOverruns(TASK_CONTROL), 0);
+
+  // Whole milliseconds only
+  CHECK_STR(command("z 300"), "333");
+  CHECK_EQ(controlPeriod, 3);
+  CHECK_STR(command("z 1000"), "1000");
+}
+
+void testRatesOutOfRangeRefused() {
+  CHECK_STR(command("z 250"), "250");
+  CHECK_STR(command("z 1001"), "Invalid Argument");
+  CHECK_STR(command("z 10"), "Invalid Argument");
+  CHECK_STR(command("z -500"), "Invalid Argument");
+  CHECK_STR(command("z"), "250");
+}
+
+void testBootsAtTheReferenceRate() {
+  CHECK_STR(command("z 500"), "500");
+  startFirmware();
+  CHECK_STR(command("z"), std::to_string(1000 / PID_INTERVAL));
+  CHECK_EQ(pidTickStep, PID_STEP_ONE);
+}
+
+#ifndef NO_ENCODERS
+
+/* The streams telemetry reports for the latest control tick, keyed
+   by its latch time, as "g 55" lists them */
+static std::vector<long> latchedTick(unsigned long *stamp) {
+  *stamp = TELEM_PID.encoders.micros;
+  std::vector<long> v;
+  v.push_back(TELEM_PID.encoders.count[DRIVE]);
+  v.push_back(TELEM_PID.encoders.count[STEER]);
+  for (uint8_t i = 0; i < TELEM_WHEELS; i++) v.push_back(TELEM_PID.output[i]);
+  for (uint8_t i = 0; i < TELEM_WHEELS; i++) v.push_back(pidTicks(TELEM_PID.targetQ8[i]));
+  for (uint8_t ch = 0; ch < 8; ch++) v.push_back(100 + ch);
+  for (uint8_t i = 0; i < TELEM_WHEELS; i++) v.push_back(TELEM_PID.prevInput[i]);
+  return v;
+}
+
+void testTelemetryAtHighRate() {
+  for (uint8_t ch = 0; ch < 8; ch++) mock_set_analog_input(A0 + ch, 100 + ch);
+  CHECK_STR(command("z 1000"), "1000");
+  #ifdef USE_MECANUM
+    CHECK_STR(command("n 200 0 0"), "OK");
+  #else
+    CHECK_STR(command("m 20"), "OK");
+  #endif
+  // Encoders, output, target, all eight analog channels and velocity:
+  // the analog reads take the sample across the next control tick
+  mock_serial_feed("g 55 1 255\r");
+
+  std::map<unsigned long, std::vector<long> > ticks;
+  for (int i = 0; i < 300; i++) {
+    addEncoderTicks(i % 3 + 1, i % 5);
+    lastMotorCommand = millis();
+    mock_advance_micros(1000);
+    unsigned long stamp;
+    std::vector<long> tick = latchedTick(&stamp);
+    ticks[stamp] = tick;
+    loop();
+  }
+
+  std::string output = mock_serial_take_output();
+  CHECK_STR(output.substr(0, 4), "OK\r\n");
+  std::istringstream lines(output);
+  std::string line;
+  int samples = 0, matched = 0;
+  while (std::getline(lines, line)) {
+    // The last line may still be on its way out
+    if (line.compare(0, 2, "T ") != 0 || line[line.size() - 1] != '\r') continue;
+    samples++;
+    std::istringstream fields(line.substr(2));
+    unsigned long stamp;
+    fields >> stamp;
+    std::vector<long> values;
+    long v;
+    while (fields >> v) values.push_back(v);
+    std::map<unsigned long, std::vector<long> >::const_iterator tick = ticks.find(stamp);
+    if (tick == ticks.end()) continue;
+    matched++;
+    CHECK(values == tick->second);
+  }
+  CHECK(samples >= 100);
+  CHECK(matched >= 50);
+  CHECK_EQ(schedulerOverruns(TASK_CONTROL), 0);
+  // The subscription outlives startFirmware()
+  mock_serial_feed("g 0\r");
+  runFor(3);
+}
+
+#endif
+
+#if !defined(NO_ENCODERS) && !defined(ROBOGAIA) && !defined(USE_MECANUM)
+
+/* The wheel: counts per ms at full PWM and its time constant (ms) */
+static const double WHEEL_GAIN = 1.5 / 255;
+static const double WHEEL_TAU = 100;
+
+/* Drive 'm <speed>' for the given time with the wheel simulated in
+   100 us steps, edge times included; returns the mean speed over
+   the last second in counts per frame */
+static double wheelSpeed(int speed, unsigned long ms) {
+  CHECK_STR(command("m " + std::to_string(speed)), "OK");
+  double position = 0, velocity = 0;
+  long counted = 0, countedAtStart = 0;
+  unsigned long start = micros(), measureFrom = ms > 1000 ? ms - 1000 : 0;
+  for (unsigned long step = 0; step < ms * 10; step++) {
+    if (step == measureFrom * 10) countedAtStart = counted;
+    velocity += (WHEEL_GAIN * drivePID.output[0] - velocity) * 0.1 / WHEEL_TAU;
+    position += velocity * 0.1;
+    mock_advance_micros(100);
+    long whole = lround(floor(position));
+    if (whole != counted) {
+      addEncoderTicks(whole - counted, 0);
+      EncoderDriver::edge[LEFT] = start + (step + 1) * 100;
+      counted = whole;
+    }
+    lastMotorCommand = millis();
+  }
+  return (counted - countedAtStart) * (double)PID_INTERVAL / (ms - measureFrom);
+}
+
+void testSameSpeedAtEveryRate() {
+  const int target = 20;
+  // At the reference rate the whole-PWM steps leave an error of up
+  // to Ko / Kp ticks per frame; shorter ticks carry the remainder
+  const double settled = (double)Ko / Kp;
+
+  double slow = wheelSpeed(target, 4000);
+  CHECK(fabs(slow - target) <= settled);
+
+  startFirmware();
+  CHECK_STR(command("z 500"), "500");
+  double fast = wheelSpeed(target, 4000);
+  CHECK(fabs(fast - target) <= settled);
+  CHECK(fabs(fast - target) <= fabs(slow - target));
+}
+
+#endif
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testDefaultRate);
+  RUN_TEST(testControlTickFollowsTheRate);
+  RUN_TEST(testRatesOutOfRangeRefused);
+  RUN_TEST(testBootsAtTheReferenceRate);
+  #ifndef NO_ENCODERS
+    RUN_TEST(testTelemetryAtHighRate);
+  #endif
+  #if !defined(NO_ENCODERS) && !defined(ROBOGAIA) && !defined(USE_MECANUM)
+    RUN_TEST(testSameSpeedAtEveryRate);
+  #endif
+#endif
+  return testResult();
+}
@@ -0,0 +1,124 @@
+/* *************************************************************
+   Host tests for the driver policies: the side and wheel mapping
+   on a recording mock driver, every pin-level motor driver on its
+   own pins whichever is selected, and the encoder driver hearing
+   the commanded direction from the motor side it watches
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+/* A four-channel driver that records what it was given */
+struct RecordingMotors : MotorOutputs<RecordingMotors, 4> {
+  static const uint8_t LEFT_SIDE = 0x05;
+  static const uint8_t RIGHT_SIDE = 0x02;
+  static const uint8_t FL = 3, FR = 2, RL = 1, RR = 0;
+
+  static int written[4];
+  static int writes;
+
+  static void init() { forget(); }
+
+  template <uint8_t I>
+  static inline void write(int speed) {
+    written[I] = speed;
+    writes++;
+  }
+};
+
+int RecordingMotors::written[4];
+int RecordingMotors::writes;
+
+static void clearRecording() {
+  for (int i = 0; i < 4; i++) RecordingMotors::written[i] = 0;
+  RecordingMotors::writes = 0;
+}
+
+void testSidesFollowMasks() {
+  clearRecording();
+  MotorSides<RecordingMotors>::write(50, -60);
+  CHECK_EQ(RecordingMotors::written[0], 50);
+  CHECK_EQ(RecordingMotors::written[1], -60);
+  CHECK_EQ(RecordingMotors::written[2], 50);
+
+  // A channel on neither side is not written at all
+  CHECK_EQ(RecordingMotors::written[3], 0);
+  CHECK_EQ(RecordingMotors::writes, 3);
+}
+
+void testWheelsFollowChannels() {
+  clearRecording();
+  driveWheels<RecordingMotors>(1, 2, 3, 4);
+  CHECK_EQ(RecordingMotors::written[3], 1);
+  CHECK_EQ(RecordingMotors::written[2], 2);
+  CHECK_EQ(RecordingMotors::written[1], 3);
+  CHECK_EQ(RecordingMotors::written[0], 4);
+  CHECK_EQ(RecordingMotors::writes, 4);
+}
+
+/* The pin-level drivers compile and drive their pins in every build */
+void testEveryDriverOnItsPins() {
+  L298Motors::init();
+  L298Motors::write<LEFT>(-80);
+  L298Motors::write<RIGHT>(300);
+  CHECK_EQ(mock_pwm_value(LEFT_MOTOR_BACKWARD), 80);
+  CHECK_EQ(mock_pwm_value(LEFT_MOTOR_FORWARD), 0);
+  CHECK_EQ(mock_pwm_value(RIGHT_MOTOR_FORWARD), 255);
+  CHECK_EQ(mock_digital_level(LEFT_MOTOR_ENABLE), HIGH);
+
+  ZKBM1Motors::init();
+  ZKBM1Motors::write<STEER>(120);
+  CHECK_EQ(mock_pwm_value(STEER_PWM_IN3), 120);
+  CHECK_EQ(mock_pwm_value(STEER_PWM_IN4), 0);
+
+  TB6612Motors::init();
+  TB6612Motors::write<3>(-100);
+  CHECK_EQ(mock_pwm_value(R_PWMB), 100);
+  CHECK_EQ(mock_digital_level(R_BIN1), LOW);
+  CHECK_EQ(mock_digital_level(R_BIN2), HIGH);
+  CHECK_EQ(mock_digital_level(R_STBY), HIGH);
+
+  // Each keeps its own output cache
+  CHECK_EQ(TB6612Motors::applied[3], -100);
+  CHECK_EQ(L298Motors::applied[RIGHT], 255);
+}
+
+#ifdef ARDUINO_HC89_COUNTER
+/* Pulses count in the direction the motor on their side was given */
+void testCounterHearsCommandedDirection() {
+  CHECK_STR(command("r"), "OK");
+  CHECK_STR(command("o -100 -100"), "OK");
+  for (int i = 0; i < 3; i++) mock_fire_interrupt(digitalPinToInterrupt(DRIVE_ENC_PIN));
+  mock_fire_interrupt(digitalPinToInterrupt(STEER_ENC_PIN));
+  CHECK_EQ(readEncoder(DRIVE), -3);
+
+  // The ZKBM1's right speed drives nothing, so the steering counter
+  // keeps its direction; a two-sided driver reverses it as well
+  CHECK_EQ(readEncoder(STEER), MotorDriver::RIGHT_SIDE ? -1 : 1);
+  CHECK_STR(command("o 0 0"), "OK");
+}
+#endif
+
+void testOutOfRangeEncoderIndex() {
+  CHECK_EQ(readEncoder(-1), 0);
+  CHECK_EQ(readEncoder(ENCODER_SNAPSHOT_SIZE), 0);
+  resetEncoder(7);
+  setEncoderDirection(7, -1);
+  CHECK_EQ(getEncoderCount(), ENCODER_CHANNELS);
+}
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testSidesFollowMasks);
+  RUN_TEST(testWheelsFollowChannels);
+  RUN_TEST(testEveryDriverOnItsPins);
+  #ifdef ARDUINO_HC89_COUNTER
+    RUN_TEST(testCounterHearsCommandedDirection);
+  #endif
+  RUN_TEST(testOutOfRangeEncoderIndex);
+#endif
+  return testResult();
+}
@@ -0,0 +1,117 @@
+/* *************************************************************
+   Host tests for the encoder drivers: emulated pin-change and
+   external interrupts are counted and reported by 'e', and the
+   control tick's snapshot is what telemetry reports
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+#ifdef ARDUINO_ENC_COUNTER
+/* Quadrature Gray sequence on two adjacent input bits */
+static const uint8_t QUADRATURE[4] = { 0, 1, 3, 2 };
+
+static void stepLeft(int steps) {
+  static int phase = 0;
+  for (int i = 0; i < abs(steps); i++) {
+    phase = (phase + (steps > 0 ? 1 : 3)) & 3;
+    mock_set_pind((PIND & ~(3 << LEFT_ENC_PIN_A)) | (QUADRATURE[phase] << LEFT_ENC_PIN_A));
+  }
+}
+
+static void stepRight(int steps) {
+  static int phase = 0;
+  for (int i = 0; i < abs(steps); i++) {
+    phase = (phase + (steps > 0 ? 1 : 3)) & 3;
+    mock_set_pinc((PINC & ~(3 << RIGHT_ENC_PIN_A)) | (QUADRATURE[phase] << RIGHT_ENC_PIN_A));
+  }
+}
+
+void testQuadratureCounting() {
+  CHECK_STR(command("e"), "0 0");
+  stepLeft(40);
+  stepRight(-12);
+  CHECK_EQ(labs(readEncoder(LEFT)), 40);
+  CHECK_EQ(labs(readEncoder(RIGHT)), 12);
+  CHECK(readEncoder(LEFT) * readEncoder(RIGHT) < 0);
+
+  // Turning back returns to zero
+  stepLeft(-40);
+  CHECK_EQ(readEncoder(LEFT), 0);
+
+  CHECK_STR(command("r"), "OK");
+  CHECK_STR(command("e"), "0 0");
+}
+
+void testCountsWhileInterruptsMasked() {
+  // An edge during a critical section is delivered on sei()
+  cli();
+  stepLeft(1);
+  CHECK_EQ(readEncoder(LEFT), 0);
+  sei();
+  CHECK_EQ(labs(readEncoder(LEFT)), 1);
+}
+
+void testTelemetryReportsTickSnapshot() {
+  CHECK_STR(command("r"), "OK");
+  CHECK_STR(command("g 1 1"), "OK");
+  runFor(PID_INTERVAL - 7);
+  mock_serial_take_output();
+
+  // The tick latches the counts; the wheel moves before loop() runs
+  // the telemetry task
+  mock_advance_micros(1000);
+  stepLeft(5);
+  loop();
+  CHECK_STR(mock_serial_take_output(), "T " + std::to_string(PID_INTERVAL * 1000UL) + " 0 0\r\n");
+
+  EncoderSnapshot now;
+  snapshotEncoders(&now);
+  CHECK(now.count[LEFT] != 0);
+  CHECK_EQ(now.micros, PID_INTERVAL * 1000UL);
+}
+#endif
+
+#ifdef ARDUINO_HC89_COUNTER
+void testPulseCounting() {
+  for (int i = 0; i < 25; i++) mock_fire_interrupt(digitalPinToInterrupt(DRIVE_ENC_PIN));
+  for (int i = 0; i < 7; i++) mock_fire_interrupt(digitalPinToInterrupt(STEER_ENC_PIN));
+  CHECK_STR(command("e"), "25 7");
+
+  // The direction comes from the commanded motor direction
+  CHECK_STR(command("y 0 -1"), "OK");
+  for (int i = 0; i < 5; i++) mock_fire_interrupt(digitalPinToInterrupt(DRIVE_ENC_PIN));
+  CHECK_STR(command("e"), "20 7");
+
+  CHECK_STR(command("r"), "OK");
+  CHECK_STR(command("e"), "0 0");
+}
+#endif
+
+#ifdef NO_ENCODERS
+void testNoEncoders() {
+  CHECK(!encodersAvailable());
+  CHECK_STR(command("e"), "0 0");
+  CHECK_STR(command("r"), "OK");
+}
+#endif
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  #ifdef ARDUINO_ENC_COUNTER
+    RUN_TEST(testQuadratureCounting);
+    RUN_TEST(testCountsWhileInterruptsMasked);
+    RUN_TEST(testTelemetryReportsTickSnapshot);
+  #endif
+  #ifdef ARDUINO_HC89_COUNTER
+    RUN_TEST(testPulseCounting);
+  #endif
+  #ifdef NO_ENCODERS
+    RUN_TEST(testNoEncoders);
+  #endif
+#endif
+  return testResult();
+}
@@ -0,0 +1,116 @@
+/* *************************************************************
+   Host tests for MECANUM_TWIST: the precomputed inverse kinematics
+   against the floating-point equations, the wheel sign patterns,
+   rebuilding on a parameter change, the velocity limits and the
+   auto-stop
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_MECANUM
+
+/* The wheel targets of the last twist, Q8 ticks per frame */
+static void wheelTargets(long *targetQ8) {
+  #ifdef NO_ENCODERS
+    // Open loop: PWM in proportion to the target
+    long fullScale = lround(wheelSpeedToTicksPerFrame(mecanumParams.maxLinearVel) * PID_ONE);
+    for (int i = 0; i < 4; i++) targetQ8[i] = (long)currentMecanumSpeeds[i] * fullScale / MAX_PWM;
+  #else
+    for (int i = 0; i < 4; i++) targetQ8[i] = wheelPID.targetQ8[i];
+  #endif
+}
+
+/* The kinematics in double precision, m/s and rad/s in */
+static double referenceTicks(int wheel, double vx, double vy, double wz) {
+  static const double sign[4][3] = { { 1, -1, -1 }, { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 } };
+  const MecanumParams &p = mecanumParams;
+  double rim = sign[wheel][0] * vx + sign[wheel][1] * vy + sign[wheel][2] * wz * (p.wheelBase + p.trackWidth) / 2;
+  return rim / (2 * M_PI * p.wheelRadius) * p.ticksPerRev / PID_RATE;
+}
+
+#ifdef NO_ENCODERS
+/* PWM rounding: one PWM step of the full scale */
+#define TOLERANCE_Q8 (lround(wheelSpeedToTicksPerFrame(mecanumParams.maxLinearVel) * PID_ONE) / MAX_PWM + 2)
+#else
+#define TOLERANCE_Q8 2
+#endif
+
+void testTwistMatchesKinematics() {
+  const long twists[][3] = { { 300, -150, 500 }, { -420, 80, -1200 }, { 0, 0, 1500 }, { 5, 0, 0 } };
+  for (const long *t : twists) {
+    CHECK_STR(command("n " + std::to_string(t[0]) + " " + std::to_string(t[1]) + " " + std::to_string(t[2])), "OK");
+    long target[4];
+    wheelTargets(target);
+    for (int i = 0; i < 4; i++) {
+      double expected = referenceTicks(i, t[0] / 1000.0, t[1] / 1000.0, t[2] / 1000.0) * PID_ONE;
+      CHECK(fabs(target[i] - expected) <= TOLERANCE_Q8);
+    }
+  }
+}
+
+void testWheelSignPatterns() {
+  long target[4];
+
+  CHECK_STR(command("n 200 0 0"), "OK");
+  wheelTargets(target);
+  for (int i = 0; i < 4; i++) CHECK(target[i] > 0 && target[i] == target[0]);
+
+  // Strafe left: FL and RR backwards, FR and RL forwards
+  CHECK_STR(command("n 0 200 0"), "OK");
+  wheelTargets(target);
+  CHECK(target[0] < 0 && target[1] > 0 && target[2] > 0 && target[3] < 0);
+
+  // Turn counter-clockwise: left side backwards, right side forwards
+  CHECK_STR(command("n 0 0 500"), "OK");
+  wheelTargets(target);
+  CHECK(target[0] < 0 && target[1] > 0 && target[2] < 0 && target[3] > 0);
+}
+
+void testParamsChangeRebuildsMatrix() {
+  CHECK_STR(command("n 400 0 0"), "OK");
+  long before[4];
+  wheelTargets(before);
+
+  // Twice the wheel radius: half the revolutions for the same speed
+  mecanumParams.wheelRadius *= 2;
+  mecanumUpdateKinematics();
+  CHECK_STR(command("n 400 0 0"), "OK");
+  long after[4];
+  wheelTargets(after);
+  CHECK(labs(after[0] * 2 - before[0]) <= 2 * TOLERANCE_Q8);
+  initMecanumParams();
+}
+
+void testTwistLimited() {
+  CHECK_STR(command("n 1000 0 2000"), "OK");
+  long limited[4];
+  wheelTargets(limited);
+  CHECK_STR(command("n 30000 0 30000"), "OK");
+  long target[4];
+  wheelTargets(target);
+  for (int i = 0; i < 4; i++) CHECK_EQ(target[i], limited[i]);
+}
+
+void testAutoStopEndsTwist() {
+  CHECK_STR(command("n 300 0 0"), "OK");
+  CHECK_EQ(mecanumMoving, 1);
+  runFor(AUTO_STOP_INTERVAL + AUTO_STOP_CHECK_INTERVAL + PID_INTERVAL);
+  CHECK_EQ(mecanumMoving, 0);
+  for (int i = 0; i < 4; i++) CHECK_EQ(MotorDriver::applied[i], 0);
+
+  CHECK_STR(command("n 0 0 0"), "OK");
+  CHECK_EQ(mecanumMoving, 0);
+}
+
+#endif // USE_MECANUM
+
+int main() {
+#ifdef USE_MECANUM
+  RUN_TEST(testTwistMatchesKinematics);
+  RUN_TEST(testWheelSignPatterns);
+  RUN_TEST(testParamsChangeRebuildsMatrix);
+  RUN_TEST(testTwistLimited);
+  RUN_TEST(testAutoStopEndsTwist);
+#endif
+  return testResult();
+}
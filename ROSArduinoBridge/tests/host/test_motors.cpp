@@ -0,0 +1,154 @@
+/* *************************************************************
+   Host tests for the motor outputs: raw PWM commands reach the
+   driver pins, unchanged speeds are not written again, and the
+   auto-stop timeout releases them
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+#ifdef SPARKFUN_TB6612
+  /* PWM pin of each wheel's TB6612 channel */
+  #define FL_PWM L_PWMA
+  #define RL_PWM L_PWMB
+  #define FR_PWM R_PWMA
+  #define RR_PWM R_PWMB
+#endif
+
+#if defined(SPARKFUN_TB6612) || defined(ZKBM1_MOTOR_DRIVER)
+  // FL on the TB6612 and the ZKBM1 drive motor both use pin 5 (OCR0B)
+  #define LEFT_PWM 5
+  #define LEFT_OCR OCR0B
+  #define LEFT_COM (TCCR0A & (1 << COM0B1))
+#elif defined(L298_MOTOR_DRIVER)
+  #define LEFT_PWM LEFT_MOTOR_FORWARD
+  #define LEFT_OCR OCR1B
+  #define LEFT_COM (TCCR1A & (1 << COM1B1))
+#endif
+
+/* Forward output of the first left motor, wherever the driver puts it */
+static int leftOutput() {
+  #ifdef LEFT_PWM
+    return mock_pwm_value(LEFT_PWM);
+  #else
+    return MotorDriver::shield.m1Speed;
+  #endif
+}
+
+void testRawPwm() {
+  #if defined(SPARKFUN_TB6612) && defined(USE_MECANUM)
+    CHECK_STR(command("o 100 -120 140 -160"), "OK");
+    CHECK_EQ(mock_pwm_value(FL_PWM), 100);
+    CHECK_EQ(mock_pwm_value(FR_PWM), 120);
+    CHECK_EQ(mock_pwm_value(RL_PWM), 140);
+    CHECK_EQ(mock_pwm_value(RR_PWM), 160);
+    CHECK_EQ(mock_digital_level(L_AIN1), HIGH);
+    CHECK_EQ(mock_digital_level(L_AIN2), LOW);
+    CHECK_EQ(mock_digital_level(R_AIN1), LOW);
+    CHECK_EQ(mock_digital_level(R_AIN2), HIGH);
+  #elif defined(SPARKFUN_TB6612)
+    CHECK_STR(command("o 100 -120"), "OK");
+    CHECK_EQ(mock_pwm_value(FL_PWM), 100);
+    CHECK_EQ(mock_pwm_value(RL_PWM), 100);
+    CHECK_EQ(mock_pwm_value(FR_PWM), 120);
+    CHECK_EQ(mock_pwm_value(RR_PWM), 120);
+    CHECK_EQ(mock_digital_level(R_BIN2), HIGH);
+  #elif defined(ZKBM1_MOTOR_DRIVER)
+    CHECK_STR(command("o -100 0"), "OK");
+    CHECK_EQ(mock_pwm_value(DRIVE_PWM_IN1), 0);
+    CHECK_EQ(mock_pwm_value(DRIVE_PWM_IN2), 100);
+  #elif defined(L298_MOTOR_DRIVER)
+    CHECK_STR(command("o 100 -120"), "OK");
+    CHECK_EQ(mock_pwm_value(LEFT_MOTOR_FORWARD), 100);
+    CHECK_EQ(mock_pwm_value(LEFT_MOTOR_BACKWARD), 0);
+    CHECK_EQ(mock_pwm_value(RIGHT_MOTOR_FORWARD), 0);
+    CHECK_EQ(mock_pwm_value(RIGHT_MOTOR_BACKWARD), 120);
+  #else
+    CHECK_STR(command("o 100 -120"), "OK");
+    CHECK(MotorDriver::shield.initialized);
+    CHECK_EQ(MotorDriver::shield.m1Speed, 100);
+    CHECK_EQ(MotorDriver::shield.m2Speed, -120);
+  #endif
+}
+
+#ifdef SPARKFUN_TB6612
+void testDeadzone() {
+  // Small commands are raised to the deadzone, zero brakes
+  #ifdef USE_MECANUM
+    CHECK_STR(command("o 5 0 0 0"), "OK");
+  #else
+    CHECK_STR(command("o 5 0"), "OK");
+  #endif
+  CHECK_EQ(mock_pwm_value(FL_PWM), MOTOR_DEADZONE);
+  CHECK_EQ(mock_pwm_value(FR_PWM), 0);
+  CHECK_EQ(mock_digital_level(R_AIN1), LOW);
+  CHECK_EQ(mock_digital_level(R_AIN2), LOW);
+}
+#endif
+
+/* A raw PWM line with the same speed on every motor */
+static std::string rawPwm(int speed) {
+  std::string s = std::to_string(speed);
+  #ifdef USE_MECANUM
+    return command("o " + s + " " + s + " " + s + " " + s);
+  #else
+    return command("o " + s + " " + s);
+  #endif
+}
+
+void testUnchangedSpeedNotRewritten() {
+  CHECK_STR(rawPwm(100), "OK");
+  CHECK_EQ(leftOutput(), 100);
+
+  // Repeating the speed leaves the registers alone
+  #ifdef LEFT_PWM
+    LEFT_OCR = 7;
+  #else
+    MotorDriver::shield.m1Speed = 7;
+  #endif
+  CHECK_STR(rawPwm(100), "OK");
+  CHECK_EQ(leftOutput(), 7);
+
+  // After a raw pin command the next speed is written in full
+  CHECK_STR(command("w 13 1"), "OK");
+  CHECK_STR(rawPwm(100), "OK");
+  CHECK_EQ(leftOutput(), 100);
+
+  // Full scale is a plain high level, as with analogWrite()
+  CHECK_STR(rawPwm(255), "OK");
+  CHECK_EQ(leftOutput(), 255);
+  #ifdef LEFT_PWM
+    CHECK_EQ(LEFT_COM, 0);
+  #endif
+  CHECK_STR(rawPwm(0), "OK");
+  CHECK_EQ(leftOutput(), 0);
+}
+
+void testAutoStop() {
+  #ifdef USE_MECANUM
+    CHECK_STR(command("o 100 100 100 100"), "OK");
+  #else
+    CHECK_STR(command("o 100 0"), "OK");
+  #endif
+  CHECK_EQ(leftOutput(), 100);
+
+  runFor(AUTO_STOP_INTERVAL - 100);
+  CHECK_EQ(leftOutput(), 100);
+  runFor(200);
+  CHECK_EQ(leftOutput(), 0);
+}
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testRawPwm);
+  #ifdef SPARKFUN_TB6612
+    RUN_TEST(testDeadzone);
+  #endif
+  RUN_TEST(testUnchangedSpeedNotRewritten);
+  RUN_TEST(testAutoStop);
+#endif
+  return testResult();
+}
@@ -0,0 +1,115 @@
+/* *************************************************************
+   Host tests for the odometry: straight lines, turns in place and
+   arcs against the exact solution, the sin table against sin(),
+   and the pose through READ_ODOMETRY and telemetry
+   ************************************************************ */
+
+#include "host_test.h"
+
+#if defined(USE_BASE) && defined(USE_ODOMETRY)
+
+#include <cmath>
+
+/* mm per tick and the distance between the wheel sides that turns
+   a left/right difference into rotation */
+#ifdef USE_MECANUM
+static const double MM_PER_TICK = 2 * M_PI * DEFAULT_WHEEL_RADIUS * 1000 / DEFAULT_TICKS_PER_REV;
+static const double TRACK_MM = (DEFAULT_WHEEL_BASE + DEFAULT_TRACK_WIDTH) * 1000;
+#else
+static const double MM_PER_TICK = 1000.0 / ODOM_TICKS_PER_METER;
+static const double TRACK_MM = ODOM_TRACK_WIDTH * 1000;
+#endif
+
+/* Run ticks control ticks, each moving the wheels by left/right */
+static void drive(long left, long right, int ticks) {
+  for (int i = 0; i < ticks; i++) {
+    addEncoderTicks(left, right);
+    controlTick();
+  }
+}
+
+static double poseX() { return odomPose.x / 256.0; }
+static double poseY() { return odomPose.y / 256.0; }
+static double poseTheta() { return (int32_t)odomPose.theta * (2 * M_PI / 4294967296.0); }
+
+void testStraightLine() {
+  drive(10, 10, 20);
+  CHECK(fabs(poseX() - 200 * MM_PER_TICK) < 0.5);
+  CHECK_EQ(odomPose.y, 0);
+  CHECK_EQ(odomPose.theta, 0U);
+
+  drive(-4, -4, 25);
+  CHECK(fabs(poseX() - 100 * MM_PER_TICK) < 0.5);
+}
+
+void testTurnInPlace() {
+  // A quarter turn counter-clockwise, then past half a turn
+  long ticks = lround(M_PI / 2 * TRACK_MM / 2 / MM_PER_TICK / 10);
+  drive(-10, 10, ticks);
+  double expected = 20.0 * ticks * MM_PER_TICK / TRACK_MM;
+  CHECK(fabs(poseTheta() - expected) < 0.001);
+  CHECK_EQ(odomPose.x, 0);
+  CHECK_EQ(odomPose.y, 0);
+
+  drive(-10, 10, 2 * ticks);
+  CHECK(fabs(poseTheta() - (3 * expected - 2 * M_PI)) < 0.002);
+  CHECK(odomMilliradians(odomPose.theta) < 0);
+}
+
+void testArcMatchesExact() {
+  const long left = 8, right = 12;
+  const int ticks = 90;
+  drive(left, right, ticks);
+
+  double theta = (right - left) * ticks * MM_PER_TICK / TRACK_MM;
+  double radius = TRACK_MM / 2 * (left + right) / (right - left);
+  CHECK(fabs(poseTheta() - theta) < 0.001);
+  CHECK(fabs(poseX() - radius * sin(theta)) < 1.0);
+  CHECK(fabs(poseY() - radius * (1 - cos(theta))) < 1.0);
+}
+
+void testSinTable() {
+  int worst = 0;
+  for (uint32_t a = 0; a < 4096; a++) {
+    uint32_t angle = a << 20 | a;  // odd fractions too
+    long exact = lround(sin(angle * (2 * M_PI / 4294967296.0)) * 32767);
+    worst = std::max(worst, (int)labs(odomSin(angle) - exact));
+  }
+  CHECK(worst <= 2);
+}
+
+void testReadAndZero() {
+  drive(10, 10, 10);
+  std::string pose = std::to_string(lround(100 * MM_PER_TICK)) + " 0 0";
+  CHECK_STR(command("i"), pose);
+
+  // Resetting the encoders does not move the pose
+  CHECK_STR(command("r"), "OK");
+  controlTick();
+  CHECK_STR(command("i 1"), pose);
+  CHECK_STR(command("i"), "0 0 0");
+}
+
+void testTelemetryPose() {
+  drive(10, 10, 10);
+  CHECK_STR(command("g 128 1"), "OK");
+  runFor(PID_INTERVAL);
+  std::string sample = mock_serial_take_output();
+  std::string pose = " " + std::to_string(lround(100 * MM_PER_TICK)) + " 0 0\r\n";
+  CHECK(sample.size() > pose.size());
+  CHECK_STR(sample.substr(sample.size() - pose.size()), pose);
+}
+
+#endif // USE_BASE && USE_ODOMETRY
+
+int main() {
+#if defined(USE_BASE) && defined(USE_ODOMETRY)
+  RUN_TEST(testStraightLine);
+  RUN_TEST(testTurnInPlace);
+  RUN_TEST(testArcMatchesExact);
+  RUN_TEST(testSinTable);
+  RUN_TEST(testReadAndZero);
+  RUN_TEST(testTelemetryPose);
+#endif
+  return testResult();
+}
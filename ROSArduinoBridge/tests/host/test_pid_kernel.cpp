@@ -0,0 +1,190 @@
+/* *************************************************************
+   Host tests for the fixed-point PID kernel: the reciprocal
+   division, complete PID runs against the former double/long
+   implementation of doPID(), and ticks shorter than a frame
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+static uint32_t rngState = 12345;
+
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+static long rngRange(long lo, long hi) {
+  return lo + (long)(rng() % (uint32_t)(hi - lo + 1));
+}
+
+/* The PID step as it was before the kernel (double target, long
+   division by Ko) */
+struct ReferencePID {
+  double TargetTicksPerFrame;
+  int PrevInput;
+  int ITerm;
+  long output;
+};
+
+static void referenceStep(ReferencePID *p, int input, int kp, int kd, int ki, int ko) {
+  long Perror = p->TargetTicksPerFrame - input;
+  long output = (kp * Perror - kd * (input - p->PrevInput) + p->ITerm) / ko;
+  output += p->output;
+  if (output >= MAX_PWM)
+    output = MAX_PWM;
+  else if (output <= -MAX_PWM)
+    output = -MAX_PWM;
+  else
+    p->ITerm += ki * Perror;
+  p->output = output;
+  p->PrevInput = input;
+}
+
+void testDivideMatchesTruncation() {
+  PIDGains g;
+  memset(&g, 0, sizeof(g));
+  long mismatches = 0;
+  for (int ko = 1; ko <= 32767; ko += (ko < 300 ? 1 : 37)) {
+    pidSetGains(&g, 0, 0, 0, ko);
+    long limit = g.scale.limit;
+    CHECK_EQ(limit, (2L * MAX_PWM + 1) * ko);
+
+    // Both ends of the range and every quotient boundary near them,
+    // then random numerators in between
+    for (long q = 0; q <= 2 * MAX_PWM + 1; q++) {
+      for (long d = -1; d <= 1; d++) {
+        long n = q * ko + d;
+        if (n < 0 || n > limit) continue;
+        mismatches += pidDivide(n, &g.scale) != n / ko;
+        mismatches += pidDivide(-n, &g.scale) != -n / ko;
+      }
+    }
+    for (int i = 0; i < 200; i++) {
+      long n = rngRange(-limit, limit);
+      mismatches += pidDivide(n, &g.scale) != n / ko;
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+}
+
+void testPowerOfTwoUsesShift() {
+  PIDGains g;
+  memset(&g, 0, sizeof(g));
+  pidSetGains(&g, 0, 0, 0, 64);
+  CHECK_EQ(g.scale.shift, 6);
+  pidSetGains(&g, 0, 0, 0, 50);
+  CHECK_EQ(g.scale.shift, PID_NO_SHIFT);
+  // Ko below 1 would divide by zero; it is clamped
+  pidSetGains(&g, 0, 0, 0, 0);
+  CHECK_EQ(g.scale.divisor, 1);
+}
+
+/* Drive kernel and reference with the same random encoder deltas,
+   targets and gain changes; every output and ITerm must agree */
+void testStepMatchesReference() {
+  PIDGains g;
+  memset(&g, 0, sizeof(g));
+  long mismatches = 0;
+  long saturated = 0;
+
+  for (int run = 0; run < 2000; run++) {
+    int kp = rngRange(0, 200), kd = rngRange(0, 100), ki = rngRange(0, 20);
+    int ko = (run & 1) ? (1 << rngRange(0, 10)) : rngRange(1, 2000);
+    pidSetGains(&g, kp, kd, ki, ko);
+
+    ReferencePID ref = { 0, 0, 0, 0 };
+    long targetQ8 = 0;
+    long prevInput = 0, iTerm = 0, carry = 0;
+    long output = 0;
+
+    for (int tick = 0; tick < 200; tick++) {
+      if (rng() % 16 == 0) {
+        long target = rngRange(-400, 400);
+        ref.TargetTicksPerFrame = target;
+        targetQ8 = pidTicksToQ8(target);
+      }
+      int input = pidTicks(targetQ8) + rngRange(-60, 60);
+
+      referenceStep(&ref, input, kp, kd, ki, ko);
+      output = pidStep(targetQ8, pidTicksToQ8(input), &prevInput, &iTerm, &carry, output, &g);
+
+      mismatches += output != ref.output || iTerm != pidTicksToQ8(ref.ITerm) ||
+                    prevInput != pidTicksToQ8(ref.PrevInput);
+      saturated += output == MAX_PWM || output == -MAX_PWM;
+    }
+  }
+  CHECK_EQ(mismatches, 0);
+  // Make sure the saturation path was exercised as well
+  CHECK(saturated > 1000);
+}
+
+/* Fractional targets were never produced by the integer commands;
+   against a double target a step from the same state may differ
+   by the fraction of the error the reference truncated and the
+   kernel keeps, i.e. one tick of error */
+void testFractionalTargetsWithinTolerance() {
+  PIDGains g;
+  memset(&g, 0, sizeof(g));
+  const int kp = 20, kd = 12, ki = 1, ko = 50;
+  pidSetGains(&g, kp, kd, ki, ko);
+  long worst = 0;
+
+  for (int run = 0; run < 500; run++) {
+    double target = rngRange(-80000, 80000) / 1000.0;
+    long targetQ8 = (long)(target * PID_ONE);
+    long prevInput = 0, iTerm = 0, carry = 0;
+    long output = 0;
+    for (int tick = 0; tick < 50; tick++) {
+      int input = (int)target + rngRange(-3, 3);
+      ReferencePID ref = { target, (int)pidTicks(prevInput), (int)pidTicks(iTerm), output };
+      referenceStep(&ref, input, kp, kd, ki, ko);
+      output = pidStep(targetQ8, pidTicksToQ8(input), &prevInput, &iTerm, &carry, output, &g);
+      worst = max(worst, labs(output - ref.output));
+    }
+  }
+  CHECK(worst <= kp / ko + 1);
+}
+
+void testShortTicksAddUpToAFrame() {
+  // 1 ms ticks: a frame is PID_INTERVAL of them
+  pidTickStep = PID_STEP_ONE / PID_INTERVAL;
+
+  int mismatches = 0;
+  for (int run = 0; run < 1000; run++) {
+    long v = rngRange(-2000000000L, 2000000000L);
+    long expected = (long)((long long)v * pidTickStep / PID_STEP_ONE);
+    mismatches += pidPerTick(v) != expected;
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // A constant error adds the increment of one reference tick over
+  // a frame's worth of short ticks, whatever is below one PWM step
+  PIDGains g;
+  memset(&g, 0, sizeof(g));
+  pidSetGains(&g, 20, 12, 0, 50);
+  long prevInput = pidTicksToQ8(5), iTerm = 0, carry = 0;
+  long output = 0;
+  for (int tick = 0; tick < PID_INTERVAL; tick++) {
+    output = pidStep(pidTicksToQ8(30), pidTicksToQ8(5), &prevInput, &iTerm, &carry, output, &g);
+  }
+  CHECK(output == 20 * 25 / 50 || output == 20 * 25 / 50 - 1);
+
+  pidTickStep = PID_STEP_ONE;
+}
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testDivideMatchesTruncation);
+  RUN_TEST(testPowerOfTwoUsesShift);
+  RUN_TEST(testStepMatchesReference);
+  RUN_TEST(testFractionalTargetsWithinTolerance);
+  RUN_TEST(testShortTicksAddUpToAFrame);
+#endif
+  return testResult();
+}
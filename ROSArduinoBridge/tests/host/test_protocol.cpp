@@ -0,0 +1,142 @@
+/* *************************************************************
+   Host tests for the serial protocol: ASCII parsing and replies,
+   ';' batches, binary frames and the RX ring buffer
+   ************************************************************ */
+
+#include "host_test.h"
+
+void testAsciiReplies() {
+  CHECK_STR(command("b"), "115200");
+  CHECK_STR(command("Z"), "Invalid Command");
+
+  mock_set_analog_input(A3, 512);
+  CHECK_STR(command("a 3"), "512");
+  CHECK_STR(command("w 13 1"), "OK");
+  CHECK_EQ(mock_digital_level(13), HIGH);
+
+  // Spaces and colons both separate arguments, stray LFs are ignored
+  CHECK_STR(command("w:13:0\n"), "OK");
+  CHECK_EQ(mock_digital_level(13), LOW);
+}
+
+void testAsciiBadArguments() {
+  CHECK_STR(command("w 13 -"), "Invalid Argument");
+  CHECK_STR(command("w 13x 1"), "Invalid Argument");
+  CHECK_STR(command("w 99999999999 1"), "Invalid Argument");
+  CHECK_STR(command("w 1 2 3 4 5 6 7 8 9"), "Invalid Argument");
+  // The parser recovers at the next CR
+  CHECK_STR(command("b"), "115200");
+}
+
+void testBatch() {
+  mock_set_analog_input(A3, 300);
+  mock_set_analog_input(A2, 200);
+  CHECK_STR(command("a 3;b;a 2"), "300;115200;200");
+  CHECK_STR(command("a 3;Z;a 2"), "300;Invalid Command;200");
+
+  // Empty commands are skipped
+  CHECK_STR(command(";a 3;"), "300");
+
+  // One malformed command rejects the batch before anything runs
+  int level = mock_digital_level(13);
+  CHECK_STR(command(std::string("w 13 ") + (level ? "0" : "1") + ";a 3 -"), "Invalid Argument");
+  CHECK_EQ(mock_digital_level(13), level);
+
+  // Too many commands
+  CHECK_STR(command("b;b;b;b;b;b;b;b;b"), "Invalid Argument");
+  CHECK_STR(command("b;b;b;b;b;b;b;b"), "115200;115200;115200;115200;115200;115200;115200;115200");
+}
+
+#ifdef USE_BINARY_PROTOCOL
+void testBinaryCommands() {
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame('b', 7, std::vector<uint8_t>())));
+  CHECK_EQ(reply.size(), 7);
+  if (reply.size() == 7) {
+    CHECK_EQ(reply[0], 'b');
+    CHECK_EQ(reply[1], 7);
+    CHECK_EQ(reply[2], BIN_STATUS_OK);
+    CHECK_EQ(reply[3] | (reply[4] << 8) | ((long)reply[5] << 16) | ((long)reply[6] << 24), 115200);
+  }
+
+  reply = decodeFrame(transact(binaryFrame('Z', 8, std::vector<uint8_t>())));
+  CHECK_EQ(reply.size(), 3);
+  if (reply.size() == 3) CHECK_EQ(reply[2], BIN_STATUS_BAD_COMMAND);
+
+  std::vector<uint8_t> tooLong(3, 1);
+  reply = decodeFrame(transact(binaryFrame('a', 9, tooLong)));
+  CHECK_EQ(reply.size(), 3);
+  if (reply.size() == 3) CHECK_EQ(reply[2], BIN_STATUS_BAD_LENGTH);
+
+  // Frames with a bad CRC are dropped and counted
+  std::string bad = binaryFrame('b', 10, std::vector<uint8_t>());
+  bad[3] ^= 0x01;
+  unsigned int errors = binFrameErrors;
+  CHECK_STR(transact(bad), "");
+  CHECK_EQ(binFrameErrors, errors + 1);
+
+  // ASCII keeps working next to binary frames
+  CHECK_STR(command("b"), "115200");
+}
+
+void testBinaryBatch() {
+  mock_set_analog_input(A3, 300);
+  std::vector<uint8_t> payload;
+  payload.push_back('a');
+  payload.push_back(3);
+  payload.push_back('w');
+  payload.push_back(13);
+  payload.push_back(1);
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame(BATCH_SEPARATOR, 11, payload)));
+
+  // ';' 11 OK | 'a' OK 2 <300> | 'w' OK 0
+  CHECK_EQ(reply.size(), 3 + 5 + 3);
+  if (reply.size() == 11) {
+    CHECK_EQ(reply[0], BATCH_SEPARATOR);
+    CHECK_EQ(reply[2], BIN_STATUS_OK);
+    CHECK_EQ(reply[3], 'a');
+    CHECK_EQ(reply[5], 2);
+    CHECK_EQ(reply[6] | (reply[7] << 8), 300);
+    CHECK_EQ(reply[8], 'w');
+    CHECK_EQ(reply[10], 0);
+  }
+  CHECK_EQ(mock_digital_level(13), HIGH);
+
+  // A truncated command rejects the whole frame
+  payload.pop_back();
+  reply = decodeFrame(transact(binaryFrame(BATCH_SEPARATOR, 12, payload)));
+  CHECK_EQ(reply.size(), 3);
+  if (reply.size() == 3) CHECK_EQ(reply[2], BIN_STATUS_BAD_LENGTH);
+}
+#endif
+
+void testRxRing() {
+  // The timer ISR keeps draining the 64-byte core buffer while the
+  // loop is busy, so a burst far larger than it survives
+  std::string burst;
+  for (int i = 0; i < 40; i++) burst += "b\r";
+  size_t accepted = 0;
+  for (size_t pos = 0; pos < burst.size(); pos += 20) {
+    accepted += mock_serial_feed(burst.substr(pos, 20));
+    mock_advance_micros(2000);
+  }
+  CHECK_EQ(accepted, burst.size());
+  CHECK_EQ(rxRingFull, 0);
+
+  runFor(2);
+  std::string out = mock_serial_take_output();
+  size_t lines = 0;
+  for (size_t i = 0; i < out.size(); i++) lines += out[i] == '\n';
+  CHECK_EQ(lines, 40);
+}
+
+int main() {
+  RUN_TEST(testAsciiReplies);
+  RUN_TEST(testAsciiBadArguments);
+  RUN_TEST(testBatch);
+#ifdef USE_BINARY_PROTOCOL
+  RUN_TEST(testBinaryCommands);
+  RUN_TEST(testBinaryBatch);
+#endif
+  RUN_TEST(testRxRing);
+  return testResult();
+}
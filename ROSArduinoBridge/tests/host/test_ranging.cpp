@@ -0,0 +1,107 @@
+/* *************************************************************
+   Host tests for the ranging engine: 'p' answers at once from the
+   cache, echoes are timed by the pin-change interrupt, sensors
+   take turns, and a missing echo times out
+   ************************************************************ */
+
+#include "host_test.h"
+
+/* Pins 8-13 are usable in every configuration */
+#define FRONT_PIN 13
+#define REAR_PIN  12
+
+/* Run until the engine triggers a sensor; true if it was this pin */
+static bool waitForTrigger(uint8_t pin) {
+  for (int ms = 0; ms < 100; ms++) {
+    runFor(1);
+    if (PCMSK0 & digitalPinToBitMask(pin)) return true;
+  }
+  return false;
+}
+
+/* The sensor answers: echo starts after 750 us and lasts widthUs */
+static void echo(uint8_t pin, unsigned long widthUs) {
+  mock_advance_micros(750);
+  mock_set_digital_input(pin, HIGH);
+  mock_advance_micros(widthUs);
+  mock_set_digital_input(pin, LOW);
+}
+
+void testReplyIsImmediate() {
+  CHECK_STR(command("p 13"), "0 -1");
+
+  // Nothing after the reply until an echo arrives: loop() never waits
+  unsigned long before = micros();
+  mock_serial_feed("p 13\r");
+  loop();
+  CHECK_EQ(micros(), before);
+  CHECK_STR(mock_serial_take_output(), "0 -1\r\n");
+}
+
+void testEchoIsTimedByInterrupt() {
+  CHECK_STR(command("p 13"), "0 -1");
+  CHECK(waitForTrigger(FRONT_PIN));
+  CHECK_EQ(mock_pin_mode(FRONT_PIN), INPUT);
+
+  // 5800 us out and back: 100 cm
+  echo(FRONT_PIN, 5800);
+  runFor(RANGER_INTERVAL);
+  runFor(20);
+  CHECK_STR(command("p 13").substr(0, 4), "100 ");
+
+  long range, age;
+  CHECK(rangerLatest(FRONT_PIN, &range, &age));
+  CHECK(age >= 20 && age <= 20 + 3 + RANGER_INTERVAL);
+}
+
+void testSensorsTakeTurns() {
+  CHECK_STR(command("p 13"), "0 -1");
+  CHECK_STR(command("p 12"), "0 -1");
+
+  CHECK(waitForTrigger(FRONT_PIN));
+  CHECK(!(PCMSK0 & digitalPinToBitMask(REAR_PIN)));
+  echo(FRONT_PIN, 2900);
+  CHECK(waitForTrigger(REAR_PIN));
+  CHECK(!(PCMSK0 & digitalPinToBitMask(FRONT_PIN)));
+  echo(REAR_PIN, 11600);
+  runFor(RANGER_INTERVAL);
+
+  long range, age;
+  CHECK(rangerLatest(FRONT_PIN, &range, &age));
+  CHECK_EQ(range, 50);
+  CHECK(rangerLatest(REAR_PIN, &range, &age));
+  CHECK_EQ(range, 200);
+}
+
+void testMissingEchoTimesOut() {
+  CHECK_STR(command("p 13"), "0 -1");
+  CHECK(waitForTrigger(FRONT_PIN));
+  runFor(RANGER_TIMEOUT_US / 1000 + RANGER_INTERVAL);
+
+  long range, age;
+  CHECK(rangerLatest(FRONT_PIN, &range, &age));
+  // Measured, without an echo
+  CHECK_EQ(range, 0);
+  CHECK(age != RANGER_AGE_NONE);
+}
+
+void testUnusablePins() {
+  // More sensors than slots
+  for (uint8_t pin = 8; pin < 8 + RANGER_SENSORS; pin++) {
+    long range, age;
+    CHECK(rangerLatest(pin, &range, &age));
+  }
+  CHECK_STR(command("p 13"), "Invalid Argument");
+  // A6/A7 have no pin-change interrupt
+  initRanging();
+  CHECK_STR(command("p 20"), "Invalid Argument");
+}
+
+int main() {
+  RUN_TEST(testReplyIsImmediate);
+  RUN_TEST(testEchoIsTimedByInterrupt);
+  RUN_TEST(testSensorsTakeTurns);
+  RUN_TEST(testMissingEchoTimesOut);
+  RUN_TEST(testUnusablePins);
+  return testResult();
+}
@@ -0,0 +1,225 @@
+/* *************************************************************
+   Host tests for the flight recorder: a record per control tick
+   in a wrapping ring, the freeze on a fault (an auto-stop of a
+   moving base, a control overrun, the host), and the binary dump
+   arriving as whole frames, oldest record first
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_RECORDER
+
+#include <string.h>
+
+/* Field n of an ASCII reply */
+static long field(const std::string &reply, int n) {
+  size_t at = 0;
+  for (int i = 0; i < n; i++) at = reply.find(' ', at) + 1;
+  return atol(reply.c_str() + at);
+}
+
+/* The commanded speed as recorded: the target, or without encoders
+   the PWM it was driven with */
+static int recordedSpeed(const RecorderEntry &e) {
+  #ifdef NO_ENCODERS
+    return e.output[0];
+  #else
+    return e.target[0];
+  #endif
+}
+
+/* Every frame in the output, decoded without its CRC */
+static std::vector<std::vector<uint8_t> > decodeFrames(const std::string &bytes) {
+  std::vector<std::vector<uint8_t> > frames;
+  size_t start = bytes.find('\0');
+  while (start != std::string::npos) {
+    size_t end = bytes.find('\0', start + 1);
+    if (end == std::string::npos) break;
+    if (end > start + 1) frames.push_back(decodeFrame(bytes.substr(start, end - start + 1)));
+    start = end;
+  }
+  return frames;
+}
+
+#ifdef USE_MECANUM
+  #define DRIVE_COMMAND MECANUM_TWIST
+#else
+  #define DRIVE_COMMAND MOTOR_SPEEDS
+#endif
+
+static void drive() {
+  #ifdef USE_MECANUM
+    CHECK_STR(command("n 100 0 0"), "OK");
+  #else
+    CHECK_STR(command("m 10"), "OK");
+  #endif
+}
+
+void testRecordsEveryTick() {
+  CHECK_STR(command("l 0"), "0 0 0");
+  runFor(PID_INTERVAL * 5);
+  std::string state = command("l 0");
+  CHECK_EQ(field(state, 0), field(state, 2));
+  CHECK_EQ(field(state, 1), RECORDER_RECORDING);
+  CHECK(field(state, 2) >= 5);
+
+  drive();
+  runFor(PID_INTERVAL);
+  const RecorderEntry &last = recorderRing[(recorderHead - 1) & RECORDER_MASK];
+  CHECK_EQ(last.tick, recorderTicks);
+  CHECK(recordedSpeed(last) != 0);
+  CHECK_EQ(last.command, DRIVE_COMMAND);
+  CHECK_EQ(last.period, PID_INTERVAL);
+}
+
+void testLateTickMeasured() {
+  runFor(PID_INTERVAL * 3);
+  // Interrupts held off for 20 ms: the timer ticks in between are
+  // lost and the next control tick comes that much later
+  cli();
+  mock_advance_micros(20000);
+  sei();
+  runFor(PID_INTERVAL * 2);
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_RECORDING);
+
+  uint8_t n = recorderHead;
+  const RecorderEntry &onTime = recorderRing[(n - 3) & RECORDER_MASK];
+  const RecorderEntry &late = recorderRing[(n - 2) & RECORDER_MASK];
+  const RecorderEntry &after = recorderRing[(n - 1) & RECORDER_MASK];
+  CHECK_EQ(onTime.period, PID_INTERVAL);
+  CHECK(late.period >= PID_INTERVAL + 15);
+  CHECK_EQ(after.period, PID_INTERVAL);
+}
+
+void testRingWraps() {
+  runFor(PID_INTERVAL * (RECORDER_RECORDS + 5));
+  CHECK_EQ(field(command("l 0"), 0), RECORDER_RECORDS);
+  const RecorderEntry &oldest = recorderRing[recorderHead];
+  const RecorderEntry &newest = recorderRing[(recorderHead - 1) & RECORDER_MASK];
+  CHECK_EQ((uint16_t)(newest.tick - oldest.tick), RECORDER_RECORDS - 1);
+}
+
+#ifndef NO_ENCODERS
+void testEncoderDeltas() {
+  runFor(PID_INTERVAL * 2);
+  addEncoderTicks(7, -3);
+  runFor(PID_INTERVAL);
+  const RecorderEntry &last = recorderRing[(recorderHead - 1) & RECORDER_MASK];
+  CHECK_EQ(labs(last.delta[0]) + labs(last.delta[1]), 10);
+  runFor(PID_INTERVAL);
+  const RecorderEntry &next = recorderRing[(recorderHead - 1) & RECORDER_MASK];
+  CHECK_EQ(next.delta[0], 0);
+  CHECK_EQ(next.delta[1], 0);
+}
+#endif
+
+void testAutoStopAtRestIsNoFault() {
+  runFor(AUTO_STOP_INTERVAL + 500);
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_RECORDING);
+}
+
+void testAutoStopWhileMovingFreezes() {
+  drive();
+  runFor(AUTO_STOP_INTERVAL + 500);
+  std::string state = command("l 0");
+  CHECK_EQ(field(state, 1), RECORDER_AUTO_STOP);
+  CHECK_EQ(field(state, 0), RECORDER_RECORDS);
+
+  // Frozen: the newest record is the last tick before the stop
+  uint16_t newest = recorderRing[(recorderHead - 1) & RECORDER_MASK].tick;
+  runFor(PID_INTERVAL * 5);
+  CHECK_EQ(recorderRing[(recorderHead - 1) & RECORDER_MASK].tick, newest);
+  CHECK(recorderTicks >= newest + 5);
+
+  CHECK_STR(command("l 2"), "OK");
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_RECORDING);
+  CHECK(field(command("l 0"), 0) <= 1);
+  runFor(PID_INTERVAL * 3);
+  CHECK(field(command("l 0"), 0) >= 3);
+}
+
+void testOverrunFreezes() {
+  runFor(PID_INTERVAL * 3);
+  // The control tick is still running when the next one comes due
+  schedBusy = true;
+  schedState[TASK_CONTROL].due = true;
+  runFor(PID_INTERVAL * 2);
+  schedBusy = false;
+  runFor(PID_INTERVAL);
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_OVERRUN);
+}
+
+void testBadArguments() {
+  CHECK_STR(command("l 3"), "Invalid Argument");
+  CHECK_STR(command("l -1"), "Invalid Argument");
+  // The dump is binary only, and asking for it freezes nothing
+  CHECK_STR(command("l 1"), "Invalid Argument");
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_RECORDING);
+}
+
+void testBinaryDump() {
+  drive();
+  runFor(PID_INTERVAL * (RECORDER_RECORDS + 3));
+  uint16_t newest = recorderRing[(recorderHead - 1) & RECORDER_MASK].tick;
+  unsigned long dropped = txDropped;
+
+  std::vector<uint8_t> payload(1, RECORDER_DUMP);
+  mock_serial_feed(binaryFrame(RECORDER, 6, payload));
+  runFor(300);
+  std::vector<std::vector<uint8_t> > frames = decodeFrames(mock_serial_take_output());
+  CHECK_EQ(txDropped, dropped);
+  CHECK_EQ(field(command("l 0"), 1), RECORDER_HOST);
+
+  CHECK(frames.size() >= 2);
+  if (frames.size() < 2) return;
+  CHECK_EQ(frames[0].size(), 3U + 4);
+  CHECK_EQ(frames[0][0], RECORDER);
+  CHECK_EQ(frames[0][1], 6);
+  CHECK_EQ(frames[0][3], RECORDER_RECORDS);
+
+  std::vector<RecorderEntry> records;
+  for (size_t f = 1; f < frames.size(); f++) {
+    CHECK_EQ(frames[f][0], RECORDER_FRAME);
+    CHECK_EQ(frames[f][1], f - 1);
+    CHECK_EQ(frames[f][2], BIN_STATUS_OK);
+    CHECK_EQ((frames[f].size() - 3) % sizeof(RecorderEntry), 0U);
+    for (size_t at = 3; at + sizeof(RecorderEntry) <= frames[f].size(); at += sizeof(RecorderEntry)) {
+      RecorderEntry e;
+      memcpy(&e, &frames[f][at], sizeof(e));
+      records.push_back(e);
+    }
+  }
+  CHECK_EQ(records.size(), RECORDER_RECORDS);
+  for (size_t i = 0; i < records.size(); i++) {
+    CHECK_EQ(records[i].tick, (uint16_t)(newest - (RECORDER_RECORDS - 1) + i));
+    CHECK(recordedSpeed(records[i]) != 0);
+    CHECK_EQ(records[i].command, DRIVE_COMMAND);
+  }
+}
+
+#else
+
+void testCompiledOut() {
+  CHECK_STR(command("l 0"), "Invalid Command");
+}
+
+#endif // USE_RECORDER
+
+int main() {
+#ifdef USE_RECORDER
+  RUN_TEST(testRecordsEveryTick);
+  RUN_TEST(testLateTickMeasured);
+  RUN_TEST(testRingWraps);
+  #ifndef NO_ENCODERS
+    RUN_TEST(testEncoderDeltas);
+  #endif
+  RUN_TEST(testAutoStopAtRestIsNoFault);
+  RUN_TEST(testAutoStopWhileMovingFreezes);
+  RUN_TEST(testOverrunFreezes);
+  RUN_TEST(testBadArguments);
+  RUN_TEST(testBinaryDump);
+#else
+  RUN_TEST(testCompiledOut);
+#endif
+  return testResult();
+}
@@ -0,0 +1,48 @@
+/* *************************************************************
+   Host tests for the task scheduler: the control tick keeps its
+   period while loop() is blocked, missed loop-task releases are
+   counted, and the time base survives a clock wrap
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+void testControlTickWhileLoopBlocked() {
+  runFor(PID_INTERVAL * 3);
+  CHECK_EQ(schedulerRuns(TASK_CONTROL), 3);
+  CHECK_EQ(schedulerRuns(TASK_TELEMETRY), 3);
+
+  // loop() stays busy for 200 ms: only interrupts run meanwhile
+  mock_advance_micros(200000UL);
+  runFor(3);
+
+  unsigned int runs = schedulerRuns(TASK_CONTROL);
+  CHECK_EQ(runs, (PID_INTERVAL * 3 + 200 + 3) / PID_INTERVAL);
+  CHECK_EQ(schedulerOverruns(TASK_CONTROL), 0);
+  // Every release happened exactly on its tick
+  CHECK_EQ(schedulerReleaseTime(TASK_CONTROL), runs * PID_INTERVAL * 1000UL);
+
+  // Telemetry runs from loop(), so the blocked releases were missed
+  CHECK(schedulerOverruns(TASK_TELEMETRY) >= 200 / PID_INTERVAL - 1);
+  CHECK_EQ(schedulerRuns(TASK_TELEMETRY) + schedulerOverruns(TASK_TELEMETRY), runs);
+}
+
+void testTimeBaseWraps() {
+  // millis() and micros() wrap half a second from now
+  mock_set_micros(0xFFFFFFFFUL - 500000UL);
+  unsigned int before = schedulerRuns(TASK_CONTROL);
+  runFor(PID_INTERVAL * 30);
+  CHECK_EQ(schedulerRuns(TASK_CONTROL) - before, 30);
+  CHECK_EQ(schedulerOverruns(TASK_CONTROL), 0);
+}
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testControlTickWhileLoopBlocked);
+  RUN_TEST(testTimeBaseWraps);
+#endif
+  return testResult();
+}
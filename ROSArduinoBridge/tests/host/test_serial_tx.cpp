@@ -0,0 +1,105 @@
+/* *************************************************************
+   Host tests for the transmit queue: numbers format like
+   Serial.print(), a full TX path drops whole replies instead of
+   stalling loop(), and quiet mode leaves out the motion acks
+   ************************************************************ */
+
+#include "host_test.h"
+
+static std::string formatted(unsigned long value) {
+  char out[11];
+  return std::string(out, txFormatUnsigned(value, out));
+}
+
+void testFormatMatchesPrint() {
+  const unsigned long values[] = {
+    0, 7, 10, 99, 100, 65535, 1000000000UL, 1999999999UL, 4294967295UL,
+  };
+  for (unsigned long v : values) CHECK_STR(formatted(v), std::to_string(v));
+  for (unsigned long v = 1; v < 4000000000UL; v = v * 7 + 3) {
+    CHECK_STR(formatted(v), std::to_string(v));
+  }
+}
+
+#ifdef USE_BASE
+
+#ifdef USE_MECANUM
+  #define WHEEL_ARGS " 0 0 0 0"
+#else
+  #define WHEEL_ARGS " 0 0"
+#endif
+
+#ifndef NO_ENCODERS
+void testFullBufferDropsWholeReplies() {
+  // 97-byte replies: the core buffer and the ring take two of them
+  resetEncoders();
+  addEncoderTicks(-1234567890L, 1234567890L);
+  const std::string reply = command("e;e;e;e") + "\r\n";
+  unsigned int dropped = txDropped;
+
+  mock_serial_set_tx_pacing(true);
+  mock_serial_feed("e;e;e;e\re;e;e;e\re;e;e;e\re;e;e;e\re;e;e;e\re;e;e;e\r");
+  loop();
+  CHECK_EQ(mock_serial_tx_stall_micros(), 0U);
+  unsigned int lost = txDropped - dropped;
+  CHECK(lost > 0);
+  CHECK(lost < 6);
+
+  // What was kept arrives in full once the line has drained
+  runFor(200);
+  std::string out = mock_serial_take_output();
+  CHECK_EQ(out.size(), (6 - lost) * reply.size());
+  for (size_t at = 0; at + reply.size() <= out.size(); at += reply.size()) {
+    CHECK_STR(out.substr(at, reply.size()), reply);
+  }
+  CHECK_EQ(mock_serial_tx_stall_micros(), 0U);
+  mock_serial_set_tx_pacing(false);
+}
+#endif
+
+void testQuietMode() {
+  CHECK_STR(command("h 1"), std::to_string(txDropped));
+  CHECK_STR(transact("o" WHEEL_ARGS "\r"), "");
+  CHECK_STR(transact("m 0\r"), "");
+  CHECK_STR(command("o" WHEEL_ARGS ";a 0;o" WHEEL_ARGS), ";0;");
+  // Errors and everything else are still answered
+  CHECK_STR(command("h 2"), "Invalid Argument");
+  CHECK_STR(command("u 1 2 3 4"), "OK");
+
+  CHECK_STR(command("h 0"), std::to_string(txDropped));
+  CHECK_STR(command("m 0"), "OK");
+}
+
+#ifdef USE_BINARY_PROTOCOL
+void testQuietBinary() {
+  CHECK_STR(command("h 1"), std::to_string(txDropped));
+  std::vector<uint8_t> payload;
+  putInt16(payload, 0);
+  putInt16(payload, 0);
+  #ifdef USE_MECANUM
+    putInt16(payload, 0);
+    putInt16(payload, 0);
+  #endif
+  CHECK_STR(transact(binaryFrame(MOTOR_RAW_PWM, 9, payload)), "");
+  CHECK_STR(command("h 0"), std::to_string(txDropped));
+
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame(MOTOR_RAW_PWM, 10, payload)));
+  CHECK_EQ(reply.size(), 3U);  // opcode seq status
+}
+#endif
+
+#endif // USE_BASE
+
+int main() {
+  RUN_TEST(testFormatMatchesPrint);
+#ifdef USE_BASE
+  #ifndef NO_ENCODERS
+    RUN_TEST(testFullBufferDropsWholeReplies);
+  #endif
+  RUN_TEST(testQuietMode);
+  #ifdef USE_BINARY_PROTOCOL
+    RUN_TEST(testQuietBinary);
+  #endif
+#endif
+  return testResult();
+}
@@ -0,0 +1,143 @@
+/* *************************************************************
+   Host tests for the setpoint queue: points are reached on their
+   tick, the target ramps between them within MOTOR_SLEW_RATE, a
+   dry queue holds the last point, and direct commands take over
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+#ifdef USE_MECANUM
+  #define WHEEL_ARGS(v) " " #v " " #v " " #v " " #v
+#else
+  #define WHEEL_ARGS(v) " " #v " " #v
+#endif
+
+/* The target the control tick applied to the first wheel, Q8 */
+static long applied() {
+  #if defined(USE_MECANUM) && defined(NO_ENCODERS)
+    return pidTicksToQ8(currentMecanumSpeeds[0]);
+  #elif defined(USE_MECANUM)
+    return wheelPID.targetQ8[0];
+  #elif defined(NO_ENCODERS)
+    return pidTicksToQ8(drivePID.output[0]);
+  #else
+    return drivePID.targetQ8[0];
+  #endif
+}
+
+static bool isMoving() {
+  #ifdef USE_MECANUM
+    return mecanumMoving;
+  #else
+    return moving;
+  #endif
+}
+
+/* Firmware state outlives a test: start each from a stop */
+static void stop() {
+  CHECK_STR(command("o" WHEEL_ARGS(0)), "OK");
+  controlTick();
+}
+
+void testPointReachedOnItsTick() {
+  stop();
+  CHECK_STR(command("q 4" WHEEL_ARGS(20)), "1");
+  long last = applied();
+  for (int tick = 1; tick < 4; tick++) {
+    controlTick();
+    CHECK(applied() > last);
+    CHECK(applied() < pidTicksToQ8(20));
+    last = applied();
+  }
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(20));
+  CHECK_EQ(setpointPending(), 0);
+
+  // A dry queue holds the last point
+  for (int tick = 0; tick < 5; tick++) controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(20));
+  CHECK(isMoving());
+}
+
+void testSlewLimit() {
+  stop();
+  CHECK_STR(command("q 1" WHEEL_ARGS(40)), "1");
+  for (int tick = 1; tick <= 5; tick++) {
+    controlTick();
+    CHECK_EQ(applied(), pidTicksToQ8(MOTOR_SLEW_RATE * tick));
+  }
+
+  // Back to a stop: the stream ends itself
+  CHECK_STR(command("q 1" WHEEL_ARGS(0)), "1");
+  for (int tick = 0; tick < 5; tick++) controlTick();
+  CHECK_EQ(applied(), 0);
+  CHECK(!isMoving());
+}
+
+void testPointsFollowEachOther() {
+  stop();
+  // 8, 16, 24 ticks per frame, one point per tick after a delay
+  CHECK_STR(command("q 3" WHEEL_ARGS(8)), "1");
+  CHECK_STR(command("q 1" WHEEL_ARGS(16)), "2");
+  CHECK_STR(command("q 1" WHEEL_ARGS(24)), "3");
+  controlTick();
+  controlTick();
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(8));
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(16));
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(24));
+}
+
+void testDryQueueCountsFromNow() {
+  stop();
+  CHECK_STR(command("q 1" WHEEL_ARGS(4)), "1");
+  CHECK_STR(command("q 1" WHEEL_ARGS(6)), "2");
+  controlTick();
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(6));
+
+  // The queue ran dry: the next point counts from now
+  for (int tick = 0; tick < 10; tick++) controlTick();
+  CHECK_STR(command("q 2" WHEEL_ARGS(8)), "1");
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(7));
+  controlTick();
+  CHECK_EQ(applied(), pidTicksToQ8(8));
+}
+
+void testFullQueueAndBadDelay() {
+  stop();
+  for (int i = 1; i <= SETPOINT_QUEUE_SIZE; i++) {
+    CHECK_STR(command("q 10" WHEEL_ARGS(5)), std::to_string(i));
+  }
+  CHECK_STR(command("q 10" WHEEL_ARGS(5)), "Invalid Argument");
+  CHECK_STR(command("q 0" WHEEL_ARGS(5)), "Invalid Argument");
+  CHECK_STR(command("q 256" WHEEL_ARGS(5)), "Invalid Argument");
+}
+
+void testDirectCommandTakesOver() {
+  CHECK_STR(command("q 2" WHEEL_ARGS(30)), "1");
+  CHECK_STR(command("o" WHEEL_ARGS(0)), "OK");
+  CHECK_EQ(setpointPending(), 0);
+  for (int tick = 0; tick < 5; tick++) controlTick();
+  CHECK_EQ(applied(), 0);
+  CHECK(!isMoving());
+}
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testPointReachedOnItsTick);
+  RUN_TEST(testSlewLimit);
+  RUN_TEST(testPointsFollowEachOther);
+  RUN_TEST(testDryQueueCountsFromNow);
+  RUN_TEST(testFullQueueAndBadDelay);
+  RUN_TEST(testDirectCommandTakesOver);
+#endif
+  return testResult();
+}
@@ -0,0 +1,124 @@
+/* *************************************************************
+   Host tests for the loop-stage statistics: the summary and the
+   histogram of a stage, read-and-reset, the overrun and overflow
+   counters, and the command staying unknown without USE_STATS
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_STATS
+
+static long field(const std::string &reply, int index) {
+  size_t at = 0;
+  for (int i = 0; i < index; i++) at = reply.find(' ', at) + 1;
+  return atol(reply.c_str() + at);
+}
+
+void testSummaryAndHistogram() {
+  statsReset();
+  statsRecord(STATS_SERVOS, 10);
+  statsRecord(STATS_SERVOS, 20);
+  statsRecord(STATS_SERVOS, 600);
+  statsRecord(STATS_SERVOS, 100000);  // saturates at 65535
+  // count min max mean, then < 16 < 32 ... < 1024 and the rest
+  CHECK_STR(command("v 4"), "4 10 65535 25157 1 1 0 0 0 0 1 1");
+  CHECK_STR(command("v 4 1"), "4 10 65535 25157 1 1 0 0 0 0 1 1");
+  CHECK_STR(command("v 4"), "0 0 0 0 0 0 0 0 0 0 0 0");
+}
+
+void testStagesCount() {
+  command("v 0 1");
+  runFor(200);
+  std::string parse = command("v 0");
+  CHECK(field(parse, 0) >= 200);
+  CHECK_EQ(field(parse, 0), field(parse, 4) + field(parse, 5) + field(parse, 6) + field(parse, 7) +
+                            field(parse, 8) + field(parse, 9) + field(parse, 10) + field(parse, 11));
+  // Every command so far, this one included once it has replied
+  CHECK(field(command("v 1"), 0) >= 2);
+  #ifdef USE_BASE
+    CHECK(field(command("v 2"), 0) >= 200 / PID_INTERVAL);
+  #endif
+
+  // A read with reset starts the next interval from zero
+  command("v 0 1");
+  CHECK(field(command("v 0"), 0) < 10);
+}
+
+#if defined(USE_BASE) && !defined(NO_ENCODERS)
+void testMotorStage() {
+  command("v 3 1");
+  // The wheel PIDs only write the motors while moving
+  #ifdef USE_MECANUM
+    command("n 100 0 0");
+  #else
+    command("m 10");
+  #endif
+  runFor(10 * PID_INTERVAL);
+  CHECK(field(command("v 3"), 0) >= 8);
+  #ifdef USE_MECANUM
+    command("o 0 0 0 0");
+  #else
+    command("m 0");
+  #endif
+}
+#endif
+
+void testCounters() {
+  command("v 5 1");
+  CHECK_STR(command("v 5"), "0 0");
+
+  // Fill the core buffer faster than loop() drains the ring
+  for (int i = 0; i < 4; i++) {
+    mock_serial_feed(std::string(60, ' '));
+    mock_advance_micros(2000);
+  }
+  runFor(10);
+  mock_serial_take_output();
+  std::string counters = command("v 5");
+  CHECK_EQ(field(counters, 0), 0);
+  CHECK(field(counters, 1) > 0);
+  command("v 5 1");
+  CHECK_STR(command("v 5"), "0 0");
+}
+
+void testBadArguments() {
+  CHECK_STR(command("v 6"), "Invalid Argument");
+  CHECK_STR(command("v -1"), "Invalid Argument");
+  CHECK_STR(command("v 0 2"), "Invalid Argument");
+}
+
+#ifdef USE_BINARY_PROTOCOL
+void testBinary() {
+  std::vector<uint8_t> payload;
+  payload.push_back(STATS_PARSE);
+  payload.push_back(0);
+  std::vector<uint8_t> reply = decodeFrame(transact(binaryFrame(LOOP_STATS, 5, payload)));
+  CHECK_EQ(reply.size(), 3U + 4 * (4 + STATS_BUCKETS));
+}
+#endif
+
+#else
+
+void testCompiledOut() {
+  CHECK_STR(command("v 0"), "Invalid Command");
+}
+
+#endif // USE_STATS
+
+int main() {
+#ifdef USE_STATS
+  RUN_TEST(testSummaryAndHistogram);
+  RUN_TEST(testStagesCount);
+  #if defined(USE_BASE) && !defined(NO_ENCODERS)
+    RUN_TEST(testMotorStage);
+  #endif
+  RUN_TEST(testCounters);
+  RUN_TEST(testBadArguments);
+  #ifdef USE_BINARY_PROTOCOL
+    RUN_TEST(testBinary);
+  #endif
+#else
+  RUN_TEST(testCompiledOut);
+#endif
+  return testResult();
+}
@@ -0,0 +1,168 @@
+/* *************************************************************
+   Host tests for the steering position controller: a simulated
+   steering motor with inertia follows the PWM, and the controller
+   has to bring it to its target within the trajectory limits,
+   without overshoot, against disturbances and through a stall,
+   at the reference rate and above
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef HAS_STEERING_SUPPORT
+
+#include <algorithm>
+#include <cmath>
+
+/* The steering motor: counts per frame at full PWM and the share of
+   the speed difference it catches up per frame */
+static const double PLANT_GAIN = 20.0 / 255;
+static const double PLANT_INERTIA = 0.3;
+
+static double plantPosition;
+static double plantSpeed;
+static bool plantStalled;
+
+static void startPlant() {
+  CHECK_STR(command("r"), "OK");
+  plantPosition = 0;
+  plantSpeed = 0;
+  plantStalled = false;
+}
+
+/* One control tick, then the motor moves for one tick's worth */
+static void plantTick() {
+  controlTick();
+  double tick = (double)controlPeriod / PID_INTERVAL;
+  double want = plantStalled ? 0 : PLANT_GAIN * ZKBM1Motors::applied[STEER];
+  plantSpeed += (want - plantSpeed) * (1 - pow(1 - PLANT_INERTIA, tick));
+  if (plantStalled) plantSpeed = 0;
+  long before = lround(plantPosition);
+  plantPosition += plantSpeed * tick;
+  addEncoderTicks(0, lround(plantPosition) - before);
+}
+
+void testReachesTargetWithoutOvershoot() {
+  startPlant();
+  CHECK_STR(command("f 200"), "OK");
+  CHECK_EQ(steering.target, pidTicksToQ8(200));
+
+  long highest = 0;
+  long prevSpeed = 0;
+  bool withinLimits = true;
+  for (int i = 0; i < 10 * PID_RATE; i++) {
+    plantTick();
+    highest = std::max(highest, readEncoder(STEER));
+    if (labs(steering.speed) > steering.maxSpeed) withinLimits = false;
+    // Only the last step, landing on the target, may stop sharper
+    bool landed = steering.speed == 0 && steering.reference == steering.target;
+    if (!landed && labs(steering.speed - prevSpeed) > steering.tickAccel) withinLimits = false;
+    prevSpeed = steering.speed;
+  }
+  CHECK(withinLimits);
+  CHECK(highest <= 200 + STEER_TOLERANCE);
+  CHECK(labs(readEncoder(STEER) - 200) <= STEER_TOLERANCE);
+
+  // At rest on the target the motor is released
+  CHECK_EQ(steering.reference, steering.target);
+  CHECK_EQ(ZKBM1Motors::applied[STEER], 0);
+}
+
+void testTrajectoryTakesItsTime() {
+  startPlant();
+  CHECK_STR(command("f 300"), "OK");
+
+  // Half way through the fastest possible move it is not there yet
+  const long seconds = (long)300 / STEER_MAX_SPEED + STEER_MAX_SPEED / STEER_MAX_ACCEL;
+  for (int i = 0; i < seconds * PID_RATE / 2; i++) plantTick();
+  CHECK(readEncoder(STEER) < 300 - STEER_TOLERANCE);
+  CHECK(readEncoder(STEER) > 0);
+
+  for (int i = 0; i < 5 * PID_RATE; i++) plantTick();
+  CHECK(labs(readEncoder(STEER) - 300) <= STEER_TOLERANCE);
+}
+
+void testDisturbanceIsCorrected() {
+  startPlant();
+  CHECK_STR(command("f 100"), "OK");
+  for (int i = 0; i < 5 * PID_RATE; i++) plantTick();
+  CHECK(labs(readEncoder(STEER) - 100) <= STEER_TOLERANCE);
+
+  // Knocked away, it comes back without another 'f'
+  plantPosition -= 30;
+  addEncoderTicks(0, -30);
+  for (int i = 0; i < 5 * PID_RATE; i++) plantTick();
+  CHECK(labs(readEncoder(STEER) - 100) <= STEER_TOLERANCE);
+}
+
+void testStallDoesNotWindUp() {
+  startPlant();
+  plantStalled = true;
+  CHECK_STR(command("f -400"), "OK");
+  for (int i = 0; i < 3 * PID_RATE; i++) plantTick();
+
+  // Full power, the reference waiting close to the motor and
+  // nothing integrated
+  CHECK_EQ(ZKBM1Motors::applied[STEER], -STEER_MAX_PWM);
+  CHECK(steering.reference >= -pidTicksToQ8(STEER_MAX_LAG));
+  CHECK_EQ(steering.iTerm, 0);
+
+  // Free again, it arrives without overshooting
+  plantStalled = false;
+  long lowest = 0;
+  for (int i = 0; i < 10 * PID_RATE; i++) {
+    plantTick();
+    lowest = std::min(lowest, readEncoder(STEER));
+  }
+  CHECK(lowest >= -400 - STEER_TOLERANCE);
+  CHECK(labs(readEncoder(STEER) + 400) <= STEER_TOLERANCE);
+}
+
+void testSameMoveAtAHigherRate() {
+  CHECK_STR(command("z 500"), "500");
+  startPlant();
+  CHECK_STR(command("f 300"), "OK");
+
+  // The same limits per frame, so about the same time to get there
+  const int ticksPerSecond = 1000 / controlPeriod;
+  const long seconds = (long)300 / STEER_MAX_SPEED + STEER_MAX_SPEED / STEER_MAX_ACCEL;
+  long highest = 0;
+  for (int i = 0; i < seconds * ticksPerSecond / 2; i++) plantTick();
+  CHECK(readEncoder(STEER) < 300 - STEER_TOLERANCE);
+  CHECK(readEncoder(STEER) > 0);
+
+  for (int i = 0; i < 5 * ticksPerSecond; i++) {
+    plantTick();
+    highest = std::max(highest, readEncoder(STEER));
+  }
+  CHECK(highest <= 300 + STEER_TOLERANCE);
+  CHECK(labs(readEncoder(STEER) - 300) <= STEER_TOLERANCE);
+  CHECK_EQ(ZKBM1Motors::applied[STEER], 0);
+}
+
+void testResetReleasesTheMotor() {
+  startPlant();
+  CHECK_STR(command("f 150"), "OK");
+  for (int i = 0; i < 5; i++) plantTick();
+  CHECK(ZKBM1Motors::applied[STEER] != 0);
+
+  CHECK_STR(command("r"), "OK");
+  CHECK_EQ(steering.target, 0);
+  CHECK_EQ(steering.speed, 0);
+  CHECK_EQ(ZKBM1Motors::applied[STEER], 0);
+  controlTick();
+  CHECK_EQ(ZKBM1Motors::applied[STEER], 0);
+}
+
+#endif // HAS_STEERING_SUPPORT
+
+int main() {
+#ifdef HAS_STEERING_SUPPORT
+  RUN_TEST(testReachesTargetWithoutOvershoot);
+  RUN_TEST(testTrajectoryTakesItsTime);
+  RUN_TEST(testDisturbanceIsCorrected);
+  RUN_TEST(testStallDoesNotWindUp);
+  RUN_TEST(testSameMoveAtAHigherRate);
+  RUN_TEST(testResetReleasesTheMotor);
+#endif
+  return testResult();
+}
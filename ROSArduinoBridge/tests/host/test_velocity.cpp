@@ -0,0 +1,129 @@
+/* *************************************************************
+   Host tests for the M/T velocity estimate: fractional speeds from
+   edge times, decay when the edges stop, a start after a
+   standstill, the optional filter, and
+   the controller feeding the estimate to the PID
+   ************************************************************ */
+
+#include "host_test.h"
+
+#ifdef USE_BASE
+
+static const unsigned long FRAME_US = PID_INTERVAL * 1000UL;
+
+/* A wheel with an edge every periodUs, latched every frame; returns
+   the estimate after the given number of frames */
+static long estimateSteadySpeed(unsigned long periodUs, int frames) {
+  unsigned long prevEdge = 0;
+  long estimate = 0;
+  long prevCount = 0;
+  for (int f = 1; f <= frames; f++) {
+    unsigned long now = f * FRAME_US;
+    long count = now / periodUs;
+    unsigned long edge = count * periodUs;
+    estimate = velocityEstimate(count - prevCount, edge, now, &prevEdge, estimate);
+    prevCount = count;
+  }
+  return estimate;
+}
+
+void testFractionalSpeed() {
+  // 2.538 ticks per frame: counting alone sees 2 or 3
+  long expected = (long)(FRAME_US * PID_ONE / 13000UL);
+  CHECK(labs(estimateSteadySpeed(13000UL, 30) - expected) <= 2);
+
+  // Below one tick per frame: most frames count nothing
+  expected = (long)(FRAME_US * PID_ONE / 90000UL);
+  CHECK(labs(estimateSteadySpeed(90000UL, 30) - expected) <= PID_ONE / 8);
+}
+
+void testFastSpeedIsTheCount() {
+  unsigned long prevEdge = 0;
+  long estimate = velocityEstimate(VELOCITY_MT_COUNTS, FRAME_US - 400, FRAME_US, &prevEdge, 0);
+  CHECK_EQ(estimate, pidTicksToQ8(VELOCITY_MT_COUNTS));
+  CHECK_EQ(prevEdge, FRAME_US - 400);
+
+  // Negative counts give the mirrored estimate
+  prevEdge = 0;
+  long forward = velocityEstimate(5, FRAME_US - 400, FRAME_US, &prevEdge, 0);
+  prevEdge = 0;
+  CHECK_EQ(velocityEstimate(-5, FRAME_US - 400, FRAME_US, &prevEdge, 0), -forward);
+}
+
+void testStoppedWheelDecays() {
+  unsigned long prevEdge = 10 * FRAME_US;
+  long estimate = pidTicksToQ8(-4);
+  for (int f = 11; f <= 60; f++) {
+    long next = velocityEstimate(0, prevEdge, f * FRAME_US, &prevEdge, estimate);
+    CHECK(labs(next) <= labs(estimate));
+    // Never faster than one tick since the last edge
+    CHECK(labs(next) <= (long)(FRAME_US * PID_ONE / ((f - 10) * FRAME_US)));
+    estimate = next;
+  }
+  CHECK(estimate <= 0 && estimate > -PID_ONE / 32);
+}
+
+void testStartFromRest() {
+  // Last edge three seconds ago, estimate decayed to almost zero
+  unsigned long prevEdge = 0;
+  unsigned long now = 3000000UL;
+  long estimate = velocityEstimate(2, now - 5000, now, &prevEdge, 1);
+  // The count of the tick, not two edges over three seconds
+  CHECK_EQ(estimate, pidTicksToQ8(2));
+  CHECK_EQ(prevEdge, now - 5000);
+
+  // From the next tick on the edge window applies again
+  estimate = velocityEstimate(3, now + FRAME_US - 2000, now + FRAME_US, &prevEdge, estimate);
+  CHECK_EQ(estimate, (long)(3 * FRAME_US * PID_ONE / (FRAME_US + 3000)));
+}
+
+#ifdef ARDUINO_ENC_COUNTER
+
+#ifdef USE_MECANUM
+#define CONTROLLER wheelPID
+#else
+#define CONTROLLER drivePID
+#endif
+
+/* One quadrature step forward on the LEFT encoder */
+static void stepLeft() {
+  static const uint8_t QUADRATURE[4] = { 0, 1, 3, 2 };
+  static int phase = 0;
+  phase = (phase + 1) & 3;
+  mock_set_pind((PIND & ~(3 << LEFT_ENC_PIN_A)) | (QUADRATURE[phase] << LEFT_ENC_PIN_A));
+}
+
+void testControllerUsesEdgeTimes() {
+  #ifdef USE_MECANUM
+    lastMotorCommand = millis();
+    setMecanumTargetSpeeds(3, 3, 3, 3);
+  #else
+    CHECK_STR(command("m 3"), "OK");
+  #endif
+
+  // An edge every 13 ms for ten frames
+  for (int ms = 1; ms <= PID_INTERVAL * 10; ms++) {
+    runFor(1);
+    if (ms % 13 == 0) stepLeft();
+  }
+  // Counting alone would give 2 or 3 ticks
+  long expected = (long)(FRAME_US * PID_ONE / 13000UL);
+  CHECK(labs(labs(CONTROLLER.prevInput[0]) - expected) <= 8);
+}
+
+#endif // ARDUINO_ENC_COUNTER
+
+#endif // USE_BASE
+
+int main() {
+#ifdef USE_BASE
+  RUN_TEST(testFractionalSpeed);
+  RUN_TEST(testFastSpeedIsTheCount);
+  RUN_TEST(testStoppedWheelDecays);
+  RUN_TEST(testStartFromRest);
+  #ifdef ARDUINO_ENC_COUNTER
+    RUN_TEST(testControllerUsesEdgeTimes);
+  #endif
+#endif
+  return testResult();
+}
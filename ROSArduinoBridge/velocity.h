@@ -0,0 +1,65 @@
+/***************************************************************
+   Wheel velocity from encoder counts and edge times (M/T method)
+
+   Counting ticks per frame quantizes the speed to whole ticks: at
+   30 Hz a slow wheel moves 2, 3, 2, 3 ticks per frame, and the
+   derivative term mostly sees that quantization noise.
+
+   The encoder interrupts also store the time of the latest counted
+   edge (EncoderSnapshot::edge). A frame that counted n edges then
+   measures n edge periods exactly: from the last edge of the
+   window before to the last edge of this one. The velocity is
+
+     n * frame / (edge - prevEdge)   ticks per frame, in Q8
+
+   which resolves fractions of a tick at low speed while staying the
+   plain count at high speed. A frame without edges bounds the speed
+   by one edge in the time since the last one, so a stopping wheel
+   decays to zero instead of holding its last value.
+
+   After a standstill the window would reach back to the last edge
+   before it, seconds ago, and read a starting wheel as almost at
+   rest. A window longer than VELOCITY_STANDSTILL frames therefore
+   falls back to the count of the tick, so the PID gets no kick at
+   every start; speeds below one tick per VELOCITY_STANDSTILL frames
+   are read that way too.
+
+   Encoders that do not report edge times (NO_ENCODERS, the Robogaia
+   shield) stamp every edge with the snapshot time, which reduces
+   the estimate to the count scaled by the real frame length.
+
+   VELOCITY_FILTER adds a first-order low-pass filter with a
+   weight of 1 / 2^VELOCITY_FILTER on the new estimate; 0 leaves
+   the estimate unfiltered.
+   *************************************************************/
+
+#ifndef VELOCITY_H
+#define VELOCITY_H
+
+#ifndef VELOCITY_FILTER
+  #define VELOCITY_FILTER 0
+#endif
+
+/* At this many counts per frame the count alone is precise enough,
+   and the 32-bit product n * frame << 8 could overflow */
+#define VELOCITY_MT_COUNTS 32
+
+/* Frames between two edges beyond which the wheel counts as having
+   stood still in between */
+#define VELOCITY_STANDSTILL 8
+
+/*
+ * One frame's estimate for a channel.
+ *
+ * @param counts   Ticks counted during the frame
+ * @param edge     micros() of the latest counted edge
+ * @param now      micros() when the counts were latched
+ * @param prevEdge Start of the edge window; advanced to edge when
+ *                 the frame counted ticks
+ * @param previous Last frame's estimate, Q8 ticks per frame
+ * @return The new (filtered) estimate, Q8 ticks per frame
+ */
+long velocityEstimate(long counts, unsigned long edge, unsigned long now,
+                      unsigned long *prevEdge, long previous);
+
+#endif // VELOCITY_H
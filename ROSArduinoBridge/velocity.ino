@@ -0,0 +1,45 @@
+/***************************************************************
+   Wheel velocity estimation implementation
+   *************************************************************/
+
+#ifdef USE_BASE
+
+long velocityEstimate(long counts, unsigned long edge, unsigned long now,
+                      unsigned long *prevEdge, long previous) {
+  const unsigned long frameQ8 = (unsigned long)PID_INTERVAL * 1000UL << PID_Q;
+  const unsigned long standstill = (unsigned long)VELOCITY_STANDSTILL * PID_INTERVAL * 1000UL;
+  long estimate;
+
+  if (counts == 0) {
+    // No edge: at most one tick in the time since the last edge.
+    // While the last estimate is within that, as it mostly is at a
+    // high loop rate, a multiplication tells without the division.
+    unsigned long idle = now - *prevEdge;
+    unsigned long magnitude = previous < 0 ? -previous : previous;
+    if (idle == 0 || (idle <= 0xFFFF && magnitude <= 0xFFFF && magnitude * idle <= frameQ8)) {
+      estimate = previous;
+    } else {
+      long bound = (long)(frameQ8 / idle);
+      estimate = constrain(previous, -bound, bound);
+    }
+  } else {
+    unsigned long window = edge - *prevEdge;
+    unsigned long n = counts < 0 ? -counts : counts;
+    if (window == 0 || n >= VELOCITY_MT_COUNTS || window > standstill) {
+      // Counts per tick, in ticks per frame; also the first edges
+      // after a standstill, whose window holds the idle time
+      estimate = counts * controlTicksPerFrame;
+    } else {
+      estimate = (long)(n * frameQ8 / window);
+      if (counts < 0) estimate = -estimate;
+    }
+    *prevEdge = edge;
+  }
+
+  #if VELOCITY_FILTER > 0
+    estimate = previous + (estimate - previous) / (1L << VELOCITY_FILTER);
+  #endif
+  return estimate;
+}
+
+#endif // USE_BASE
@@ -0,0 +1,101 @@
+/***************************************************************
+   Host benchmark runner
+
+   Runs the firmware's benchmark cases (benchmark.ino) on the host
+   build and reports wall time and retired user-space instructions
+   per call:
+
+     bench_mecanum_enc [iterations]
+
+   Instruction counts come from perf_event_open(); where the kernel
+   does not allow it (containers, perf_event_paranoid) the column
+   shows "-". The harness overhead is measured with the empty case
+   and subtracted, as on the target. Host numbers are for comparing
+   changes and configurations, not a prediction of AVR timing: use
+   the on-target harness (USE_BENCHMARKS) for that.
+   *************************************************************/
+
+#include "firmware_sketch.h"
+#include "mock_control.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef BENCH_CONFIG
+  #define BENCH_CONFIG "?"
+#endif
+
+static int openInstructionCounter() {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+struct Sample {
+  double ns;
+  double instructions;  // negative when not available
+};
+
+static Sample measure(int counter, void (*run)(), long iterations) {
+  for (long i = 0; i < iterations / 10 + 1; i++) run();  // warm up
+
+  long long count = 0;
+  struct timespec t0, t1;
+  if (counter >= 0) {
+    ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (long i = 0; i < iterations; i++) run();
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  if (counter >= 0) {
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counter, &count, sizeof(count)) != sizeof(count)) count = -1;
+  }
+
+  Sample s;
+  s.ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / iterations;
+  s.instructions = (counter >= 0 && count >= 0) ? (double)count / iterations : -1;
+  return s;
+}
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 200000;
+  if (iterations <= 0) iterations = 1;
+
+  // setup() also runs the on-target harness; with virtual time it
+  // reports zeros, which only shows that every case runs
+  mock_reset();
+  setup();
+  mock_serial_take_output();
+
+  int counter = openInstructionCounter();
+  Sample overhead = measure(counter, benchNothing, iterations);
+
+  printf("config %s, %ld iterations\n", BENCH_CONFIG, iterations);
+  printf("  %-12s %10s %12s\n", "case", "ns/call", "instr/call");
+  for (uint8_t i = 0; i < benchCaseCount; i++) {
+    if (benchCases[i].prepare) benchCases[i].prepare();
+    Sample s = measure(counter, benchCases[i].run, iterations);
+    mock_serial_take_output();
+
+    printf("  %-12s %10.1f", benchCases[i].name, s.ns > overhead.ns ? s.ns - overhead.ns : 0.0);
+    if (s.instructions >= 0) printf(" %12.1f\n", s.instructions - overhead.instructions);
+    else printf(" %12s\n", "-");
+  }
+  benchFinish();
+
+  if (counter >= 0) close(counter);
+  return 0;
+}
@@ -0,0 +1,712 @@
+/***************************************************************
+   Asynchronous host client implementation
+   *************************************************************/
+
+#include "bridge_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+
+/* serial_speed.cpp: any baud rate through termios2 */
+int serialSetSpeed(int fd, long baud);
+
+static uint64_t monotonicMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* CRC-16/CCITT-FALSE, as crc16Update() in protocol.ino */
+static uint16_t frameCrc(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t x = (crc >> 8) ^ data[i];
+    x ^= x >> 4;
+    crc = (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+  }
+  return crc;
+}
+
+/***************************************************************
+   Latency histogram
+   *************************************************************/
+
+int LatencyHistogram::bucketOf(uint64_t micros) {
+  if (micros < (uint64_t)SUB_BUCKETS) return (int)micros;
+  int msb = 63 - __builtin_clzll(micros);
+  int shift = msb - SUB_BITS;
+  int bucket = (shift + 1) * SUB_BUCKETS + (int)((micros >> shift) & (SUB_BUCKETS - 1));
+  return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::bucketLow(int bucket) {
+  if (bucket < SUB_BUCKETS) return bucket;
+  int shift = bucket / SUB_BUCKETS - 1;
+  return (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+  counts[bucketOf(micros)]++;
+  if (total == 0 || micros < lowest) lowest = micros;
+  if (micros > highest) highest = micros;
+  total++;
+  sum += micros;
+}
+
+void LatencyHistogram::reset() {
+  memset(counts, 0, sizeof(counts));
+  total = 0;
+  sum = 0;
+  lowest = 0;
+  highest = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+  if (total == 0) return 0;
+  uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+  if (rank < 1) rank = 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; b++) {
+    seen += counts[b];
+    if (seen >= rank) {
+      uint64_t high = b + 1 < BUCKETS ? bucketLow(b + 1) - 1 : highest;
+      return high < highest ? high : highest;
+    }
+  }
+  return highest;
+}
+
+/***************************************************************
+   Framing
+   *************************************************************/
+
+std::vector<uint8_t> bridgeEncodeFrame(const std::vector<uint8_t> &body) {
+  std::vector<uint8_t> data(body);
+  uint16_t crc = frameCrc(data.data(), data.size());
+  data.push_back(crc & 0xFF);
+  data.push_back(crc >> 8);
+
+  std::vector<uint8_t> out;
+  out.push_back(0);
+  size_t codeIndex = out.size();
+  out.push_back(0);
+  uint8_t code = 1;
+  for (size_t i = 0; i < data.size(); i++) {
+    if (data[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = out.size();
+      out.push_back(0);
+      code = 1;
+    } else {
+      out.push_back(data[i]);
+      if (++code == 0xFF) {
+        out[codeIndex] = code;
+        codeIndex = out.size();
+        out.push_back(0);
+        code = 1;
+      }
+    }
+  }
+  out[codeIndex] = code;
+  out.push_back(0);
+  return out;
+}
+
+bool BridgeFrameDecoder::decode(std::vector<uint8_t> *body) {
+  body->clear();
+  size_t i = 0;
+  while (i < raw.size()) {
+    uint8_t code = raw[i++];
+    if (code == 0 || i + code - 1 > raw.size()) return false;
+    body->insert(body->end(), raw.begin() + i, raw.begin() + i + code - 1);
+    i += code - 1;
+    if (code != 0xFF && i < raw.size()) body->push_back(0);
+  }
+  if (body->size() < 4) return false;  // opcode seq crc
+  size_t n = body->size() - 2;
+  uint16_t crc = (*body)[n] | ((*body)[n + 1] << 8);
+  if (frameCrc(body->data(), n) != crc) return false;
+  body->resize(n);
+  return true;
+}
+
+void BridgeFrameDecoder::feed(const uint8_t *data, size_t len, std::vector<std::vector<uint8_t> > *frames) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i];
+    if (b != 0) {
+      // Bytes outside a frame (ASCII output) are collected too and
+      // fail the CRC at the next NUL
+      raw.push_back(b);
+      continue;
+    }
+    if (!raw.empty()) {
+      std::vector<uint8_t> body;
+      if (decode(&body)) frames->push_back(body);
+      else bad++;
+    }
+    raw.clear();
+  }
+}
+
+/***************************************************************
+   Client
+   *************************************************************/
+
+/* Reply field of every opcode that answers with values */
+static char replyField(uint8_t opcode) {
+  switch (opcode) {
+    case ANALOG_READ:    return BIN_I16;
+    case GET_BAUDRATE:   return BIN_I32;
+    case DIGITAL_READ:   return BIN_U8;
+    case READ_ENCODERS:  return BIN_I32;
+    case PING:           return BIN_I32;
+    case SERVO_READ:     return BIN_I16;
+    case READ_ODOMETRY:  return BIN_I32;
+    case SETPOINT_QUEUE: return BIN_U8;
+    case QUIET_MODE:     return BIN_I32;
+    case SET_BAUDRATE:   return BIN_I32;
+    case LOOP_STATS:     return BIN_I32;
+    case CONFIG_VALUE:   return BIN_I32;
+    case CONTROL_RATE:   return BIN_I16;
+    case RECORDER:       return BIN_I32;
+  }
+  return 0;
+}
+
+static void decodeValues(BridgeReply *reply) {
+  char field = replyField(reply->opcode);
+  size_t size = field == BIN_I32 ? 4 : field == BIN_I16 ? 2 : field ? 1 : 0;
+  if (size == 0 || reply->status != BIN_STATUS_OK) return;
+  for (size_t at = 0; at + size <= reply->payload.size(); at += size) {
+    uint32_t raw = 0;
+    for (size_t b = 0; b < size; b++) raw |= (uint32_t)reply->payload[at + b] << (8 * b);
+    if (field == BIN_I32) reply->values.push_back((int32_t)raw);
+    else if (field == BIN_I16) reply->values.push_back((int16_t)raw);
+    else if (field == BIN_I8) reply->values.push_back((int8_t)raw);
+    else reply->values.push_back(raw);
+  }
+}
+
+static void putU8(std::vector<uint8_t> &out, uint8_t v) { out.push_back(v); }
+
+static void putI16(std::vector<uint8_t> &out, int16_t v) {
+  out.push_back(v & 0xFF);
+  out.push_back((uint16_t)v >> 8);
+}
+
+static void putI32(std::vector<uint8_t> &out, int32_t v) {
+  for (int b = 0; b < 4; b++) out.push_back(((uint32_t)v >> (8 * b)) & 0xFF);
+}
+
+BridgeClient::BridgeClient()
+  : fd(-1), epfd(-1), baud(0), wantWrite(false), maxInFlight(8), timeoutMicros(100000),
+    seqCounter(0), bytesWritten(0), timedOut(0), strays(0) {}
+
+BridgeClient::~BridgeClient() {
+  close();
+}
+
+bool BridgeClient::setBaud(long rate) {
+  if (tcdrain(fd) < 0 || serialSetSpeed(fd, rate) < 0) return false;
+  baud = rate;
+  return true;
+}
+
+bool BridgeClient::open(const std::string &device, long rate) {
+  int port = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (port < 0) return false;
+
+  // Raw 8N1; VMIN 1 so an empty non-blocking read is EAGAIN, not 0
+  struct termios tio;
+  if (tcgetattr(port, &tio) < 0) {
+    ::close(port);
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~CRTSCTS;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  if (tcsetattr(port, TCSANOW, &tio) < 0 || serialSetSpeed(port, rate) < 0) {
+    ::close(port);
+    return false;
+  }
+  tcflush(port, TCIOFLUSH);
+
+  if (!attach(port)) return false;
+  baud = rate;
+  return true;
+}
+
+bool BridgeClient::attach(int port) {
+  close();
+  fcntl(port, F_SETFL, fcntl(port, F_GETFL) | O_NONBLOCK);
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) {
+    ::close(port);
+    return false;
+  }
+  fd = port;
+  wantWrite = true;  // forces the first updateEvents() to register
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    close();
+    return false;
+  }
+  wantWrite = false;
+  return true;
+}
+
+void BridgeClient::close() {
+  if (epfd >= 0) ::close(epfd);
+  if (fd >= 0) ::close(fd);
+  epfd = fd = -1;
+  baud = 0;
+  queued.clear();
+  pending.clear();
+  txBuffer.clear();
+}
+
+void BridgeClient::setMaxInFlight(unsigned int depth) {
+  maxInFlight = depth < 1 ? 1 : depth > 255 ? 255 : depth;
+}
+
+uint8_t BridgeClient::nextSeq() {
+  // At most 255 in flight, so a free seq always exists
+  while (pending.count(seqCounter)) seqCounter++;
+  return seqCounter++;
+}
+
+/* Move queued requests into free in-flight slots, in order */
+void BridgeClient::admit() {
+  while (!queued.empty() && pending.size() < maxInFlight) {
+    Request &next = queued.front();
+    if (next.opcode == TELEMETRY) {
+      bool subscribing = false;
+      for (std::map<uint8_t, Request>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        if (it->second.opcode == TELEMETRY) subscribing = true;
+      }
+      if (subscribing) break;
+    }
+
+    next.seq = nextSeq();
+    next.frame[1] = next.seq;
+    std::vector<uint8_t> wire = bridgeEncodeFrame(next.frame);
+    txBuffer.insert(txBuffer.end(), wire.begin(), wire.end());
+    next.streamEnd = bytesWritten + txBuffer.size();
+    next.writtenAt = 0;
+    pending[next.seq] = next;
+    queued.pop_front();
+  }
+}
+
+bool BridgeClient::flush() {
+  while (!txBuffer.empty()) {
+    ssize_t n = ::write(fd, txBuffer.data(), txBuffer.size());
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) break;
+      return false;
+    }
+    txBuffer.erase(txBuffer.begin(), txBuffer.begin() + n);
+    bytesWritten += n;
+  }
+
+  uint64_t now = monotonicMicros();
+  for (std::map<uint8_t, Request>::iterator it = pending.begin(); it != pending.end(); ++it) {
+    Request &r = it->second;
+    if (r.writtenAt == 0 && r.streamEnd <= bytesWritten) r.writtenAt = now;
+  }
+  return true;
+}
+
+bool BridgeClient::receive(std::vector<Completion> *done) {
+  std::vector<std::vector<uint8_t> > frames;
+  uint8_t buf[512];
+  for (;;) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      decoder.feed(buf, n, &frames);
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EINTR) return false;
+    break;
+  }
+
+  uint64_t now = monotonicMicros();
+  for (size_t i = 0; i < frames.size(); i++) {
+    const std::vector<uint8_t> &frame = frames[i];
+    if (frame.size() < 3) {
+      strays++;
+      continue;
+    }
+    Completion c;
+    c.reply.opcode = frame[0];
+    c.reply.seq = frame[1];
+    c.reply.status = frame[2];
+    c.reply.payload.assign(frame.begin() + 3, frame.end());
+    c.reply.latencyMicros = 0;
+
+    if (c.reply.opcode == TELEMETRY && c.reply.payload.size() >= 4) {
+      c.callback = telemetryCallback;
+      done->push_back(c);
+      continue;
+    }
+    if (c.reply.opcode == RECORDER_FRAME) {
+      c.callback = recorderCallback;
+      done->push_back(c);
+      continue;
+    }
+
+    std::map<uint8_t, Request>::iterator it = pending.find(c.reply.seq);
+    if (it == pending.end() || it->second.opcode != c.reply.opcode) {
+      strays++;
+      continue;
+    }
+    if (it->second.writtenAt) c.reply.latencyMicros = now - it->second.writtenAt;
+    latencyAll.record(c.reply.latencyMicros);
+    latencyByOpcode[c.reply.opcode].record(c.reply.latencyMicros);
+    decodeValues(&c.reply);
+    c.callback = it->second.callback;
+    pending.erase(it);
+    done->push_back(c);
+  }
+  return true;
+}
+
+void BridgeClient::expire(std::vector<Completion> *done) {
+  uint64_t now = monotonicMicros();
+  std::map<uint8_t, Request>::iterator it = pending.begin();
+  while (it != pending.end()) {
+    Request &r = it->second;
+    if (r.writtenAt == 0 || now - r.writtenAt < timeoutMicros) {
+      ++it;
+      continue;
+    }
+    Completion c;
+    c.callback = r.callback;
+    c.reply.opcode = r.opcode;
+    c.reply.seq = r.seq;
+    c.reply.status = BRIDGE_STATUS_TIMEOUT;
+    c.reply.latencyMicros = now - r.writtenAt;
+    done->push_back(c);
+    timedOut++;
+    pending.erase(it++);
+  }
+}
+
+void BridgeClient::updateEvents() {
+  bool write = !txBuffer.empty();
+  if (write == wantWrite) return;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | (write ? (uint32_t)EPOLLOUT : 0u);
+  ev.data.fd = fd;
+  epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+  wantWrite = write;
+}
+
+bool BridgeClient::request(uint8_t opcode, const std::vector<uint8_t> &payload, const BridgeCallback &callback) {
+  if (fd < 0) return false;
+  Request r;
+  r.opcode = opcode;
+  r.seq = 0;
+  r.frame.push_back(opcode);
+  r.frame.push_back(0);  // seq, set when the request gets a slot
+  r.frame.insert(r.frame.end(), payload.begin(), payload.end());
+  r.callback = callback;
+  r.writtenAt = 0;
+  r.streamEnd = 0;
+  queued.push_back(r);
+
+  admit();
+  if (!flush()) return false;
+  updateEvents();
+  return true;
+}
+
+int BridgeClient::poll(int timeoutMs) {
+  if (fd < 0) return -1;
+
+  // Wake up in time for the earliest timeout
+  uint64_t now = monotonicMicros();
+  for (std::map<uint8_t, Request>::iterator it = pending.begin(); it != pending.end(); ++it) {
+    const Request &r = it->second;
+    if (r.writtenAt == 0) continue;
+    uint64_t due = r.writtenAt + timeoutMicros;
+    int ms = due > now ? (int)((due - now + 999) / 1000) : 0;
+    if (timeoutMs < 0 || ms < timeoutMs) timeoutMs = ms;
+  }
+
+  struct epoll_event events[4];
+  int n = epoll_wait(epfd, events, 4, timeoutMs);
+  if (n < 0 && errno != EINTR) return -1;
+
+  std::vector<Completion> done;
+  bool ok = true;
+  uint32_t seen = 0;
+  for (int i = 0; i < n; i++) seen |= events[i].events;
+  if (seen & (EPOLLIN | EPOLLHUP | EPOLLERR)) ok = receive(&done);
+  expire(&done);
+  admit();
+  if (ok) ok = flush();
+  if (ok) updateEvents();
+
+  for (size_t i = 0; i < done.size(); i++) {
+    if (done[i].callback) done[i].callback(done[i].reply);
+  }
+  return ok ? (int)done.size() : -1;
+}
+
+bool BridgeClient::wait(int timeoutMs) {
+  uint64_t deadline = monotonicMicros() + (uint64_t)timeoutMs * 1000;
+  while (inFlight()) {
+    uint64_t now = monotonicMicros();
+    if (now >= deadline) return false;
+    if (poll((int)((deadline - now + 999) / 1000)) < 0) return false;
+  }
+  return true;
+}
+
+bool BridgeClient::call(uint8_t opcode, const std::vector<uint8_t> &payload, BridgeReply *reply, int timeoutMs) {
+  // Shared with the callback, which may run after a timeout here
+  std::shared_ptr<BridgeReply> answer = std::make_shared<BridgeReply>();
+  answer->opcode = opcode;
+  answer->seq = 0;
+  answer->status = BRIDGE_STATUS_TIMEOUT;
+  answer->latencyMicros = 0;
+  std::shared_ptr<bool> answered = std::make_shared<bool>(false);
+  BridgeCallback keep = [answer, answered](const BridgeReply &r) {
+    *answer = r;
+    *answered = true;
+  };
+
+  bool ok = request(opcode, payload, keep);
+  uint64_t deadline = monotonicMicros() + (uint64_t)timeoutMs * 1000;
+  while (ok && !*answered) {
+    uint64_t now = monotonicMicros();
+    if (now >= deadline || poll((int)((deadline - now + 999) / 1000)) < 0) ok = false;
+  }
+  *reply = *answer;
+  return ok && reply->status != BRIDGE_STATUS_TIMEOUT;
+}
+
+bool BridgeClient::wheels(uint8_t opcode, const std::vector<uint8_t> &prefix, const std::vector<int16_t> &values,
+                          const BridgeCallback &callback) {
+  std::vector<uint8_t> payload(prefix);
+  for (size_t i = 0; i < values.size(); i++) putI16(payload, values[i]);
+  return request(opcode, payload, callback);
+}
+
+/***************************************************************
+   Typed requests
+   *************************************************************/
+
+bool BridgeClient::analogRead(uint8_t pin, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  return request(ANALOG_READ, p, callback);
+}
+
+bool BridgeClient::getBaudrate(const BridgeCallback &callback) {
+  return request(GET_BAUDRATE, std::vector<uint8_t>(), callback);
+}
+
+bool BridgeClient::pinMode(uint8_t pin, uint8_t mode, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  putU8(p, mode);
+  return request(PIN_MODE, p, callback);
+}
+
+bool BridgeClient::digitalRead(uint8_t pin, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  return request(DIGITAL_READ, p, callback);
+}
+
+bool BridgeClient::readEncoders(const BridgeCallback &callback) {
+  return request(READ_ENCODERS, std::vector<uint8_t>(), callback);
+}
+
+bool BridgeClient::steeringDir(int32_t direction, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putI32(p, direction);
+  return request(STEERING_DIR, p, callback);
+}
+
+bool BridgeClient::motorSpeeds(const std::vector<int16_t> &speeds, const BridgeCallback &callback) {
+  return wheels(MOTOR_SPEEDS, std::vector<uint8_t>(), speeds, callback);
+}
+
+bool BridgeClient::motorRawPwm(const std::vector<int16_t> &pwm, const BridgeCallback &callback) {
+  return wheels(MOTOR_RAW_PWM, std::vector<uint8_t>(), pwm, callback);
+}
+
+bool BridgeClient::ping(uint8_t pin, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  return request(PING, p, callback);
+}
+
+bool BridgeClient::resetEncoders(const BridgeCallback &callback) {
+  return request(RESET_ENCODERS, std::vector<uint8_t>(), callback);
+}
+
+bool BridgeClient::servoWrite(uint8_t index, int16_t position, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, index);
+  putI16(p, position);
+  return request(SERVO_WRITE, p, callback);
+}
+
+bool BridgeClient::servoRead(uint8_t index, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, index);
+  return request(SERVO_READ, p, callback);
+}
+
+bool BridgeClient::updatePid(int16_t kp, int16_t kd, int16_t ki, int16_t ko, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putI16(p, kp);
+  putI16(p, kd);
+  putI16(p, ki);
+  putI16(p, ko);
+  return request(UPDATE_PID, p, callback);
+}
+
+bool BridgeClient::digitalWrite(uint8_t pin, uint8_t value, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  putU8(p, value);
+  return request(DIGITAL_WRITE, p, callback);
+}
+
+bool BridgeClient::analogWrite(uint8_t pin, int16_t value, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, pin);
+  putI16(p, value);
+  return request(ANALOG_WRITE, p, callback);
+}
+
+bool BridgeClient::setEncoderDirection(uint8_t encoder, int8_t direction, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, encoder);
+  putU8(p, (uint8_t)direction);
+  return request(SET_ENC_DIR, p, callback);
+}
+
+bool BridgeClient::mecanumTwist(int16_t vx, int16_t vy, int16_t wz, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putI16(p, vx);
+  putI16(p, vy);
+  putI16(p, wz);
+  return request(MECANUM_TWIST, p, callback);
+}
+
+bool BridgeClient::telemetry(uint8_t streams, uint8_t decimation, uint8_t analogMask, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, streams);
+  putU8(p, decimation);
+  putU8(p, analogMask);
+  return request(TELEMETRY, p, callback);
+}
+
+bool BridgeClient::readOdometry(bool zero, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, zero ? 1 : 0);
+  return request(READ_ODOMETRY, p, callback);
+}
+
+bool BridgeClient::setpointQueue(uint8_t dt, const std::vector<int16_t> &speeds, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, dt);
+  return wheels(SETPOINT_QUEUE, p, speeds, callback);
+}
+
+bool BridgeClient::quietMode(bool quiet, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, quiet ? 1 : 0);
+  return request(QUIET_MODE, p, callback);
+}
+
+bool BridgeClient::setBaudrate(int32_t rate, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putI32(p, rate);
+  return request(SET_BAUDRATE, p, callback);
+}
+
+bool BridgeClient::loopStats(uint8_t stage, bool reset, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, stage);
+  putU8(p, reset ? 1 : 0);
+  return request(LOOP_STATS, p, callback);
+}
+
+bool BridgeClient::configValue(uint8_t op, uint8_t key, int32_t value, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, op);
+  putU8(p, key);
+  putI32(p, value);
+  return request(CONFIG_VALUE, p, callback);
+}
+
+bool BridgeClient::controlRate(int16_t hz, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putI16(p, hz);
+  return request(CONTROL_RATE, p, callback);
+}
+
+bool BridgeClient::recorder(uint8_t op, const BridgeCallback &callback) {
+  std::vector<uint8_t> p;
+  putU8(p, op);
+  return request(RECORDER, p, callback);
+}
+
+bool BridgeClient::negotiateBaud(long rate, int timeoutMs) {
+  if (fd < 0 || inFlight()) return false;
+  long previous = baud;
+  std::vector<uint8_t> p;
+  putI32(p, rate);
+  BridgeReply reply;
+  if (!call(SET_BAUDRATE, p, &reply, timeoutMs) || reply.status != BIN_STATUS_OK) return false;
+
+  // The ack has arrived, so the board switches within a loop() pass
+  if (previous && !setBaud(rate)) return false;
+  usleep(2000);
+  tcflush(fd, TCIFLUSH);
+
+  for (int attempt = 0; attempt < 3; attempt++) {
+    if (call(GET_BAUDRATE, std::vector<uint8_t>(), &reply, timeoutMs) && reply.status == BIN_STATUS_OK &&
+        reply.values.size() == 1 && reply.values[0] == rate) {
+      return true;
+    }
+  }
+  // The board falls back on its own after BAUD_CONFIRM_TIMEOUT
+  if (previous) setBaud(previous);
+  return false;
+}
+
+/***************************************************************
+   Latency
+   *************************************************************/
+
+const LatencyHistogram &BridgeClient::latency(uint8_t opcode) const {
+  static const LatencyHistogram empty;
+  std::map<uint8_t, LatencyHistogram>::const_iterator it = latencyByOpcode.find(opcode);
+  return it == latencyByOpcode.end() ? empty : it->second;
+}
+
+void BridgeClient::resetLatency() {
+  latencyAll.reset();
+  latencyByOpcode.clear();
+}
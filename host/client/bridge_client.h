@@ -0,0 +1,292 @@
+/***************************************************************
+   Asynchronous host client for the bridge's binary protocol
+
+   Talks to a board built with USE_BINARY_PROTOCOL (or to the host
+   runner's --pty) without the write-then-readline round trip of a
+   blocking client: requests are written as soon as there is an
+   in-flight slot, several of them travel at once, and every reply
+   is matched back to its request by the frame's seq byte.
+
+     BridgeClient client;
+     client.open("/dev/ttyACM0", 115200);
+     client.readEncoders([](const BridgeReply &r) { ... });
+     client.ping(7, [](const BridgeReply &r) { ... });
+     while (client.inFlight()) client.poll(10);
+
+   The serial port is non-blocking and driven by an epoll set, so
+   nothing waits for the line: poll() sleeps until the port is
+   readable (or writable while frames are queued), decodes the
+   replies that arrived and runs their callbacks on the caller's
+   thread. epollFd() can be added to an application's own event
+   loop, which then calls poll(0) when it fires.
+
+   A request whose reply does not arrive within the timeout (a
+   frame lost to a CRC error, a board reset) completes with
+   status BRIDGE_STATUS_TIMEOUT, so no slot is held forever.
+   Telemetry samples of a binary subscription arrive as TELEMETRY
+   frames with a payload of at least the u32 timestamp; they go to
+   the telemetry callback instead of a request. Only one TELEMETRY
+   request is in flight at a time so its reply can not be mistaken
+   for a sample. The records of a flight recorder dump arrive the
+   same way, as RECORDER_FRAME frames for the recorder callback.
+
+   Round-trip times, from the moment the frame has been handed to
+   the kernel to the moment its reply is decoded, are recorded
+   per opcode in LatencyHistogram.
+   *************************************************************/
+
+#ifndef BRIDGE_CLIENT_H
+#define BRIDGE_CLIENT_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "commands.h"
+#include "config.h"
+#include "protocol.h"
+
+/* Status of a request that got no reply within the timeout */
+#define BRIDGE_STATUS_TIMEOUT -1
+
+struct BridgeReply {
+  uint8_t opcode;
+  uint8_t seq;
+  int status;                  // BIN_STATUS_* or BRIDGE_STATUS_TIMEOUT
+  std::vector<long> values;    // decoded with the opcode's reply field
+  std::vector<uint8_t> payload;
+  uint64_t latencyMicros;
+};
+
+typedef std::function<void(const BridgeReply &)> BridgeCallback;
+
+/***************************************************************
+   Latency histogram
+
+   Log-linear buckets: exact below 8 us, then 8 buckets per power
+   of two, so every bucket is within 12.5 % of its values. Covers
+   up to 2^32 us; anything longer lands in the last bucket.
+   *************************************************************/
+
+class LatencyHistogram {
+ public:
+  static const int SUB_BITS = 3;
+  static const int SUB_BUCKETS = 1 << SUB_BITS;
+  static const int BUCKETS = (32 - SUB_BITS + 1) * SUB_BUCKETS;
+
+  LatencyHistogram() { reset(); }
+
+  void record(uint64_t micros);
+  void reset();
+
+  uint64_t count() const { return total; }
+  uint64_t min() const { return total ? lowest : 0; }
+  uint64_t max() const { return highest; }
+  double mean() const { return total ? (double)sum / total : 0; }
+
+  /* Upper bound of the bucket holding the p-th percentile (0-100) */
+  uint64_t percentile(double p) const;
+
+  /* Bucket access for printing or exporting */
+  uint64_t bucketCount(int bucket) const { return counts[bucket]; }
+  static int bucketOf(uint64_t micros);
+  static uint64_t bucketLow(int bucket);
+
+ private:
+  uint64_t counts[BUCKETS];
+  uint64_t total;
+  uint64_t sum;
+  uint64_t lowest;
+  uint64_t highest;
+};
+
+/***************************************************************
+   Framing, shared with the tests' fake device
+   *************************************************************/
+
+/* NUL, COBS(opcode seq [status] payload crc), NUL */
+std::vector<uint8_t> bridgeEncodeFrame(const std::vector<uint8_t> &body);
+
+/*
+ * Splits a byte stream into frames. feed() returns every complete
+ * frame body (CRC checked and stripped); anything between frames
+ * that is not a valid frame, such as ASCII output, is skipped and
+ * counted in errors().
+ */
+class BridgeFrameDecoder {
+ public:
+  BridgeFrameDecoder() : bad(0) {}
+  void feed(const uint8_t *data, size_t len, std::vector<std::vector<uint8_t> > *frames);
+  unsigned long errors() const { return bad; }
+
+ private:
+  bool decode(std::vector<uint8_t> *body);
+
+  std::vector<uint8_t> raw;
+  unsigned long bad;
+};
+
+/***************************************************************
+   Client
+   *************************************************************/
+
+class BridgeClient {
+ public:
+  BridgeClient();
+  ~BridgeClient();
+
+  /* Open a serial device raw and non-blocking at baud (57600 to
+     1000000, see baud.h); false with errno set on failure */
+  bool open(const std::string &device, long baud);
+
+  /* Use an already open descriptor (pty, socketpair); the client
+     makes it non-blocking and closes it in close() */
+  bool attach(int fd);
+
+  void close();
+  bool isOpen() const { return fd >= 0; }
+  int epollFd() const { return epfd; }
+
+  /* Requests written before their replies are waited for (1-255).
+     The board's 128-byte RX ring bounds how deep this is useful. */
+  void setMaxInFlight(unsigned int depth);
+
+  /* Time a written request may wait for its reply */
+  void setTimeout(unsigned int millis) { timeoutMicros = (uint64_t)millis * 1000; }
+
+  /* Callback for the samples of a binary telemetry subscription */
+  void onTelemetry(const BridgeCallback &callback) { telemetryCallback = callback; }
+
+  /* Callback for the frames of a flight recorder dump; the payload
+     holds whole RecorderEntry records of the board's build */
+  void onRecorder(const BridgeCallback &callback) { recorderCallback = callback; }
+
+  /*
+   * Queue a request with its raw little-endian payload (the layout
+   * of binLayouts in protocol.ino). The callback runs from poll()
+   * with the reply. Returns false if the client is not open.
+   */
+  bool request(uint8_t opcode, const std::vector<uint8_t> &payload,
+               const BridgeCallback &callback = BridgeCallback());
+
+  /*
+   * Wait up to timeoutMs for I/O and handle it: write queued
+   * frames, dispatch replies and telemetry, expire requests.
+   * Returns the number of callbacks run, or -1 on an I/O error.
+   */
+  int poll(int timeoutMs);
+
+  /* Run poll() until nothing is in flight or queued, at most
+     timeoutMs; true if everything completed */
+  bool wait(int timeoutMs);
+
+  /* Requests not yet completed, written or still queued */
+  size_t inFlight() const { return pending.size() + queued.size(); }
+
+  /* A request and wait() for its reply; false on I/O errors and
+     timeouts, reply holds the status either way */
+  bool call(uint8_t opcode, const std::vector<uint8_t> &payload, BridgeReply *reply, int timeoutMs);
+
+  /* Typed requests, one per opcode of commands.h. The wheel
+     arguments take two values (left right) or, on mecanum
+     builds, four (fl fr rl rr). */
+  bool analogRead(uint8_t pin, const BridgeCallback &callback);
+  bool getBaudrate(const BridgeCallback &callback);
+  bool pinMode(uint8_t pin, uint8_t mode, const BridgeCallback &callback = BridgeCallback());
+  bool digitalRead(uint8_t pin, const BridgeCallback &callback);
+  bool readEncoders(const BridgeCallback &callback);
+  bool steeringDir(int32_t direction, const BridgeCallback &callback = BridgeCallback());
+  bool motorSpeeds(const std::vector<int16_t> &speeds, const BridgeCallback &callback = BridgeCallback());
+  bool motorRawPwm(const std::vector<int16_t> &pwm, const BridgeCallback &callback = BridgeCallback());
+  bool ping(uint8_t pin, const BridgeCallback &callback);
+  bool resetEncoders(const BridgeCallback &callback = BridgeCallback());
+  bool servoWrite(uint8_t index, int16_t position, const BridgeCallback &callback = BridgeCallback());
+  bool servoRead(uint8_t index, const BridgeCallback &callback);
+  bool updatePid(int16_t kp, int16_t kd, int16_t ki, int16_t ko, const BridgeCallback &callback = BridgeCallback());
+  bool digitalWrite(uint8_t pin, uint8_t value, const BridgeCallback &callback = BridgeCallback());
+  bool analogWrite(uint8_t pin, int16_t value, const BridgeCallback &callback = BridgeCallback());
+  bool setEncoderDirection(uint8_t encoder, int8_t direction, const BridgeCallback &callback = BridgeCallback());
+  bool mecanumTwist(int16_t vx, int16_t vy, int16_t wz, const BridgeCallback &callback = BridgeCallback());
+  bool telemetry(uint8_t streams, uint8_t decimation, uint8_t analogMask,
+                 const BridgeCallback &callback = BridgeCallback());
+  bool readOdometry(bool zero, const BridgeCallback &callback);
+  bool setpointQueue(uint8_t dt, const std::vector<int16_t> &speeds, const BridgeCallback &callback = BridgeCallback());
+  bool quietMode(bool quiet, const BridgeCallback &callback = BridgeCallback());
+  bool setBaudrate(int32_t rate, const BridgeCallback &callback = BridgeCallback());
+  bool loopStats(uint8_t stage, bool reset, const BridgeCallback &callback);
+  bool configValue(uint8_t op, uint8_t key, int32_t value, const BridgeCallback &callback);
+  bool controlRate(int16_t hz, const BridgeCallback &callback);
+  bool recorder(uint8_t op, const BridgeCallback &callback);
+
+  /*
+   * Move the link to rate: SET_BAUDRATE, switch the local port once
+   * the ack is in, and confirm with GET_BAUDRATE at the new rate
+   * (see baud.h). Blocks for at most timeoutMs. Everything else
+   * must be complete first.
+   */
+  bool negotiateBaud(long rate, int timeoutMs);
+
+  /* Round trip times of every opcode, or of one */
+  const LatencyHistogram &latency() const { return latencyAll; }
+  const LatencyHistogram &latency(uint8_t opcode) const;
+  void resetLatency();
+
+  /* Requests that timed out, replies that matched no request, and
+     bytes that were not a valid frame */
+  unsigned long timeouts() const { return timedOut; }
+  unsigned long unmatched() const { return strays; }
+  unsigned long frameErrors() const { return decoder.errors(); }
+
+ private:
+  struct Request {
+    uint8_t opcode;
+    uint8_t seq;
+    std::vector<uint8_t> frame;
+    BridgeCallback callback;
+    uint64_t writtenAt;   // 0 until the last byte is in the kernel
+    uint64_t streamEnd;   // bytesWritten once the frame is out
+  };
+
+  struct Completion {
+    BridgeCallback callback;
+    BridgeReply reply;
+  };
+
+  bool setBaud(long rate);
+  void admit();
+  bool flush();
+  bool receive(std::vector<Completion> *done);
+  void expire(std::vector<Completion> *done);
+  void updateEvents();
+  uint8_t nextSeq();
+  bool wheels(uint8_t opcode, const std::vector<uint8_t> &prefix, const std::vector<int16_t> &values,
+              const BridgeCallback &callback);
+
+  int fd;
+  int epfd;
+  long baud;                             // 0 when not a tty
+  bool wantWrite;
+  unsigned int maxInFlight;
+  uint64_t timeoutMicros;
+  uint8_t seqCounter;
+
+  std::deque<Request> queued;            // waiting for a slot
+  std::map<uint8_t, Request> pending;    // written, by seq
+  std::vector<uint8_t> txBuffer;
+  uint64_t bytesWritten;
+
+  BridgeFrameDecoder decoder;
+  BridgeCallback telemetryCallback;
+  BridgeCallback recorderCallback;
+
+  LatencyHistogram latencyAll;
+  std::map<uint8_t, LatencyHistogram> latencyByOpcode;
+  unsigned long timedOut;
+  unsigned long strays;
+};
+
+#endif // BRIDGE_CLIENT_H
@@ -0,0 +1,20 @@
+/***************************************************************
+   Serial port speed through termios2
+
+   <termios.h> only knows the B* constants, and 250000 baud is not
+   among them. The kernel's termios2 takes any rate (BOTHER), but
+   its struct clashes with glibc's, hence this file of its own.
+   *************************************************************/
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+int serialSetSpeed(int fd, long baud) {
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) < 0) return -1;
+  tio.c_cflag &= ~CBAUD;
+  tio.c_cflag |= BOTHER;
+  tio.c_ispeed = baud;
+  tio.c_ospeed = baud;
+  return ioctl(fd, TCSETS2, &tio);
+}
@@ -0,0 +1,402 @@
+/* *************************************************************
+   Tests for the host client library
+
+   Without arguments the client talks to a fake device on the
+   master side of a pty, which answers out of order, corrupts
+   frames and pushes telemetry on demand. With the path of a host
+   runner (rosarduinobridge_<config>, a mecanum build with binary
+   protocol) the same client also drives the real firmware over
+   the runner's --pty.
+   ************************************************************ */
+
+#include "bridge_client.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Values of a READ_ENCODERS reply (ENCODER_SNAPSHOT_SIZE) */
+#define ENCODER_COUNT 2
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long a_ = (long long)(actual), e_ = (long long)(expected); \
+    if (a_ != e_) { \
+      printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+      failures++; \
+    } \
+  } while (0)
+
+/***************************************************************
+   Fake device on a pty master
+   *************************************************************/
+
+struct FakeDevice {
+  int master;
+  std::string slave;
+  BridgeFrameDecoder decoder;
+
+  FakeDevice() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    grantpt(master);
+    unlockpt(master);
+    slave = ptsname(master);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+  }
+
+  ~FakeDevice() { close(master); }
+
+  /* Request frames that have arrived so far */
+  std::vector<std::vector<uint8_t> > receive() {
+    std::vector<std::vector<uint8_t> > frames;
+    uint8_t buf[256];
+    ssize_t n;
+    while ((n = read(master, buf, sizeof(buf))) > 0) decoder.feed(buf, n, &frames);
+    return frames;
+  }
+
+  void send(const std::vector<uint8_t> &wire) {
+    CHECK_EQ(write(master, wire.data(), wire.size()), wire.size());
+  }
+
+  void reply(uint8_t opcode, uint8_t seq, uint8_t status, const std::vector<uint8_t> &payload) {
+    std::vector<uint8_t> body;
+    body.push_back(opcode);
+    body.push_back(seq);
+    body.push_back(status);
+    body.insert(body.end(), payload.begin(), payload.end());
+    send(bridgeEncodeFrame(body));
+  }
+};
+
+static std::vector<uint8_t> int32Payload(long value) {
+  std::vector<uint8_t> p;
+  for (int b = 0; b < 4; b++) p.push_back((value >> (8 * b)) & 0xFF);
+  return p;
+}
+
+/* Let the client write its queue and the pty carry it */
+static std::vector<std::vector<uint8_t> > exchange(BridgeClient &client, FakeDevice &device) {
+  client.poll(0);
+  usleep(2000);
+  return device.receive();
+}
+
+/***************************************************************
+   Tests
+   *************************************************************/
+
+void testHistogram() {
+  LatencyHistogram h;
+  CHECK_EQ(h.percentile(50), 0);
+  for (uint64_t v = 1; v <= 1000; v++) h.record(v);
+  CHECK_EQ(h.count(), 1000);
+  CHECK_EQ(h.min(), 1);
+  CHECK_EQ(h.max(), 1000);
+  CHECK(h.mean() > 500.0 && h.mean() < 501.0);
+  uint64_t p50 = h.percentile(50), p99 = h.percentile(99);
+  CHECK(p50 >= 500 && p50 <= 500 * 9 / 8);
+  CHECK(p99 >= 990 && p99 <= 1000);
+  CHECK_EQ(h.percentile(100), 1000);
+
+  // Every value lands in a bucket that holds it, within 12.5 %
+  for (uint64_t v = 0; v < 5000000; v = v * 3 / 2 + 1) {
+    int b = LatencyHistogram::bucketOf(v);
+    CHECK(LatencyHistogram::bucketLow(b) <= v);
+    CHECK(LatencyHistogram::bucketLow(b + 1) > v);
+    CHECK(LatencyHistogram::bucketLow(b + 1) - LatencyHistogram::bucketLow(b) <= v / 8 + 1);
+  }
+}
+
+void testFraming() {
+  std::vector<uint8_t> body;
+  body.push_back(READ_ENCODERS);
+  body.push_back(0);
+  body.push_back(0);
+  body.push_back(0x12);
+  body.push_back(0);
+  std::vector<uint8_t> wire = bridgeEncodeFrame(body);
+  CHECK_EQ(wire.front(), 0);
+  CHECK_EQ(wire.back(), 0);
+  for (size_t i = 1; i + 1 < wire.size(); i++) CHECK(wire[i] != 0);
+
+  // ASCII noise before the frame is skipped and counted
+  BridgeFrameDecoder decoder;
+  std::vector<std::vector<uint8_t> > frames;
+  const char *noise = "OK\r\n";
+  decoder.feed((const uint8_t *)noise, strlen(noise), &frames);
+  decoder.feed(wire.data(), wire.size(), &frames);
+  CHECK_EQ(frames.size(), 1);
+  CHECK(frames.size() == 1 && frames[0] == body);
+  CHECK_EQ(decoder.errors(), 1);
+}
+
+void testPipelinedOutOfOrder() {
+  FakeDevice device;
+  BridgeClient client;
+  CHECK(client.open(device.slave, 115200));
+  client.setMaxInFlight(4);
+
+  long got[6];
+  for (int pin = 0; pin < 6; pin++) {
+    got[pin] = -1;
+    client.ping(pin, [&got, pin](const BridgeReply &r) {
+      CHECK_EQ(r.status, BIN_STATUS_OK);
+      got[pin] = r.values.empty() ? -2 : r.values[0];
+    });
+  }
+  CHECK_EQ(client.inFlight(), 6);
+
+  // Only four are on the wire; answer them last to first
+  std::vector<std::vector<uint8_t> > frames = exchange(client, device);
+  CHECK_EQ(frames.size(), 4);
+  for (size_t i = frames.size(); i-- > 0;) {
+    CHECK_EQ(frames[i][0], PING);
+    device.reply(PING, frames[i][1], BIN_STATUS_OK, int32Payload(frames[i][2] * 100));
+  }
+  usleep(2000);
+  CHECK_EQ(client.poll(100), 4);
+  for (int pin = 0; pin < 4; pin++) CHECK_EQ(got[pin], pin * 100);
+
+  // The freed slots took the rest
+  frames = exchange(client, device);
+  CHECK_EQ(frames.size(), 2);
+  for (size_t i = 0; i < frames.size(); i++) {
+    device.reply(PING, frames[i][1], BIN_STATUS_OK, int32Payload(frames[i][2] * 100));
+  }
+  CHECK(client.wait(200));
+  CHECK_EQ(got[4], 400);
+  CHECK_EQ(got[5], 500);
+  CHECK_EQ(client.latency().count(), 6);
+  CHECK_EQ(client.latency(PING).count(), 6);
+  CHECK_EQ(client.latency(READ_ENCODERS).count(), 0);
+  CHECK_EQ(client.unmatched(), 0);
+}
+
+void testTimeoutAndStrays() {
+  FakeDevice device;
+  BridgeClient client;
+  CHECK(client.open(device.slave, 115200));
+  client.setTimeout(20);
+
+  int status = 0;
+  client.readEncoders([&status](const BridgeReply &r) { status = r.status; });
+  std::vector<std::vector<uint8_t> > frames = exchange(client, device);
+  CHECK_EQ(frames.size(), 1);
+  uint8_t seq = frames.empty() ? 0 : frames[0][1];
+
+  // A reply with a broken CRC is never matched
+  std::vector<uint8_t> body;
+  body.push_back(READ_ENCODERS);
+  body.push_back(seq);
+  body.push_back(BIN_STATUS_OK);
+  std::vector<uint8_t> wire = bridgeEncodeFrame(body);
+  wire[2] ^= 0x40;
+  device.send(wire);
+
+  CHECK(client.wait(500));
+  CHECK_EQ(status, BRIDGE_STATUS_TIMEOUT);
+  CHECK_EQ(client.timeouts(), 1);
+  CHECK_EQ(client.frameErrors(), 1);
+
+  // The real reply turning up late matches nothing
+  device.reply(READ_ENCODERS, seq, BIN_STATUS_OK, int32Payload(1));
+  usleep(2000);
+  client.poll(10);
+  CHECK_EQ(client.unmatched(), 1);
+
+  // A blocking call on the same link
+  BridgeReply reply;
+  client.setTimeout(200);
+  CHECK(!client.call(GET_BAUDRATE, std::vector<uint8_t>(), &reply, 30));
+  CHECK_EQ(reply.status, BRIDGE_STATUS_TIMEOUT);
+}
+
+void testTelemetry() {
+  FakeDevice device;
+  BridgeClient client;
+  CHECK(client.open(device.slave, 115200));
+
+  int samples = 0, acks = 0;
+  client.onTelemetry([&samples](const BridgeReply &r) {
+    CHECK_EQ(r.seq, samples);
+    CHECK_EQ(r.payload.size(), 12);
+    samples++;
+  });
+  client.telemetry(1, 1, 0, [&acks](const BridgeReply &r) {
+    CHECK_EQ(r.status, BIN_STATUS_OK);
+    acks++;
+  });
+  // A second subscription waits until the first one is answered
+  client.telemetry(0, 1, 0, [&acks](const BridgeReply &) { acks++; });
+
+  std::vector<std::vector<uint8_t> > frames = exchange(client, device);
+  CHECK_EQ(frames.size(), 1);
+  uint8_t seq = frames.empty() ? 0 : frames[0][1];
+
+  // Samples count their own seq from 0, whatever the request's was
+  device.reply(TELEMETRY, seq, BIN_STATUS_OK, std::vector<uint8_t>());
+  for (uint8_t s = 0; s < 3; s++) device.reply(TELEMETRY, s, BIN_STATUS_OK, std::vector<uint8_t>(12, 1));
+  usleep(2000);
+  client.poll(50);
+  CHECK_EQ(acks, 1);
+  CHECK_EQ(samples, 3);
+
+  frames = exchange(client, device);
+  CHECK_EQ(frames.size(), 1);
+  if (!frames.empty()) device.reply(TELEMETRY, frames[0][1], BIN_STATUS_OK, std::vector<uint8_t>());
+  CHECK(client.wait(200));
+  CHECK_EQ(acks, 2);
+}
+
+/***************************************************************
+   Against the firmware in the host runner
+   *************************************************************/
+
+static pid_t startRunner(const char *runner, std::string *pty) {
+  int out[2];
+  if (pipe(out) < 0) return -1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(out[1], 2);
+    close(out[0]);
+    execl(runner, runner, "--pty", (char *)NULL);
+    _exit(127);
+  }
+  close(out[1]);
+
+  // The runner prints the pty path on stderr
+  char c;
+  struct pollfd pfd = { out[0], POLLIN, 0 };
+  while (::poll(&pfd, 1, 5000) > 0 && read(out[0], &c, 1) == 1 && c != '\n') *pty += c;
+  close(out[0]);
+  return pid;
+}
+
+void testFirmware(const char *runner) {
+  std::string pty;
+  pid_t pid = startRunner(runner, &pty);
+  CHECK(pid > 0);
+  CHECK(!pty.empty());
+
+  BridgeClient client;
+  CHECK(client.open(pty, 115200));
+  client.setTimeout(500);
+
+  // Many requests in flight, matched by seq
+  int ok = 0;
+  for (int i = 0; i < 32; i++) {
+    client.readEncoders([&ok](const BridgeReply &r) {
+      if (r.status == BIN_STATUS_OK && r.values.size() == ENCODER_COUNT) ok++;
+    });
+  }
+  CHECK(client.wait(3000));
+  CHECK_EQ(ok, 32);
+  CHECK_EQ(client.latency(READ_ENCODERS).count(), 32);
+
+  // Typed requests with arguments; the runner is a mecanum build
+  BridgeReply reply;
+  std::vector<int16_t> speeds(4, 10);
+  int status = -2, queuedPoints = -1;
+  client.motorSpeeds(speeds, [&status](const BridgeReply &r) { status = r.status; });
+  client.setpointQueue(5, speeds, [&queuedPoints](const BridgeReply &r) {
+    if (r.values.size() == 1) queuedPoints = r.values[0];
+  });
+  client.motorRawPwm(std::vector<int16_t>(4, 0));
+  CHECK(client.wait(1000));
+  CHECK_EQ(status, BIN_STATUS_OK);
+  CHECK_EQ(queuedPoints, 1);
+
+  client.motorSpeeds(std::vector<int16_t>(2, 0), [&status](const BridgeReply &r) { status = r.status; });
+  CHECK(client.wait(1000));
+  CHECK_EQ(status, BIN_STATUS_BAD_LENGTH);
+
+  CHECK(client.call(READ_ODOMETRY, std::vector<uint8_t>(1, 0), &reply, 1000));
+  CHECK_EQ(reply.values.size(), 3);
+
+  // Telemetry alongside requests
+  int samples = 0;
+  client.onTelemetry([&samples](const BridgeReply &) { samples++; });
+  client.telemetry(1, 1, 0);
+  for (int i = 0; i < 100 && samples < 5; i++) client.poll(10);
+  CHECK(samples >= 5);
+  client.telemetry(0, 1, 0);
+  CHECK(client.wait(1000));
+
+  // Stored configuration, one value at a time
+  long homeRate = 0;
+  client.configValue(CONFIG_GET, CONFIG_KEY_BAUD, 0, [&homeRate](const BridgeReply &r) {
+    if (r.values.size() == 1) homeRate = r.values[0];
+  });
+  CHECK(client.wait(1000));
+  CHECK_EQ(homeRate, 115200);
+
+  // Control loop rate: 0 asks, anything else sets
+  long loopRate = 0;
+  client.controlRate(500, [&loopRate](const BridgeReply &r) {
+    if (r.values.size() == 1) loopRate = r.values[0];
+  });
+  CHECK(client.wait(1000));
+  CHECK_EQ(loopRate, 500);
+  client.controlRate(0, [&loopRate](const BridgeReply &r) {
+    if (r.values.size() == 1) loopRate = r.values[0];
+  });
+  CHECK(client.wait(1000));
+  CHECK_EQ(loopRate, 500);
+
+  // Flight recorder: the dump's frames follow its reply
+  long records = 0;
+  size_t dumped = 0;
+  client.onRecorder([&dumped](const BridgeReply &r) { dumped += r.payload.size(); });
+  client.recorder(1, [&records](const BridgeReply &r) {
+    if (r.values.size() == 1) records = r.values[0];
+  });
+  CHECK(client.wait(1000));
+  for (int i = 0; i < 30; i++) client.poll(10);
+  CHECK(records > 0);
+  CHECK(dumped > 0 && dumped % records == 0);
+  client.recorder(2, BridgeCallback());
+  CHECK(client.wait(1000));
+
+  // Faster link, confirmed at the new rate
+  CHECK(client.negotiateBaud(1000000, 500));
+  CHECK(client.call(GET_BAUDRATE, std::vector<uint8_t>(), &reply, 1000));
+  CHECK(reply.values.size() == 1 && reply.values[0] == 1000000);
+
+  client.close();
+  if (pid > 0) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+  }
+}
+
+int main(int argc, char **argv) {
+  signal(SIGPIPE, SIG_IGN);
+  if (argc > 1) {
+    testFirmware(argv[1]);
+  } else {
+    testHistogram();
+    testFraming();
+    testPipelinedOutOfOrder();
+    testTimeoutAndStrays();
+    testTelemetry();
+  }
+  if (failures) printf("%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
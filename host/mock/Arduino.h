@@ -0,0 +1,133 @@
+/***************************************************************
+   Mock Arduino core for host builds
+
+   Just enough of the AVR Arduino API for the ROSArduinoBridge
+   sources to compile and run on Linux. Time is virtual and only
+   moves when the test (or the realtime host runner) advances it,
+   pin writes are recorded, and the AVR registers used by the
+   encoder ISRs are plain variables whose pin-change interrupts
+   are emulated by the mock_* helpers in mock_control.h.
+   *************************************************************/
+
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "avr/io.h"
+#include "avr/interrupt.h"
+#include "avr/pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define PI 3.1415926535897932384626433832795
+
+/* Analog pin numbers of an ATmega328P board */
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define NUM_DIGITAL_PINS 22
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+template <typename T, typename U> inline T min(T a, U b) { return (b < a) ? b : a; }
+template <typename T, typename U> inline T max(T a, U b) { return (a < b) ? b : a; }
+
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+
+/* Port and pin-change lookups, as in the ATmega328P variant */
+#define PB 2
+#define PC 3
+#define PD 4
+#define digitalPinToPort(p)     ((p) < 8 ? PD : ((p) < 14 ? PB : PC))
+#define digitalPinToBitMask(p)  (1 << ((p) < 8 ? (p) : ((p) < 14 ? (p) - 8 : (p) - 14)))
+#define portInputRegister(P)    ((P) == PB ? &PINB : ((P) == PC ? &PINC : &PIND))
+#define digitalPinToPCICR(p)    ((p) <= 19 ? (&PCICR) : ((volatile uint8_t *)0))
+#define digitalPinToPCICRbit(p) ((p) <= 7 ? 2 : ((p) <= 13 ? 0 : 1))
+#define digitalPinToPCMSK(p)    ((p) <= 7 ? (&PCMSK2) : ((p) <= 13 ? (&PCMSK0) : ((p) <= 19 ? (&PCMSK1) : ((volatile uint8_t *)0))))
+#define digitalPinToPCMSKbit(p) ((p) <= 7 ? (p) : ((p) <= 13 ? (p) - 8 : (p) - 14))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+#define noInterrupts() cli()
+#define interrupts() sei()
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+/* Serial port backed by in-memory queues (see mock_control.h) */
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int availableForWrite();
+    int peek();
+    int read();
+    void flush();
+    size_t write(uint8_t b);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void);
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+void setup(void);
+void loop(void);
+
+#endif // MOCK_ARDUINO_H
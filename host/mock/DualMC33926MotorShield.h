@@ -0,0 +1,22 @@
+/* Mock of Pololu's DualMC33926MotorShield library for host builds:
+   no pins, the shield keeps the speeds it was given last for the
+   tests to read. */
+
+#ifndef MOCK_DUAL_MC33926_MOTOR_SHIELD_H
+#define MOCK_DUAL_MC33926_MOTOR_SHIELD_H
+
+class DualMC33926MotorShield {
+ public:
+  DualMC33926MotorShield() : m1Speed(0), m2Speed(0), initialized(false) {}
+
+  void init() { initialized = true; }
+  void setM1Speed(int speed) { m1Speed = speed; }
+  void setM2Speed(int speed) { m2Speed = speed; }
+  void setSpeeds(int m1, int m2) { m1Speed = m1; m2Speed = m2; }
+
+  int m1Speed;
+  int m2Speed;
+  bool initialized;
+};
+
+#endif // MOCK_DUAL_MC33926_MOTOR_SHIELD_H
@@ -0,0 +1,20 @@
+/* Mock of Robogaia's MegaEncoderCounter library for host builds:
+   the two axis counters are plain members the tests move. */
+
+#ifndef MOCK_MEGA_ENCODER_COUNTER_H
+#define MOCK_MEGA_ENCODER_COUNTER_H
+
+class MegaEncoderCounter {
+ public:
+  explicit MegaEncoderCounter(unsigned char countMode) : x(0), y(0) { (void)countMode; }
+
+  unsigned long XAxisGetCount() { return x; }
+  unsigned long YAxisGetCount() { return y; }
+  void XAxisReset() { x = 0; }
+  void YAxisReset() { y = 0; }
+
+  long x;
+  long y;
+};
+
+#endif // MOCK_MEGA_ENCODER_COUNTER_H
@@ -0,0 +1,16 @@
+/* Mock of avr-libc's EEPROM access for host builds. The 1 KB of an
+   ATmega328P live in the mock core and keep their contents across
+   mock_reset(), like the real part across a reboot. */
+
+#ifndef MOCK_AVR_EEPROM_H
+#define MOCK_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif // MOCK_AVR_EEPROM_H
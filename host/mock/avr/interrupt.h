@@ -0,0 +1,24 @@
+/* Mock interrupt control for host builds
+
+   ISR() bodies become plain extern "C" functions that the mock core
+   invokes when a test changes a pin or advances virtual time. The
+   global interrupt flag lives in SREG so cli()/sei() and
+   ATOMIC_BLOCK behave as on the target: interrupts raised while it
+   is clear are held pending and delivered by the next sei(). */
+
+#ifndef MOCK_AVR_INTERRUPT_H
+#define MOCK_AVR_INTERRUPT_H
+
+#include "avr/io.h"
+
+#define PCINT0_vect       mock_vector_pcint0
+#define PCINT1_vect       mock_vector_pcint1
+#define PCINT2_vect       mock_vector_pcint2
+#define TIMER2_COMPA_vect mock_vector_timer2_compa
+
+#define ISR(vector, ...) extern "C" void vector(void)
+
+void cli(void);
+void sei(void);
+
+#endif // MOCK_AVR_INTERRUPT_H
@@ -0,0 +1,70 @@
+/* Mock ATmega328P register file for host builds */
+
+#ifndef MOCK_AVR_IO_H
+#define MOCK_AVR_IO_H
+
+#include <stdint.h>
+
+/* The MCU this register file models */
+#define __AVR_ATmega328P__
+
+extern volatile uint8_t SREG;
+
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t OCR1A, OCR1B;
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2;
+
+#define SREG_I 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+
+#define WGM20 0
+#define WGM21 1
+#define WGM22 3
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define OCIE2A 1
+#define OCIE2B 2
+#define TOIE2 0
+
+#define COM0B1 5
+#define COM0A1 7
+#define COM1B1 5
+#define COM1A1 7
+#define COM2B1 5
+#define COM2A1 7
+
+#define _BV(bit) (1 << (bit))
+
+#endif // MOCK_AVR_IO_H
@@ -0,0 +1,559 @@
+/***************************************************************
+   Mock Arduino core implementation for host builds
+   *************************************************************/
+
+#include "Arduino.h"
+#include "mock_control.h"
+#include "avr/eeprom.h"
+
+#include <deque>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ISR bodies provided by the firmware (weak: a configuration may
+   not define them) */
+extern "C" {
+  void mock_vector_pcint0(void) __attribute__((weak));
+  void mock_vector_pcint1(void) __attribute__((weak));
+  void mock_vector_pcint2(void) __attribute__((weak));
+  void mock_vector_timer2_compa(void) __attribute__((weak));
+}
+
+volatile uint8_t SREG = (1 << SREG_I);
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t OCR1A, OCR1B;
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2;
+
+HardwareSerial Serial;
+
+namespace {
+
+const size_t SERIAL_BUFFER_SIZE = 64;
+
+enum Vector { VEC_PCINT0, VEC_PCINT1, VEC_PCINT2, VEC_TIMER2_COMPA, VEC_COUNT };
+
+struct MockState {
+  uint32_t now;
+  uint32_t nextTimer2;
+  bool timer2Armed;
+  uint8_t pending;
+
+  uint8_t pinModes[NUM_DIGITAL_PINS];
+  int analogInputs[NUM_DIGITAL_PINS];
+  unsigned long pulseWidths[NUM_DIGITAL_PINS];
+  unsigned long digitalWrites;
+  unsigned long analogWrites;
+  void (*extInterrupts[2])(void);
+
+  std::deque<uint8_t> rx;
+  size_t rxDropped;
+  std::string tx;
+  unsigned long baud;
+  bool txPacing;
+  uint32_t txDrainedAt;
+  size_t txQueued;
+  uint32_t txStall;
+
+  int rxFd = -1;
+  int txFd = -1;
+  bool realtime;
+  struct timespec wallStart;
+  uint32_t virtualStart;
+};
+
+MockState mock;
+
+/* Non-volatile: outside MockState so mock_reset() keeps it */
+struct MockEeprom {
+  uint8_t data[E2END + 1];
+  unsigned long reads;
+  unsigned long writes;
+  MockEeprom() { mock_eeprom_erase(); }
+};
+
+MockEeprom eeprom;
+
+void deliver(int vec) {
+  switch (vec) {
+    case VEC_PCINT0: if (mock_vector_pcint0) mock_vector_pcint0(); break;
+    case VEC_PCINT1: if (mock_vector_pcint1) mock_vector_pcint1(); break;
+    case VEC_PCINT2: if (mock_vector_pcint2) mock_vector_pcint2(); break;
+    case VEC_TIMER2_COMPA: if (mock_vector_timer2_compa) mock_vector_timer2_compa(); break;
+  }
+}
+
+/* Run an ISR the way the AVR does: with the I flag cleared for its
+   duration unless the body re-enables it. */
+void raise(int vec) {
+  if (!(SREG & (1 << SREG_I))) {
+    mock.pending |= (1 << vec);
+    return;
+  }
+  SREG &= ~(1 << SREG_I);
+  deliver(vec);
+  SREG |= (1 << SREG_I);
+}
+
+uint32_t timer2Period() {
+  static const uint16_t prescale[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+  uint16_t p = prescale[TCCR2B & 7];
+  if (p == 0) return 0;
+  uint32_t period = ((uint32_t)OCR2A + 1) * p / 16;
+  return period ? period : 1;
+}
+
+void serviceTimers(uint32_t target) {
+  for (;;) {
+    uint32_t period = timer2Period();
+    bool enabled = period && (TIMSK2 & (1 << OCIE2A));
+    if (!enabled) {
+      mock.timer2Armed = false;
+      mock.now = target;
+      return;
+    }
+    if (!mock.timer2Armed) {
+      mock.timer2Armed = true;
+      mock.nextTimer2 = mock.now + period;
+    }
+    if ((int32_t)(target - mock.nextTimer2) < 0) {
+      mock.now = target;
+      return;
+    }
+    mock.now = mock.nextTimer2;
+    mock.nextTimer2 += period;
+    raise(VEC_TIMER2_COMPA);
+  }
+}
+
+volatile uint8_t *portFor(uint8_t pin, uint8_t *bit) {
+  if (pin < 8) { *bit = pin; return &PORTD; }
+  if (pin < 14) { *bit = pin - 8; return &PORTB; }
+  *bit = pin - 14;
+  return &PORTC;
+}
+
+volatile uint8_t *inputFor(uint8_t pin, uint8_t *bit) {
+  if (pin < 8) { *bit = pin; return &PIND; }
+  if (pin < 14) { *bit = pin - 8; return &PINB; }
+  *bit = pin - 14;
+  return &PINC;
+}
+
+/* PWM compare output of a pin: control register, COM bit, OCR value */
+bool pwmFor(uint8_t pin, volatile uint8_t **tccr, uint8_t *com, uint16_t *ocr) {
+  switch (pin) {
+    case 3:  *tccr = &TCCR2A; *com = COM2B1; *ocr = OCR2B; return true;
+    case 5:  *tccr = &TCCR0A; *com = COM0B1; *ocr = OCR0B; return true;
+    case 6:  *tccr = &TCCR0A; *com = COM0A1; *ocr = OCR0A; return true;
+    case 9:  *tccr = &TCCR1A; *com = COM1A1; *ocr = OCR1A; return true;
+    case 10: *tccr = &TCCR1A; *com = COM1B1; *ocr = OCR1B; return true;
+    case 11: *tccr = &TCCR2A; *com = COM2A1; *ocr = OCR2A; return true;
+  }
+  return false;
+}
+
+void setPinChange(volatile uint8_t *reg, uint8_t value, volatile uint8_t *mask, uint8_t pcie, int vec) {
+  uint8_t changed = *reg ^ value;
+  *reg = value;
+  if ((PCICR & (1 << pcie)) && (changed & *mask)) raise(vec);
+}
+
+uint32_t wallMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((ts.tv_sec - mock.wallStart.tv_sec) * 1000000L +
+                    (ts.tv_nsec - mock.wallStart.tv_nsec) / 1000L);
+}
+
+/* Bytes still sitting in the emulated TX buffer */
+void drainTx() {
+  if (!mock.txPacing || mock.baud == 0) {
+    mock.txQueued = 0;
+    return;
+  }
+  uint32_t byteTime = 10000000UL / mock.baud;
+  if (byteTime == 0) byteTime = 1;
+  while (mock.txQueued > 0 && (int32_t)(mock.now - mock.txDrainedAt) >= (int32_t)byteTime) {
+    mock.txQueued--;
+    mock.txDrainedAt += byteTime;
+  }
+  if (mock.txQueued == 0) mock.txDrainedAt = mock.now;
+}
+
+void writeLevel(uint8_t pin, uint8_t val);
+
+} // namespace
+
+/***************************************************************
+   Control API
+   *************************************************************/
+
+void mock_reset() {
+  int rxFd = mock.rxFd, txFd = mock.txFd;
+  mock = MockState();
+  mock.rxFd = rxFd;
+  mock.txFd = txFd;
+  SREG = (1 << SREG_I);
+  PINB = PINC = PIND = 0;
+  PORTB = PORTC = PORTD = 0;
+  DDRB = DDRC = DDRD = 0;
+  PCICR = PCIFR = PCMSK0 = PCMSK1 = PCMSK2 = 0;
+  TCCR0A = TCCR0B = OCR0A = OCR0B = TIMSK0 = 0;
+  TCCR1A = TCCR1B = TIMSK1 = 0;
+  OCR1A = OCR1B = 0;
+  TCCR2A = TCCR2B = TCNT2 = OCR2A = OCR2B = TIMSK2 = 0;
+}
+
+void mock_set_micros(uint32_t us) { mock.now = us; mock.timer2Armed = false; }
+void mock_advance_micros(uint32_t us) { serviceTimers(mock.now + us); }
+
+size_t mock_serial_feed(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  size_t accepted = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (mock.rx.size() < SERIAL_BUFFER_SIZE - 1) {
+      mock.rx.push_back(p[i]);
+      accepted++;
+    } else {
+      mock.rxDropped++;
+    }
+  }
+  return accepted;
+}
+
+size_t mock_serial_feed(const std::string &s) { return mock_serial_feed(s.data(), s.size()); }
+size_t mock_serial_rx_dropped() { return mock.rxDropped; }
+size_t mock_serial_rx_pending() { return mock.rx.size(); }
+
+std::string mock_serial_take_output() {
+  std::string out;
+  out.swap(mock.tx);
+  return out;
+}
+
+unsigned long mock_serial_baud() { return mock.baud; }
+
+void mock_serial_set_tx_pacing(bool enabled) {
+  mock.txPacing = enabled;
+  mock.txQueued = 0;
+  mock.txDrainedAt = mock.now;
+}
+
+uint32_t mock_serial_tx_stall_micros() { return mock.txStall; }
+
+uint8_t mock_pin_mode(uint8_t pin) { return pin < NUM_DIGITAL_PINS ? mock.pinModes[pin] : 0; }
+
+int mock_digital_level(uint8_t pin) {
+  uint8_t bit;
+  volatile uint8_t *port = portFor(pin, &bit);
+  return (*port >> bit) & 1;
+}
+
+int mock_pwm_value(uint8_t pin) {
+  volatile uint8_t *tccr;
+  uint8_t com;
+  uint16_t ocr;
+  if (pwmFor(pin, &tccr, &com, &ocr) && (*tccr & (1 << com))) return ocr;
+  return mock_digital_level(pin) ? 255 : 0;
+}
+
+void mock_set_analog_input(uint8_t pin, int value) {
+  if (pin < NUM_DIGITAL_PINS) mock.analogInputs[pin] = value;
+}
+
+void mock_set_digital_input(uint8_t pin, int level) {
+  uint8_t bit;
+  volatile uint8_t *in = inputFor(pin, &bit);
+  uint8_t value = level ? (*in | (1 << bit)) : (*in & ~(1 << bit));
+  if (in == &PIND) mock_set_pind(value);
+  else if (in == &PINB) mock_set_pinb(value);
+  else mock_set_pinc(value);
+}
+
+void mock_set_pulse_width(uint8_t pin, unsigned long us) {
+  if (pin < NUM_DIGITAL_PINS) mock.pulseWidths[pin] = us;
+}
+
+unsigned long mock_digital_write_calls() { return mock.digitalWrites; }
+unsigned long mock_analog_write_calls() { return mock.analogWrites; }
+
+void mock_set_pinb(uint8_t value) { setPinChange(&PINB, value, &PCMSK0, PCIE0, VEC_PCINT0); }
+void mock_set_pinc(uint8_t value) { setPinChange(&PINC, value, &PCMSK1, PCIE1, VEC_PCINT1); }
+void mock_set_pind(uint8_t value) { setPinChange(&PIND, value, &PCMSK2, PCIE2, VEC_PCINT2); }
+
+void mock_fire_interrupt(uint8_t interruptNum) {
+  if (interruptNum >= 2 || !mock.extInterrupts[interruptNum]) return;
+  if (!(SREG & (1 << SREG_I))) return;
+  SREG &= ~(1 << SREG_I);
+  mock.extInterrupts[interruptNum]();
+  SREG |= (1 << SREG_I);
+}
+
+void mock_serial_attach_fd(int rxFd, int txFd) {
+  mock.rxFd = rxFd;
+  mock.txFd = txFd;
+}
+
+void mock_set_realtime(bool enabled) {
+  mock.realtime = enabled;
+  clock_gettime(CLOCK_MONOTONIC, &mock.wallStart);
+  mock.virtualStart = mock.now;
+}
+
+bool mock_poll() {
+  if (mock.realtime) {
+    uint32_t target = mock.virtualStart + wallMicros();
+    if ((int32_t)(target - mock.now) > 0) serviceTimers(target);
+  }
+  if (mock.txFd >= 0 && !mock.tx.empty()) {
+    ssize_t n = ::write(mock.txFd, mock.tx.data(), mock.tx.size());
+    if (n > 0) mock.tx.erase(0, n);
+  }
+  if (mock.rxFd >= 0) {
+    uint8_t buf[SERIAL_BUFFER_SIZE];
+    size_t room = SERIAL_BUFFER_SIZE - 1 - mock.rx.size();
+    if (room > 0) {
+      ssize_t n = ::read(mock.rxFd, buf, room);
+      if (n == 0) return false;
+      for (ssize_t i = 0; i < n; i++) mock.rx.push_back(buf[i]);
+    }
+  }
+  return true;
+}
+
+void mock_eeprom_erase() {
+  memset(eeprom.data, 0xFF, sizeof(eeprom.data));
+  eeprom.reads = eeprom.writes = 0;
+}
+
+uint8_t *mock_eeprom_data() { return eeprom.data; }
+unsigned long mock_eeprom_reads() { return eeprom.reads; }
+unsigned long mock_eeprom_writes() { return eeprom.writes; }
+
+/***************************************************************
+   Arduino API
+   *************************************************************/
+
+void cli(void) { SREG &= ~(1 << SREG_I); }
+
+void sei(void) {
+  SREG |= (1 << SREG_I);
+  while (mock.pending && (SREG & (1 << SREG_I))) {
+    for (int vec = 0; vec < VEC_COUNT; vec++) {
+      if (mock.pending & (1 << vec)) {
+        mock.pending &= ~(1 << vec);
+        raise(vec);
+      }
+    }
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= NUM_DIGITAL_PINS) return;
+  mock.pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= NUM_DIGITAL_PINS) return;
+  mock.digitalWrites++;
+  writeLevel(pin, val);
+}
+
+namespace {
+
+void writeLevel(uint8_t pin, uint8_t val) {
+  volatile uint8_t *tccr;
+  uint8_t com;
+  uint16_t ocr;
+  if (pwmFor(pin, &tccr, &com, &ocr)) *tccr &= ~(1 << com);
+  uint8_t bit;
+  volatile uint8_t *port = portFor(pin, &bit);
+  if (val == LOW) *port &= ~(1 << bit);
+  else *port |= (1 << bit);
+}
+
+} // namespace
+
+int digitalRead(uint8_t pin) {
+  if (pin >= NUM_DIGITAL_PINS) return LOW;
+  uint8_t bit;
+  volatile uint8_t *in = inputFor(pin, &bit);
+  return (*in >> bit) & 1;
+}
+
+/* A conversion takes 13 cycles of the core's 125 kHz ADC clock,
+   with the interrupts going on meanwhile */
+int analogRead(uint8_t pin) {
+  mock_advance_micros(104);
+  if (pin < 14) pin += 14;  /* channel numbers map onto A0.. */
+  return pin < NUM_DIGITAL_PINS ? mock.analogInputs[pin] : 0;
+}
+
+/* Same decisions as the AVR core's wiring_analog.c */
+void analogWrite(uint8_t pin, int val) {
+  if (pin >= NUM_DIGITAL_PINS) return;
+  mock.analogWrites++;
+  mock.pinModes[pin] = OUTPUT;
+  volatile uint8_t *tccr;
+  uint8_t com;
+  uint16_t ocr;
+  if (val <= 0) {
+    writeLevel(pin, LOW);
+  } else if (val >= 255) {
+    writeLevel(pin, HIGH);
+  } else if (pwmFor(pin, &tccr, &com, &ocr)) {
+    *tccr |= (1 << com);
+    switch (pin) {
+      case 3:  OCR2B = val; break;
+      case 5:  OCR0B = val; break;
+      case 6:  OCR0A = val; break;
+      case 9:  OCR1A = val; break;
+      case 10: OCR1B = val; break;
+      case 11: OCR2A = val; break;
+    }
+  } else {
+    writeLevel(pin, val < 128 ? LOW : HIGH);
+  }
+}
+
+unsigned long micros(void) { return mock.now; }
+unsigned long millis(void) { return mock.now / 1000UL; }
+void delay(unsigned long ms) { mock_advance_micros(ms * 1000UL); }
+void delayMicroseconds(unsigned int us) { mock_advance_micros(us); }
+
+unsigned long pulseIn(uint8_t pin, uint8_t, unsigned long timeout) {
+  unsigned long width = pin < NUM_DIGITAL_PINS ? mock.pulseWidths[pin] : 0;
+  if (width == 0 || width > timeout) {
+    mock_advance_micros(timeout);
+    return 0;
+  }
+  mock_advance_micros(width);
+  return width;
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int) {
+  if (interruptNum < 2) mock.extInterrupts[interruptNum] = userFunc;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  if (interruptNum < 2) mock.extInterrupts[interruptNum] = 0;
+}
+
+/***************************************************************
+   EEPROM
+   *************************************************************/
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+  size_t addr = (size_t)src;
+  if (addr + n > sizeof(eeprom.data)) return;
+  memcpy(dst, &eeprom.data[addr], n);
+  eeprom.reads++;
+}
+
+/* Only bytes that differ are written, each taking the 3.4 ms of an
+   erase-and-write cycle while the interrupts go on */
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+  size_t addr = (size_t)dst;
+  if (addr + n > sizeof(eeprom.data)) return;
+  const uint8_t *bytes = (const uint8_t *)src;
+  for (size_t i = 0; i < n; i++) {
+    if (eeprom.data[addr + i] == bytes[i]) continue;
+    mock_advance_micros(3400);
+    eeprom.data[addr + i] = bytes[i];
+    eeprom.writes++;
+  }
+}
+
+/***************************************************************
+   Serial
+   *************************************************************/
+
+void HardwareSerial::begin(unsigned long baud) {
+  mock.baud = baud;
+  mock.txQueued = 0;
+  mock.txDrainedAt = mock.now;
+}
+
+void HardwareSerial::end() {}
+
+int HardwareSerial::available() { return (int)mock.rx.size(); }
+
+int HardwareSerial::availableForWrite() {
+  drainTx();
+  return (int)(SERIAL_BUFFER_SIZE - 1 - mock.txQueued);
+}
+
+int HardwareSerial::peek() { return mock.rx.empty() ? -1 : mock.rx.front(); }
+
+int HardwareSerial::read() {
+  if (mock.rx.empty()) return -1;
+  uint8_t b = mock.rx.front();
+  mock.rx.pop_front();
+  return b;
+}
+
+void HardwareSerial::flush() {
+  if (!mock.txPacing) return;
+  uint32_t start = mock.now;
+  while (drainTx(), mock.txQueued > 0) mock_advance_micros(10);
+  mock.txStall += mock.now - start;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  if (mock.txPacing) {
+    drainTx();
+    uint32_t start = mock.now;
+    while (mock.txQueued >= SERIAL_BUFFER_SIZE - 1) {
+      mock_advance_micros(10);
+      drainTx();
+    }
+    mock.txStall += mock.now - start;
+    mock.txQueued++;
+  }
+  mock.tx.push_back((char)b);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) write(buffer[i]);
+  return size;
+}
+
+size_t HardwareSerial::print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+size_t HardwareSerial::print(char c) { return write((uint8_t)c); }
+
+size_t HardwareSerial::print(long n, int base) {
+  if (base == DEC && n < 0) {
+    size_t t = print('-');
+    return t + print((unsigned long)(-(n + 1)) + 1UL, base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = '\0';
+  if (base < 2) base = 10;
+  do {
+    unsigned long d = n % base;
+    n /= base;
+    *--p = d < 10 ? '0' + d : 'A' + d - 10;
+  } while (n);
+  return print(p);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t HardwareSerial::println(void) { return print("\r\n"); }
@@ -0,0 +1,76 @@
+/***************************************************************
+   Test-side controls of the mock Arduino core
+
+   Host tests, benchmarks and the realtime runner use these to
+   drive virtual time, inject serial input and pin levels, and
+   inspect what the firmware wrote.
+   *************************************************************/
+
+#ifndef MOCK_CONTROL_H
+#define MOCK_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/* Reset every register, pin, queue and the clock to power-on state */
+void mock_reset();
+
+/* Virtual time. Advancing fires due timer interrupts on the way. */
+void mock_set_micros(uint32_t us);
+void mock_advance_micros(uint32_t us);
+
+/* Serial RX: bytes land in a 64-byte hardware buffer like the AVR
+   core's; anything that does not fit is dropped and counted. */
+size_t mock_serial_feed(const void *data, size_t len);
+size_t mock_serial_feed(const std::string &s);
+size_t mock_serial_rx_dropped();
+size_t mock_serial_rx_pending();
+
+/* Serial TX: every byte the firmware wrote, in order */
+std::string mock_serial_take_output();
+unsigned long mock_serial_baud();
+
+/* With TX pacing enabled the 64-byte TX buffer drains at the
+   configured baud rate in virtual time, so availableForWrite()
+   shrinks and a write into a full buffer stalls the caller. */
+void mock_serial_set_tx_pacing(bool enabled);
+uint32_t mock_serial_tx_stall_micros();
+
+/* Pins. Digital levels come from the PORT/PIN registers, so writes
+   through digitalWrite() and direct register writes look alike. */
+uint8_t mock_pin_mode(uint8_t pin);
+int mock_digital_level(uint8_t pin);
+int mock_pwm_value(uint8_t pin);
+void mock_set_analog_input(uint8_t pin, int value);
+void mock_set_digital_input(uint8_t pin, int level);
+void mock_set_pulse_width(uint8_t pin, unsigned long us);
+unsigned long mock_digital_write_calls();
+unsigned long mock_analog_write_calls();
+
+/* Input port registers; changed bits raise the matching PCINT
+   vector when enabled in PCICR/PCMSKn. */
+void mock_set_pinb(uint8_t value);
+void mock_set_pinc(uint8_t value);
+void mock_set_pind(uint8_t value);
+
+/* External interrupts registered with attachInterrupt() */
+void mock_fire_interrupt(uint8_t interruptNum);
+
+/* EEPROM: erased (0xFF) at start-up and untouched by mock_reset().
+   The counters are of eeprom_read_block() calls and of bytes whose
+   value an eeprom_update_block() changed. */
+void mock_eeprom_erase();
+uint8_t *mock_eeprom_data();
+unsigned long mock_eeprom_reads();
+unsigned long mock_eeprom_writes();
+
+/* Realtime runner: bind Serial to a file descriptor (stdin/stdout
+   or a pty) and let virtual time follow the wall clock. mock_poll()
+   moves bytes between the fds and Serial and returns false once the
+   RX fd has reached end of file. */
+void mock_serial_attach_fd(int rxFd, int txFd);
+void mock_set_realtime(bool enabled);
+bool mock_poll();
+
+#endif // MOCK_CONTROL_H
@@ -0,0 +1,17 @@
+/* Mock of avr-libc's ATOMIC_BLOCK for host builds */
+
+#ifndef MOCK_UTIL_ATOMIC_H
+#define MOCK_UTIL_ATOMIC_H
+
+#include "avr/interrupt.h"
+
+static inline uint8_t mock_atomic_enter(void) { uint8_t s = SREG; cli(); return s; }
+static inline void mock_atomic_restore(const uint8_t *s) { if (*s & (1 << SREG_I)) sei(); }
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) \
+  for (uint8_t mock_sreg_save __attribute__((cleanup(mock_atomic_restore))) = mock_atomic_enter(), \
+       mock_atomic_once = 1; mock_atomic_once; mock_atomic_once = 0)
+
+#endif // MOCK_UTIL_ATOMIC_H
@@ -0,0 +1,79 @@
+/***************************************************************
+   Realtime host runner
+
+   Runs the firmware against the mock core with virtual time
+   following the wall clock, talking to the outside world over
+   stdin/stdout or a pseudo terminal:
+
+     rosarduinobridge_mecanum_enc             # stdin/stdout
+     rosarduinobridge_mecanum_enc --pty       # prints the pty path
+
+   With --pty a ROS node or the host client library can open the
+   printed /dev/pts/N exactly like the board's serial port.
+   *************************************************************/
+
+#include "firmware_sketch.h"
+#include "mock_control.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int openPty() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+    perror("pty");
+    return -1;
+  }
+
+  // Raw mode, so CRs and NULs reach the firmware untouched. Keeping
+  // the slave open also keeps the master readable between clients.
+  const char *name = ptsname(master);
+  int slave = open(name, O_RDWR | O_NOCTTY);
+  struct termios tio;
+  if (slave < 0 || tcgetattr(slave, &tio) < 0) {
+    perror(name);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  fprintf(stderr, "%s\n", name);
+  return master;
+}
+
+int main(int argc, char **argv) {
+  bool usePty = argc > 1 && strcmp(argv[1], "--pty") == 0;
+
+  int rxFd = 0, txFd = 1;
+  if (usePty) {
+    rxFd = txFd = openPty();
+    if (rxFd < 0) return 1;
+  }
+  fcntl(rxFd, F_SETFL, fcntl(rxFd, F_GETFL) | O_NONBLOCK);
+
+  mock_reset();
+  mock_serial_attach_fd(rxFd, txFd);
+  setup();
+  mock_set_realtime(true);
+
+  for (;;) {
+    if (!mock_poll()) break;
+    loop();
+
+    // Sleep until input arrives or the next millisecond tick
+    struct pollfd pfd = { rxFd, POLLIN, 0 };
+    poll(&pfd, 1, 1);
+  }
+
+  // stdin closed: let the last replies out before exiting
+  for (int i = 0; i < 50; i++) {
+    mock_poll();
+    loop();
+    usleep(1000);
+  }
+  return 0;
+}